@@ -0,0 +1,341 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : batch.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the batch engine, which runs many encode / decode
+ * jobs from a manifest inside one process instead of one process each.
+ *
+ * Scheduling :
+ * ------------
+ * 1) Jobs are sorted by carrier size, largest first, and dealt round
+ *    robin to one deque per worker
+ * 2) A worker takes its own jobs from the head of its deque; once it
+ *    runs dry it steals from the tail of the other deques, so big and
+ *    small images interleave and no worker is left with a straggler
+ * 3) Every worker owns one stdio buffer that all of its jobs reuse, and
+ *    with --uring one io_uring (registered buffers pinned once per
+ *    worker, not per job)
+ * 4) A status line is printed per job and a summary at the end
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include "batch.h"
+#include "common.h"
+#include "decode.h"
+#include "encode.h"
+#include "uring.h"
+
+/* Shared state of one batch run */
+typedef struct _BatchPool
+{
+    BatchJob *jobs;
+    uint job_count;
+    BatchQueue queues[MAX_WORKERS];
+    uint workers;
+    uint use_mmap;
+    uint use_uring;           // Workers stream payloads through their own io_uring
+    uint block_size;          // Payload bytes per pipeline block (--block-size), 0 : default
+    uint flags;               // Stego header flags of encode jobs (--bits, --compress)
+    uint use_alpha;           // 32 bpp carriers also hide data in the alpha byte (--alpha)
+    uint verify;              // Decode jobs only check the checksums, no output written (--verify)
+} BatchPool;
+
+/* Arguments of one worker thread */
+typedef struct _BatchWorker
+{
+    BatchPool *pool;
+    uint id;
+} BatchWorker;
+
+/* Read manifest
+ * Input  : Manifest file name, job array and count pointers
+ * Output : One BatchJob per non empty, non comment line
+ * Return : e_success or e_failure on a malformed line
+ */
+static Status batch_read_manifest(const char *fname, BatchJob **jobs, uint *count)
+{
+    FILE *fptr = fopen(fname, "r");
+    if(fptr == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: Unable to open file %s\n", fname);
+        return e_failure;
+    }
+
+    char *line = NULL;
+    size_t line_size = 0;
+    uint capacity = 0, line_no = 0;
+    Status ret = e_success;
+    *jobs = NULL;
+    *count = 0;
+
+    while(getline(&line, &line_size, fptr) != -1)
+    {
+        char *fields[4], *save = NULL;
+        uint nfields = 0;
+        line_no++;
+
+        for(char *tok = strtok_r(line, " \t\r\n", &save); tok != NULL; tok = strtok_r(NULL, " \t\r\n", &save))
+        {
+            if(nfields == 0 && tok[0] == '#')
+                break;                      // comment line
+            if(nfields == 4)
+                break;
+            fields[nfields++] = tok;
+        }
+        if(nfields == 0)
+            continue;
+        if(nfields != 2 && nfields != 3)
+        {
+            fprintf(stderr, "ERROR: %s:%u: expected <carrier> <secret> <output> or <stego> <output>\n", fname, line_no);
+            ret = e_failure;
+            break;
+        }
+
+        if(*count == capacity)
+        {
+            capacity = capacity ? capacity * 2 : 64;
+            BatchJob *grown = realloc(*jobs, capacity * sizeof(BatchJob));
+            if(grown == NULL)
+            {
+                ret = e_failure;
+                break;
+            }
+            *jobs = grown;
+        }
+
+        BatchJob *job = &(*jobs)[(*count)++];
+        memset(job, 0, sizeof(*job));
+        job -> type = nfields == 3 ? e_encode : e_decode;
+        job -> args[0] = strdup("batch");
+        job -> args[1] = strdup(nfields == 3 ? "-e" : "-d");
+        for(uint i = 0; i < nfields; i++)
+            job -> args[2 + i] = strdup(fields[i]);
+
+        struct stat st;
+        job -> cost = stat(fields[0], &st) == 0 ? st.st_size : 0;
+    }
+    free(line);
+    fclose(fptr);
+    return ret;
+}
+
+/* Free jobs
+ * Input  : Jobs and their count
+ * Output : The argument strings of every job freed, then the array
+ */
+static void batch_free_jobs(BatchJob *jobs, uint count)
+{
+    for(uint i = 0; i < count; i++)
+    {
+        for(uint a = 0; a < 6; a++)
+            free(jobs[i].args[a]);
+    }
+    free(jobs);
+}
+
+/* Sort helper : larger carriers first */
+static int batch_cmp_cost(const void *a, const void *b)
+{
+    const BatchJob *x = a, *y = b;
+    return (x -> cost < y -> cost) - (x -> cost > y -> cost);
+}
+
+/* Take a job
+ * Input  : Pool and worker id
+ * Output : Index of the next job, from the own deque head first, then
+ *          stolen from the tail of the other deques
+ * Return : 1 if a job was taken, 0 when every deque is empty
+ */
+static int batch_take_job(BatchPool *pool, uint id, uint *job)
+{
+    for(uint i = 0; i < pool -> workers; i++)
+    {
+        BatchQueue *queue = &pool -> queues[(id + i) % pool -> workers];
+        int found = 0;
+
+        pthread_mutex_lock(&queue -> lock);
+        if(queue -> head < queue -> tail)
+        {
+            *job = (i == 0) ? queue -> jobs[queue -> head++] : queue -> jobs[--queue -> tail];
+            found = 1;
+        }
+        pthread_mutex_unlock(&queue -> lock);
+        if(found)
+            return 1;
+    }
+    return 0;
+}
+
+/* Run one job
+ * Input  : Job, pool, the worker's reusable stdio buffer and io_uring (may be NULL)
+ * Output : Job status and wall time filled in, status line printed
+ */
+static void batch_run_job(BatchJob *job, BatchPool *pool, char *io_buffer, Uring *ring)
+{
+    double start = now_msec();
+
+    if(job -> type == e_encode)
+    {
+        EncodeInfo encInfo = {0};
+        encInfo.use_mmap = pool -> use_mmap;
+        encInfo.flags = pool -> flags;
+        encInfo.use_alpha = pool -> use_alpha;
+        encInfo.io_buffer = io_buffer;
+        encInfo.io_buffer_size = BATCH_IO_BUFFER_SIZE;
+        encInfo.ring = pool -> use_mmap ? NULL : ring;
+        encInfo.block_size = pool -> block_size;
+
+        job -> status = read_and_validate_encode_args(job -> args, &encInfo);
+        if(job -> status == e_success)
+            job -> status = encInfo.use_mmap ? do_encoding_mmap(&encInfo) : do_encoding(&encInfo);
+    }
+    else
+    {
+        DecodeInfo decInfo = {0};
+        decInfo.use_mmap = pool -> use_mmap;
+        decInfo.use_alpha = pool -> use_alpha;
+        decInfo.verify = pool -> verify;
+        decInfo.io_buffer = io_buffer;
+        decInfo.io_buffer_size = BATCH_IO_BUFFER_SIZE;
+        decInfo.ring = pool -> use_mmap ? NULL : ring;
+        decInfo.block_size = pool -> block_size;
+
+        job -> status = read_and_validate_decode_args(job -> args, &decInfo);
+        if(job -> status == e_success)
+            job -> status = decInfo.use_mmap ? do_decoding_mmap(&decInfo) : do_decoding(&decInfo);
+    }
+    job -> msec = now_msec() - start;
+
+    printf("BATCH: %-4s %s %s %s%s%s (%.3f ms)\n", job -> status == e_success ? "OK" : "FAIL",
+           job -> args[1], job -> args[2], job -> args[3], job -> args[4] ? " " : "", job -> args[4] ? job -> args[4] : "",
+           job -> msec);
+}
+
+/* Worker thread
+ * Input  : BatchWorker
+ * Output : Runs jobs until no deque has any left
+ */
+static void *batch_worker(void *arg)
+{
+    BatchWorker *worker = arg;
+    char *io_buffer = malloc(BATCH_IO_BUFFER_SIZE);
+    Uring ring;
+    uint job;
+
+    // Without io_uring the jobs keep the threaded pipeline
+    uint block_size = worker -> pool -> block_size != 0 ? worker -> pool -> block_size : PIPE_BLOCK_SIZE;
+    int has_ring = worker -> pool -> use_uring && uring_init(&ring, block_size) == e_success;
+    while(batch_take_job(worker -> pool, worker -> id, &job))
+    {
+        batch_run_job(&worker -> pool -> jobs[job], worker -> pool, io_buffer, has_ring ? &ring : NULL);
+        if(has_ring && ring.dead)
+        {
+            // Stale entries may still sit in its queue, the next jobs use the threaded pipeline
+            uring_free(&ring);
+            has_ring = 0;
+        }
+    }
+    if(has_ring)
+        uring_free(&ring);
+    free(io_buffer);
+    return NULL;
+}
+
+/* Run batch
+ * Input  : Manifest file name, worker count (0 : one per online CPU),
+ *          whether jobs use the memory mapped paths or io_uring, the
+ *          pipeline block size (0 : default), the stego header flags
+ *          of encode jobs, --alpha and --verify (decode jobs)
+ * Output : Every job run, per job status lines and a summary printed
+ * Return : e_success if all jobs succeeded
+ */
+Status run_batch(const char *manifest_fname, uint workers, uint use_mmap, uint use_uring, uint block_size, uint flags,
+                 uint use_alpha, uint verify)
+{
+    BatchPool pool = { 0 };
+    BatchWorker args[MAX_WORKERS];
+    pthread_t tids[MAX_WORKERS];
+    int started[MAX_WORKERS];
+
+    if(batch_read_manifest(manifest_fname, &pool.jobs, &pool.job_count) != e_success)
+    {
+        batch_free_jobs(pool.jobs, pool.job_count);
+        return e_failure;
+    }
+
+    workers = resolve_workers(workers);
+    if(workers > pool.job_count && pool.job_count > 0)
+        workers = pool.job_count;
+    pool.workers = workers;
+    pool.use_mmap = use_mmap;
+    pool.use_uring = use_uring;
+    pool.block_size = block_size;
+    pool.flags = flags;
+    pool.use_alpha = use_alpha;
+    pool.verify = verify;
+
+    // Deal the jobs, largest carrier first, round robin over the deques
+    qsort(pool.jobs, pool.job_count, sizeof(BatchJob), batch_cmp_cost);
+    for(uint w = 0; w < workers; w++)
+    {
+        pthread_mutex_init(&pool.queues[w].lock, NULL);
+        pool.queues[w].jobs = malloc((pool.job_count / workers + 1) * sizeof(uint));
+    }
+    for(uint i = 0; i < pool.job_count; i++)
+    {
+        BatchQueue *queue = &pool.queues[i % workers];
+        queue -> jobs[queue -> tail++] = i;
+    }
+
+    // Progress lines of concurrent jobs would interleave, keep only status lines
+    int was_quiet = quiet_mode;
+    quiet_mode = 1;
+    double start = now_msec();
+
+    for(uint w = 0; w < workers; w++)
+    {
+        args[w] = (BatchWorker) { &pool, w };
+        started[w] = pthread_create(&tids[w], NULL, batch_worker, &args[w]) == 0;
+    }
+    for(uint w = 0; w < workers; w++)
+    {
+        if(started[w])
+            pthread_join(tids[w], NULL);
+    }
+    // A worker that failed to start leaves its deque to be stolen from; drain any rest here
+    for(uint w = 0; w < workers; w++)
+    {
+        if(!started[w])
+        {
+            batch_worker(&args[0]);
+            break;
+        }
+    }
+
+    double total = now_msec() - start;
+    quiet_mode = was_quiet;
+
+    uint failed = 0;
+    for(uint i = 0; i < pool.job_count; i++)
+    {
+        if(pool.jobs[i].status != e_success)
+            failed++;
+    }
+    for(uint w = 0; w < workers; w++)
+    {
+        free(pool.queues[w].jobs);
+        pthread_mutex_destroy(&pool.queues[w].lock);
+    }
+    batch_free_jobs(pool.jobs, pool.job_count);
+
+    printf("BATCH: %u jobs, %u failed, %u workers, %.3f ms\n", pool.job_count, failed, workers, total);
+    return failed == 0 ? e_success : e_failure;
+}
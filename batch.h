@@ -0,0 +1,45 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <pthread.h>
+#include <sys/types.h>
+#include "types.h"
+
+/*
+ * Batch engine (-b manifest).
+ *
+ * Every manifest line is one job:
+ *      <carrier.bmp> <secret_file> <output.bmp>   → encode
+ *      <stego.bmp> <output_name>                  → decode
+ * Blank lines and lines starting with '#' are skipped.
+ */
+
+/* Stdio buffer reused by a worker across all of its jobs */
+#define BATCH_IO_BUFFER_SIZE (1 << 20)
+
+/* One manifest line */
+typedef struct _BatchJob
+{
+    OperationType type;       // e_encode or e_decode
+    char *args[6];            // argv style: "", -e/-d, files..., NULL
+    off_t cost;               // Carrier size, larger jobs are started first
+    Status status;            // Job result
+    double msec;              // Job wall time
+} BatchJob;
+
+/* Work-stealing deque of one worker (indexes into the job array) */
+typedef struct _BatchQueue
+{
+    pthread_mutex_t lock;
+    uint *jobs;
+    uint head;                // Owner takes from the head
+    uint tail;                // Thieves take from the tail
+} BatchQueue;
+
+/* Run every job of a manifest on a work-stealing pool of workers (flags : stego header flags of encode jobs,
+ * use_uring : every worker streams its jobs through one io_uring, block_size : pipeline block size, 0 : default,
+ * use_alpha : --alpha, verify : decode jobs only check the checksums) */
+Status run_batch(const char *manifest_fname, uint workers, uint use_mmap, uint use_uring, uint block_size, uint flags,
+                 uint use_alpha, uint verify);
+
+#endif
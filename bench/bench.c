@@ -0,0 +1,429 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : bench/bench.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * Benchmark suite, reports machine readable JSON on stdout.
+ *
+ * 1) Generates synthetic 24-bit BMP carriers (1 MP up to 500 MP) and
+ *    secret files of varied sizes in a scratch directory
+ * 2) Runs every carrier / payload pair through the stages of
+ *    do_encoding() and do_decoding(), timing each one separately:
+ *      encode : open, header_copy, metadata, payload_embed, tail_copy, close
+ *      decode : open, header_skip, metadata, payload_extract, close
+ *    Each run is a forked child, so its peak RSS (getrusage) is its own;
+ *    a flat peak RSS over the payload sizes shows the streaming pipeline
+ *    keeps memory bounded
+ * 3) Microbenchmarks encode_byte_to_lsb() / decode_bytes_from_lsb() and
+ *    the bulk lsb_embed() / lsb_extract() of every supported kernel, also
+ *    at 2 and 4 bits per byte (lsb_embed_bits() / lsb_extract_bits())
+ *
+ * Build / run (from the repository root) :
+ * ----------------------------------------
+ *      gcc -O2 -I. bench/bench.c $(ls *.c | grep -v main.c) -pthread -o stego_bench
+ *      ./stego_bench [--dir DIR] [--max-mp N] [--runs N]
+ *
+ * The files are read back from the page cache, so the numbers are CPU
+ * and memory bound rather than disk bound.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include "common.h"
+#include "decode.h"
+#include "encode.h"
+#include "lsb.h"
+
+/* Carrier sizes in megapixels and secret sizes in bytes */
+static const uint bench_carriers_mp[] = { 1, 10, 100, 500 };
+static const uint bench_payloads[] = { 1 << 10, 1 << 16, 1 << 20, 16 << 20, 128 << 20 };
+
+/* Every carrier is BENCH_WIDTH pixels wide, a multiple of 4 (no row padding) */
+#define BENCH_WIDTH 2000
+
+/* Bytes per microbenchmark call and repetitions */
+#define BENCH_MICRO_BYTES (1 << 16)
+#define BENCH_MICRO_REPS 256
+
+/* Stage slots of one run */
+#define BENCH_STAGES 6
+
+static const char *encode_stages[BENCH_STAGES] = { "open", "header_copy", "metadata", "payload_embed", "tail_copy", "close" };
+static const char *decode_stages[BENCH_STAGES] = { "open", "header_skip", "metadata", "payload_extract", "close", NULL };
+
+/* Result a child sends back to the parent */
+typedef struct _BenchTimes
+{
+    Status status;
+    double sec[BENCH_STAGES];
+} BenchTimes;
+
+/* Monotonic time in seconds */
+static double bench_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* xorshift64, fast filler for carriers and secrets */
+static uint64_t bench_rand(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/* Write size pseudo random bytes
+ * Input  : Open file, size and seed
+ */
+static Status bench_fill(FILE *fptr, uint64_t size, uint64_t seed)
+{
+    static uint64_t block[1 << 14];
+    uint64_t state = seed;
+
+    while(size > 0)
+    {
+        size_t count = size < sizeof(block) ? size : sizeof(block);
+        for(size_t i = 0; i < sizeof(block) / 8; i++)
+            block[i] = bench_rand(&state);
+        if(fwrite(block, 1, count, fptr) != count)
+            return e_failure;
+        size -= count;
+    }
+    return e_success;
+}
+
+/* Generate a 24-bit BMP carrier
+ * Input  : File name and size in megapixels
+ * Output : BMP of BENCH_WIDTH x (mp * 10^6 / BENCH_WIDTH) noise pixels
+ */
+static Status bench_make_bmp(const char *fname, uint mp)
+{
+    uint32_t width = BENCH_WIDTH, height = mp * 1000000u / BENCH_WIDTH;
+    uint32_t image_size = width * height * 3;
+    unsigned char header[54] = { 'B', 'M' };
+
+    // File header (14 bytes) and BITMAPINFOHEADER (40 bytes), little endian
+    uint32_t fields[][2] = { { 2, 54 + image_size }, { 10, 54 }, { 14, 40 }, { 18, width }, { 22, height }, { 34, image_size } };
+    for(size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    {
+        for(int b = 0; b < 4; b++)
+            header[fields[i][0] + b] = fields[i][1] >> (8 * b);
+    }
+    header[26] = 1;           // planes
+    header[28] = 24;          // bits per pixel
+
+    FILE *fptr = fopen(fname, "w");
+    if(fptr == NULL)
+    {
+        perror("fopen");
+        return e_failure;
+    }
+    Status ret = fwrite(header, 1, sizeof(header), fptr) == sizeof(header) ? bench_fill(fptr, image_size, mp) : e_failure;
+    if(fclose(fptr) != 0)
+        ret = e_failure;
+    return ret;
+}
+
+/* Generate a secret file of size bytes */
+static Status bench_make_secret(const char *fname, uint size)
+{
+    FILE *fptr = fopen(fname, "w");
+    if(fptr == NULL)
+    {
+        perror("fopen");
+        return e_failure;
+    }
+    Status ret = bench_fill(fptr, size, size + 1);
+    if(fclose(fptr) != 0)
+        ret = e_failure;
+    return ret;
+}
+
+/* Time one stage, stops the run on failure */
+#define BENCH_STAGE(times, slot, call)                      \
+    do {                                                    \
+        double start = bench_now();                         \
+        Status stage_status = (call);                       \
+        (times) -> sec[slot] += bench_now() - start;        \
+        if(stage_status != e_success)                       \
+            return e_failure;                               \
+    } while(0)
+
+/* Encode with the stages of do_encoding(), each timed
+ * Input  : Carrier, secret and output names
+ * Output : Stage times
+ */
+static Status bench_encode(char *bmp, char *secret, char *out, BenchTimes *times)
+{
+    char *argv[] = { "", "-e", bmp, secret, out, NULL };
+    EncodeInfo encInfo = {0};
+
+    if(read_and_validate_encode_args(argv, &encInfo) != e_success)
+        return e_failure;
+    BENCH_STAGE(times, 0, open_files(&encInfo));
+    BENCH_STAGE(times, 0, check_capacity(&encInfo));
+    BENCH_STAGE(times, 1, copy_bmp_header(encInfo.fptr_src_image, encInfo.fptr_stego_image));
+    BENCH_STAGE(times, 2, encode_magic_string(MAGIC_STRING, &encInfo));
+    BENCH_STAGE(times, 2, encode_stego_version(encInfo.flags, &encInfo));
+    BENCH_STAGE(times, 2, encode_secret_file_extn_size(strlen(encInfo.extn_secret_file), &encInfo));
+    BENCH_STAGE(times, 2, encode_secret_file_extn(encInfo.extn_secret_file, &encInfo));
+    BENCH_STAGE(times, 2, encode_secret_file_size(encInfo.secret_file_size, &encInfo));
+    BENCH_STAGE(times, 3, encode_secret_file_data(&encInfo));
+    BENCH_STAGE(times, 4, copy_remaining_img_data(encInfo.fptr_src_image, encInfo.fptr_stego_image));
+
+    double start = bench_now();
+    close_files(&encInfo);            // flushes the stego image
+    times -> sec[5] += bench_now() - start;
+    return e_success;
+}
+
+/* Decode with the stages of do_decoding(), each timed
+ * Input  : Stego image and output name (without extension)
+ * Output : Stage times
+ */
+static Status bench_decode(char *bmp, char *out, BenchTimes *times)
+{
+    char *argv[] = { "", "-d", bmp, out, NULL };
+    DecodeInfo decInfo = {0};
+
+    if(read_and_validate_decode_args(argv, &decInfo) != e_success)
+        return e_failure;
+    BENCH_STAGE(times, 0, open_files_dec(&decInfo));
+    BENCH_STAGE(times, 1, skip_bmp_header(&decInfo));
+    BENCH_STAGE(times, 2, decode_magic_string(&decInfo));
+    BENCH_STAGE(times, 2, decode_stego_version(&decInfo));
+    BENCH_STAGE(times, 2, decode_secret_file_extn_size(&decInfo));
+    BENCH_STAGE(times, 2, decode_secret_file_extn(&decInfo));
+    BENCH_STAGE(times, 2, decode_secret_file_size(&decInfo));
+    BENCH_STAGE(times, 3, decode_secret_file_data(&decInfo));
+
+    double start = bench_now();
+    close_files_dec(&decInfo);
+    times -> sec[4] += bench_now() - start;
+    return e_success;
+}
+
+/* Run one encode or decode in a child process
+ * Input  : Operation, file names and repetitions
+ * Output : Mean stage times and the child's peak RSS in KB
+ */
+static Status bench_run(OperationType op, char *bmp, char *secret, char *out, uint runs, BenchTimes *times, long *peak_rss_kb)
+{
+    int fds[2];
+    if(pipe(fds) != 0)
+        return e_failure;
+
+    pid_t pid = fork();
+    if(pid == 0)
+    {
+        BenchTimes result = { e_success, {0} };
+        for(uint r = 0; r < runs && result.status == e_success; r++)
+        {
+            result.status = op == e_encode ? bench_encode(bmp, secret, out, &result) : bench_decode(bmp, out, &result);
+        }
+        for(int s = 0; s < BENCH_STAGES; s++)
+            result.sec[s] /= runs;
+        _exit(write(fds[1], &result, sizeof(result)) == sizeof(result) ? 0 : 1);
+    }
+    close(fds[1]);
+
+    struct rusage usage;
+    int wstatus;
+    Status ret = pid > 0 && read(fds[0], times, sizeof(*times)) == sizeof(*times) ? times -> status : e_failure;
+    close(fds[0]);
+    if(pid < 0 || wait4(pid, &wstatus, 0, &usage) != pid)
+        return e_failure;
+    *peak_rss_kb = usage.ru_maxrss;
+    return ret;
+}
+
+/* Print one run as a JSON object */
+static void bench_report_run(OperationType op, uint mp, long carrier_bytes, uint payload, const BenchTimes *times, long peak_rss_kb, int first)
+{
+    const char **names = op == e_encode ? encode_stages : decode_stages;
+    double total = 0;
+
+    printf("%s\n    {\"op\": \"%s\", \"carrier_mp\": %u, \"carrier_bytes\": %ld, \"payload_bytes\": %u, \"stages_sec\": {",
+           first ? "" : ",", op == e_encode ? "encode" : "decode", mp, carrier_bytes, payload);
+    for(int s = 0; s < BENCH_STAGES && names[s] != NULL; s++)
+    {
+        printf("%s\"%s\": %.6f", s ? ", " : "", names[s], times -> sec[s]);
+        total += times -> sec[s];
+    }
+    printf("}, \"total_sec\": %.6f, \"mb_per_s\": %.1f, \"ns_per_byte\": %.2f, \"peak_rss_kb\": %ld}",
+           total, payload / total / 1e6, total * 1e9 / payload, peak_rss_kb);
+}
+
+/* Print one microbenchmark as a JSON object */
+static void bench_report_micro(const char *kernel, const char *function, double sec, int first)
+{
+    double bytes = (double)BENCH_MICRO_BYTES * BENCH_MICRO_REPS;
+    printf("%s\n    {\"kernel\": \"%s\", \"function\": \"%s\", \"payload_bytes\": %.0f, \"mb_per_s\": %.1f, \"ns_per_byte\": %.3f}",
+           first ? "" : ",", kernel, function, bytes, bytes / sec / 1e6, sec * 1e9 / bytes);
+}
+
+/* Microbenchmarks
+ * Output : Per byte encode_byte_to_lsb() / decode_bytes_from_lsb() and bulk
+ *          lsb_embed() / lsb_extract() (1, 2 and 4 bits per byte) of every
+ *          supported kernel
+ */
+static void bench_micro(void)
+{
+    const LsbKernel *kernels[8];
+    size_t count = lsb_supported_kernels(kernels, 8);
+    char *data = malloc(BENCH_MICRO_BYTES);
+    char *image = malloc(BENCH_MICRO_BYTES * 8);
+    volatile char sink = 0;
+    uint64_t state = 42;
+    int first = 1;
+
+    if(data == NULL || image == NULL)
+        goto done;
+    for(size_t i = 0; i < BENCH_MICRO_BYTES; i++)
+        data[i] = bench_rand(&state);
+    for(size_t i = 0; i < BENCH_MICRO_BYTES * 8; i++)
+        image[i] = bench_rand(&state);
+
+    for(size_t k = 0; k < count; k++)
+    {
+        lsb_select_kernel(kernels[k] -> name);
+
+        double start = bench_now();
+        for(int r = 0; r < BENCH_MICRO_REPS; r++)
+            for(size_t i = 0; i < BENCH_MICRO_BYTES; i++)
+                encode_byte_to_lsb(data[i], image + i * 8);
+        bench_report_micro(kernels[k] -> name, "encode_byte_to_lsb", bench_now() - start, first);
+        first = 0;
+
+        start = bench_now();
+        for(int r = 0; r < BENCH_MICRO_REPS; r++)
+            for(size_t i = 0; i < BENCH_MICRO_BYTES; i++)
+                sink ^= decode_bytes_from_lsb(image + i * 8);
+        bench_report_micro(kernels[k] -> name, "decode_bytes_from_lsb", bench_now() - start, first);
+
+        start = bench_now();
+        for(int r = 0; r < BENCH_MICRO_REPS; r++)
+            lsb_embed((unsigned char *)image, (unsigned char *)image, (unsigned char *)data, BENCH_MICRO_BYTES);
+        bench_report_micro(kernels[k] -> name, "lsb_embed", bench_now() - start, first);
+
+        start = bench_now();
+        for(int r = 0; r < BENCH_MICRO_REPS; r++)
+            lsb_extract((unsigned char *)image, (unsigned char *)data, BENCH_MICRO_BYTES);
+        bench_report_micro(kernels[k] -> name, "lsb_extract", bench_now() - start, first);
+
+        // --bits=2 / --bits=4 kernels, same payload over 4 / 2 image bytes each
+        for(uint bits = 2; bits <= 4; bits *= 2)
+        {
+            char function[32];
+
+            start = bench_now();
+            for(int r = 0; r < BENCH_MICRO_REPS; r++)
+                lsb_embed_bits((unsigned char *)image, (unsigned char *)image, (unsigned char *)data, BENCH_MICRO_BYTES, bits);
+            snprintf(function, sizeof(function), "lsb_embed_bits%u", bits);
+            bench_report_micro(kernels[k] -> name, function, bench_now() - start, first);
+
+            start = bench_now();
+            for(int r = 0; r < BENCH_MICRO_REPS; r++)
+                lsb_extract_bits((unsigned char *)image, (unsigned char *)data, BENCH_MICRO_BYTES, bits);
+            snprintf(function, sizeof(function), "lsb_extract_bits%u", bits);
+            bench_report_micro(kernels[k] -> name, function, bench_now() - start, first);
+        }
+    }
+    lsb_select_kernel(NULL);
+
+done:
+    free(data);
+    free(image);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = "/tmp";
+    uint max_mp = 500, runs = 1;
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+            dir = argv[++i];
+        else if(strcmp(argv[i], "--max-mp") == 0 && i + 1 < argc)
+            max_mp = atoi(argv[++i]);
+        else if(strcmp(argv[i], "--runs") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+            runs = atoi(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Usage : %s [--dir DIR] [--max-mp N] [--runs N]\n", argv[0]);
+            return e_failure;
+        }
+    }
+
+    char bmp[FILENAME_MAX], secret[FILENAME_MAX], stego[FILENAME_MAX], out[FILENAME_MAX], out_txt[FILENAME_MAX + 4];
+    snprintf(bmp, sizeof(bmp), "%s/bench_carrier.bmp", dir);
+    snprintf(secret, sizeof(secret), "%s/bench_secret.txt", dir);
+    snprintf(stego, sizeof(stego), "%s/bench_stego.bmp", dir);
+    snprintf(out, sizeof(out), "%s/bench_out", dir);
+    snprintf(out_txt, sizeof(out_txt), "%s.txt", out);
+
+    quiet_mode = 1;           // no INFO lines inside the timed stages
+    printf("{\n  \"kernel\": \"%s\",\n  \"runs\": [", lsb_get_kernel() -> name);
+
+    int first = 1;
+    for(size_t c = 0; c < sizeof(bench_carriers_mp) / sizeof(bench_carriers_mp[0]); c++)
+    {
+        uint mp = bench_carriers_mp[c];
+        if(mp > max_mp)
+            break;
+        if(bench_make_bmp(bmp, mp) != e_success)
+        {
+            fprintf(stderr, "ERROR: Unable to generate %u MP carrier in %s\n", mp, dir);
+            return e_failure;
+        }
+        long carrier_bytes = 54 + (long)BENCH_WIDTH * (mp * 1000000L / BENCH_WIDTH) * 3;
+
+        for(size_t p = 0; p < sizeof(bench_payloads) / sizeof(bench_payloads[0]); p++)
+        {
+            uint payload = bench_payloads[p];
+            if((carrier_bytes - 54) / 8 < payload + 16)
+                break;                // does not fit this carrier
+
+            BenchTimes times;
+            long peak_rss_kb;
+            if(bench_make_secret(secret, payload) != e_success
+               || bench_run(e_encode, bmp, secret, stego, runs, &times, &peak_rss_kb) != e_success)
+            {
+                fprintf(stderr, "ERROR: Encode benchmark failed (%u MP, %u bytes)\n", mp, payload);
+                return e_failure;
+            }
+            bench_report_run(e_encode, mp, carrier_bytes, payload, &times, peak_rss_kb, first);
+            first = 0;
+
+            if(bench_run(e_decode, stego, NULL, out, runs, &times, &peak_rss_kb) != e_success)
+            {
+                fprintf(stderr, "ERROR: Decode benchmark failed (%u MP, %u bytes)\n", mp, payload);
+                return e_failure;
+            }
+            bench_report_run(e_decode, mp, carrier_bytes, payload, &times, peak_rss_kb, first);
+        }
+    }
+    unlink(bmp);
+    unlink(secret);
+    unlink(stego);
+    unlink(out_txt);
+
+    printf("\n  ],\n  \"micro\": [");
+    bench_micro();
+    printf("\n  ]\n}\n");
+    return e_success;
+}
@@ -0,0 +1,200 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : bench/serve_latency.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * Latency of one-shot encodes against the --serve daemon.
+ *
+ * 1) One-shot : spawn "<binary> -e carrier secret out.bmp" and wait,
+ *               i.e. what every request pays without the daemon
+ * 2) Daemon   : a long lived caller keeps one connection open and sends
+ *               one encode request per run (open the three files, pass
+ *               their fds, wait for the response)
+ *
+ * Prints p50 / p99 in microseconds for both and checks that the two
+ * stego images are identical.
+ *
+ * Build / run (from the repository root) :
+ * ----------------------------------------
+ *      gcc -O2 *.c -pthread
+ *      gcc -O2 -I. bench/serve_latency.c -o serve_latency
+ *      ./serve_latency ./a.out beautiful.bmp secret.txt 500
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "serve.h"
+
+extern char **environ;
+
+/* Monotonic time in microseconds */
+static double now_usec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Sort samples and print p50 / p99 */
+static void report(const char *label, double *samples, int runs)
+{
+    qsort(samples, runs, sizeof(double), cmp_double);
+    printf("%-10s runs=%d p50=%.0fus p99=%.0fus\n", label, runs,
+           samples[(runs * 50 + 99) / 100 - 1], samples[(runs * 99 + 99) / 100 - 1]);
+}
+
+/* Spawn a program with stdout / stderr discarded */
+static pid_t spawn_quiet(char *argv[])
+{
+    posix_spawn_file_actions_t actions;
+    pid_t pid;
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 1, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, 1, 2);
+    if(posix_spawn(&pid, argv[0], &actions, NULL, argv, environ) != 0)
+        pid = -1;
+    posix_spawn_file_actions_destroy(&actions);
+    return pid;
+}
+
+/* One encode round trip over an open connection */
+static int daemon_encode(int sock, const char *bmp, const char *secret, const char *out, const char *extn)
+{
+    ServeRequest req = { .magic = SERVE_MAGIC, .op = e_encode, .extn = "", .flags = 0 };
+    ServeResponse resp;
+    int fds[3] = { open(bmp, O_RDONLY), open(secret, O_RDONLY), open(out, O_WRONLY | O_CREAT | O_TRUNC, 0644) };
+    char control[CMSG_SPACE(sizeof(fds))] = {0};
+    struct iovec iov = { &req, sizeof(req) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof(control) };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+
+    snprintf(req.extn, sizeof(req.extn), "%s", extn);
+    cmsg -> cmsg_level = SOL_SOCKET;
+    cmsg -> cmsg_type = SCM_RIGHTS;
+    cmsg -> cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    int ok = fds[0] >= 0 && fds[1] >= 0 && fds[2] >= 0 && sendmsg(sock, &msg, 0) == sizeof(req)
+             && recv(sock, &resp, sizeof(resp), MSG_WAITALL) == sizeof(resp) && resp.status == 0;
+    for(int i = 0; i < 3; i++)
+    {
+        if(fds[i] >= 0)
+            close(fds[i]);
+    }
+    return ok ? 0 : -1;
+}
+
+/* Compare two files byte by byte */
+static int same_file(const char *a, const char *b)
+{
+    FILE *fa = fopen(a, "r"), *fb = fopen(b, "r");
+    int same = fa != NULL && fb != NULL;
+    while(same)
+    {
+        int ca = getc(fa), cb = getc(fb);
+        same = ca == cb;
+        if(ca == EOF)
+            break;
+    }
+    if(fa)
+        fclose(fa);
+    if(fb)
+        fclose(fb);
+    return same;
+}
+
+int main(int argc, char *argv[])
+{
+    if(argc < 4)
+    {
+        printf("Usage : %s <binary> <carrier.bmp> <secret_file> [runs]\n", argv[0]);
+        return 1;
+    }
+    int runs = argc > 4 ? atoi(argv[4]) : 200;
+    const char *extn = strrchr(argv[3], '.') ? strrchr(argv[3], '.') : "";
+    double *samples = malloc(sizeof(double) * (runs > 0 ? runs : 1));
+    char dir[] = "/tmp/serve_latency.XXXXXX";
+    char sock_path[64], oneshot[64], daemon[64];
+
+    if(runs <= 0 || samples == NULL || mkdtemp(dir) == NULL)
+        return 1;
+    snprintf(sock_path, sizeof(sock_path), "%s/stego.sock", dir);
+    snprintf(oneshot, sizeof(oneshot), "%s/oneshot.bmp", dir);
+    snprintf(daemon, sizeof(daemon), "%s/daemon.bmp", dir);
+
+    // One-shot invocations
+    char *cli[] = { argv[1], "-e", argv[2], argv[3], oneshot, NULL };
+    for(int i = 0; i < runs; i++)
+    {
+        int wstatus;
+        double start = now_usec();
+        pid_t pid = spawn_quiet(cli);
+        if(pid < 0 || waitpid(pid, &wstatus, 0) != pid || !WIFEXITED(wstatus) || WEXITSTATUS(wstatus) != 0)
+        {
+            fprintf(stderr, "ERROR: one-shot run failed\n");
+            return 1;
+        }
+        samples[i] = now_usec() - start;
+    }
+    report("one-shot", samples, runs);
+
+    // Daemon with one worker, reached over a single connection
+    char *srv[] = { argv[1], "--serve", sock_path, "-j", "1", NULL };
+    pid_t server = spawn_quiet(srv);
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", sock_path);
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    for(int tries = 0; connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0; tries++)
+    {
+        if(server < 0 || tries == 1000)
+        {
+            fprintf(stderr, "ERROR: daemon did not start\n");
+            return 1;
+        }
+        usleep(1000);
+    }
+    for(int i = 0; i < runs; i++)
+    {
+        double start = now_usec();
+        if(daemon_encode(sock, argv[2], argv[3], daemon, extn) != 0)
+        {
+            fprintf(stderr, "ERROR: daemon request failed\n");
+            kill(server, SIGTERM);
+            return 1;
+        }
+        samples[i] = now_usec() - start;
+    }
+    report("daemon", samples, runs);
+    close(sock);
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+
+    int same = same_file(oneshot, daemon);
+    if(!same)
+        fprintf(stderr, "WARNING: outputs differ\n");
+    unlink(oneshot);
+    unlink(daemon);
+    rmdir(dir);
+    free(samples);
+    return same ? 0 : 1;
+}
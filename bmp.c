@@ -0,0 +1,383 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : bmp.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the BMP header parser and the carrier layout.
+ *
+ * Parser :
+ * --------
+ * → bfOffBits gives the first pixel byte (larger DIB headers such as
+ *   BITMAPV4 / V5 and 8 bpp palettes sit before it)
+ * → Rows are padded to 4 bytes, a negative height means top-down rows
+ * → 24 bpp and 8 bpp (BI_RGB), 32 bpp (BI_RGB or BI_BITFIELDS)
+ *
+ * Gather / scatter :
+ * ------------------
+ * One routine pair per format, chosen when the header is parsed, so the
+ * hot loops never test the format per byte:
+ *      → rows    : 24 bpp, 8 bpp and 32 bpp using alpha, one memcpy per row
+ *      → bgr32   : 32 bpp skipping alpha, 3 of every 4 bytes
+ */
+
+#include <string.h>
+#include "bmp.h"
+#include "crc32c.h"
+#include "lsb.h"
+
+/* Read little endian fields of the header */
+static uint32_t bmp_u32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static uint16_t bmp_u16(const unsigned char *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+/* Rows : every byte of the row up to the padding is a carrier byte */
+static void bmp_gather_rows(const unsigned char *row, uint64_t col, unsigned char *out, uint64_t len)
+{
+    memcpy(out, row + col, len);
+}
+
+static void bmp_scatter_rows(const unsigned char *in, unsigned char *row, uint64_t col, uint64_t len)
+{
+    memcpy(row + col, in, len);
+}
+
+/* BGR32 : carrier byte c is byte c % 3 of pixel c / 3, alpha is skipped */
+static void bmp_gather_bgr32(const unsigned char *row, uint64_t col, unsigned char *out, uint64_t len)
+{
+    const unsigned char *px = row + col / 3 * 4;
+    uint64_t c = col % 3;
+
+    // Finish a pixel started by the previous call
+    for(; len > 0 && c != 0; len--)
+    {
+        *out++ = px[c];
+        if(++c == 3)
+        {
+            c = 0;
+            px += 4;
+        }
+    }
+    for(; len >= 3; len -= 3, px += 4, out += 3)
+    {
+        out[0] = px[0];
+        out[1] = px[1];
+        out[2] = px[2];
+    }
+    for(uint64_t i = 0; i < len; i++)
+    {
+        out[i] = px[i];
+    }
+}
+
+static void bmp_scatter_bgr32(const unsigned char *in, unsigned char *row, uint64_t col, uint64_t len)
+{
+    unsigned char *px = row + col / 3 * 4;
+    uint64_t c = col % 3;
+
+    for(; len > 0 && c != 0; len--)
+    {
+        px[c] = *in++;
+        if(++c == 3)
+        {
+            c = 0;
+            px += 4;
+        }
+    }
+    for(; len >= 3; len -= 3, px += 4, in += 3)
+    {
+        px[0] = in[0];
+        px[1] = in[1];
+        px[2] = in[2];
+    }
+    for(uint64_t i = 0; i < len; i++)
+    {
+        px[i] = in[i];
+    }
+}
+
+/* Parse BMP header
+ * Input  : First bytes of the image (BMP_HEADER_SIZE at least), file size
+ *          and whether 32 bpp alpha bytes carry data
+ * Output : Pixel layout and its gather / scatter routines
+ * Return : e_success, or e_failure for a truncated or unsupported image
+ */
+Status bmp_parse(const unsigned char *header, size_t len, uint64_t file_size, uint use_alpha, BmpLayout *layout)
+{
+    if(len < BMP_HEADER_SIZE || header[0] != 'B' || header[1] != 'M')
+        return e_failure;
+
+    uint32_t dib_size = bmp_u32(header + 14);
+    int32_t width = (int32_t)bmp_u32(header + 18);
+    int32_t height = (int32_t)bmp_u32(header + 22);
+    uint16_t planes = bmp_u16(header + 26);
+    uint16_t bpp = bmp_u16(header + 28);
+    uint32_t compression = bmp_u32(header + 30);
+
+    // BITMAPINFOHEADER or a larger one (V2 .. V5), uncompressed pixels only
+    if(dib_size < 40 || planes != 1 || width <= 0 || height == 0 || height == INT32_MIN)
+        return e_failure;
+    if(!(bpp == 24 && compression == 0) && !(bpp == 8 && compression == 0)
+       && !(bpp == 32 && (compression == 0 || compression == 3)))
+        return e_failure;
+
+    memset(layout, 0, sizeof(*layout));
+    layout -> offset = bmp_u32(header + 10);
+    layout -> width = width;
+    layout -> height = height < 0 ? -height : height;
+    layout -> bpp = bpp;
+    layout -> stride = ((uint64_t)width * bpp + 31) / 32 * 4;
+
+    if(layout -> offset < 14 + (uint64_t)dib_size
+       || layout -> offset + layout -> stride * layout -> height > file_size)
+        return e_failure;
+
+    bmp_set_alpha(layout, use_alpha);
+    return e_success;
+}
+
+/* Set alpha
+ * Input  : Parsed layout and whether 32 bpp alpha bytes carry data
+ * Output : Carrier bytes per row and gather / scatter routines set for
+ *          it (only 32 bpp images have an alpha byte to switch)
+ */
+void bmp_set_alpha(BmpLayout *layout, uint use_alpha)
+{
+    if(layout -> bpp == 32 && !use_alpha)
+    {
+        layout -> row_bytes = (uint64_t)layout -> width * 3;
+        layout -> gather = bmp_gather_bgr32;
+        layout -> scatter = bmp_scatter_bgr32;
+    }
+    else
+    {
+        layout -> row_bytes = (uint64_t)layout -> width * layout -> bpp / 8;
+        layout -> gather = bmp_gather_rows;
+        layout -> scatter = bmp_scatter_rows;
+    }
+    layout -> contiguous = layout -> row_bytes == layout -> stride;
+}
+
+/* Uses alpha
+ * Input  : Layout
+ * Output : 1 if the carrier takes the alpha bytes of a 32 bpp image too
+ */
+uint bmp_uses_alpha(const BmpLayout *layout)
+{
+    return layout -> bpp == 32 && layout -> gather == bmp_gather_rows;
+}
+
+/* Read BMP layout
+ * Input  : Open image stream and the --alpha setting
+ * Output : Layout parsed from the header, stream rewound
+ */
+Status bmp_read_layout(FILE *fptr, uint use_alpha, BmpLayout *layout)
+{
+    unsigned char header[BMP_HEADER_SIZE];
+
+    fseeko(fptr, 0, SEEK_END);
+    off_t file_size = ftello(fptr);
+    rewind(fptr);
+    size_t len = fread(header, 1, sizeof(header), fptr);
+    rewind(fptr);
+    return file_size > 0 ? bmp_parse(header, len, file_size, use_alpha, layout) : e_failure;
+}
+
+/* Flat layout
+ * Input  : Image file size
+ * Output : One "row" holding every byte after the 54 byte header, the
+ *          layout stego images were written with before the parser
+ */
+void bmp_flat_layout(uint64_t file_size, BmpLayout *layout)
+{
+    memset(layout, 0, sizeof(*layout));
+    layout -> offset = BMP_HEADER_SIZE;
+    layout -> width = file_size > BMP_HEADER_SIZE ? file_size - BMP_HEADER_SIZE : 0;
+    layout -> height = 1;
+    layout -> bpp = 8;
+    layout -> stride = layout -> row_bytes = layout -> width;
+    layout -> gather = bmp_gather_rows;
+    layout -> scatter = bmp_scatter_rows;
+    layout -> contiguous = 1;
+}
+
+/* Is flat
+ * Input  : Layout
+ * Output : 1 if carrier byte i is file byte 54 + i, as in the flat layout
+ */
+uint bmp_is_flat(const BmpLayout *layout)
+{
+    return layout -> contiguous && layout -> offset == BMP_HEADER_SIZE;
+}
+
+/* Carrier size
+ * Output : Carrier bytes of the whole image
+ */
+uint64_t bmp_carrier_size(const BmpLayout *layout)
+{
+    return layout -> row_bytes * layout -> height;
+}
+
+/* Region end
+ * Input  : Layout and a carrier length
+ * Output : File offset past carrier bytes [0, len), rounded up to whole
+ *          rows when rows hold skipped bytes
+ */
+uint64_t bmp_region_end(const BmpLayout *layout, uint64_t len)
+{
+    if(layout -> row_bytes == 0)
+        return layout -> offset;
+    if(layout -> contiguous)
+        return layout -> offset + (len < bmp_carrier_size(layout) ? len : bmp_carrier_size(layout));
+
+    uint64_t rows = (len + layout -> row_bytes - 1) / layout -> row_bytes;
+    if(rows > layout -> height)
+        rows = layout -> height;
+    return layout -> offset + rows * layout -> stride;
+}
+
+/* Carrier end
+ * Input  : Layout and a carrier length
+ * Output : File offset past the last of carrier bytes [0, len), for
+ *          reads that need those bytes only (the stego header of a wide
+ *          image sits in part of its first row)
+ */
+uint64_t bmp_carrier_end(const BmpLayout *layout, uint64_t len)
+{
+    if(len > bmp_carrier_size(layout))
+        len = bmp_carrier_size(layout);
+    if(len == 0 || layout -> contiguous)
+        return bmp_region_end(layout, len);
+
+    uint64_t row = (len - 1) / layout -> row_bytes, col = (len - 1) % layout -> row_bytes;
+    // Skipped alpha : carrier byte col is byte col % 3 of pixel col / 3
+    if(layout -> gather == bmp_gather_bgr32)
+        col = col / 3 * 4 + col % 3;
+    return layout -> offset + row * layout -> stride + col + 1;
+}
+
+/* Gather carrier bytes
+ * Input  : Layout, pixel array, carrier position and length
+ * Output : Carrier bytes [pos, pos + len) copied to out
+ */
+void bmp_gather(const BmpLayout *layout, const unsigned char *pixels, uint64_t pos, unsigned char *out, uint64_t len)
+{
+    if(layout -> contiguous)
+    {
+        memcpy(out, pixels + pos, len);
+        return;
+    }
+
+    uint64_t row = pos / layout -> row_bytes, col = pos % layout -> row_bytes;
+    while(len > 0)
+    {
+        uint64_t count = layout -> row_bytes - col < len ? layout -> row_bytes - col : len;
+        layout -> gather(pixels + row * layout -> stride, col, out, count);
+        out += count;
+        len -= count;
+        row++;
+        col = 0;
+    }
+}
+
+/* Scatter carrier bytes
+ * Input  : Layout, carrier bytes, pixel array, carrier position and length
+ * Output : Carrier bytes [pos, pos + len) stored in the pixel array,
+ *          padding and skipped alpha bytes untouched
+ */
+void bmp_scatter(const BmpLayout *layout, const unsigned char *in, unsigned char *pixels, uint64_t pos, uint64_t len)
+{
+    if(layout -> contiguous)
+    {
+        memcpy(pixels + pos, in, len);
+        return;
+    }
+
+    uint64_t row = pos / layout -> row_bytes, col = pos % layout -> row_bytes;
+    while(len > 0)
+    {
+        uint64_t count = layout -> row_bytes - col < len ? layout -> row_bytes - col : len;
+        layout -> scatter(in, pixels + row * layout -> stride, col, count);
+        in += count;
+        len -= count;
+        row++;
+        col = 0;
+    }
+}
+
+/* Embed data into the carrier
+ * Input  : Layout, source and destination pixel arrays, carrier position,
+ *          data, size, bits per carrier byte (1, 2 or 4) and an optional
+ *          running CRC32C of the data
+ * Output : 8 / bits * n carrier bytes of dest hold the data. Contiguous
+ *          carriers go straight to the LSB kernel, others are gathered
+ *          into a chunk, embedded and scattered back. The CRC is taken
+ *          chunk by chunk in the same loop
+ */
+void bmp_embed(const BmpLayout *layout, const unsigned char *src, unsigned char *dest, uint64_t pos,
+               const unsigned char *data, uint64_t n, uint bits, uint32_t *crc)
+{
+    if(layout -> contiguous)
+    {
+        if(crc != NULL)
+            *crc = lsb_embed_bits_crc(src + pos, dest + pos, data, n, bits, *crc);
+        else
+            lsb_embed_bits(src + pos, dest + pos, data, n, bits);
+        return;
+    }
+
+    unsigned char chunk[BMP_CHUNK_SIZE];
+    while(n > 0)
+    {
+        uint64_t count = n < BMP_CHUNK_SIZE / 8 ? n : BMP_CHUNK_SIZE / 8;
+        uint64_t len = lsb_carrier_size(count, bits);
+        bmp_gather(layout, src, pos, chunk, len);
+        lsb_embed_bits(chunk, chunk, data, count, bits);
+        bmp_scatter(layout, chunk, dest, pos, len);
+        if(crc != NULL)
+            *crc = crc32c_update(*crc, data, count);
+        pos += len;
+        data += count;
+        n -= count;
+    }
+}
+
+/* Extract data from the carrier
+ * Input  : Layout, pixel array, carrier position, size, bits per
+ *          carrier byte (1, 2 or 4) and an optional running CRC32C
+ * Output : n data bytes, the CRC updated over them
+ */
+void bmp_extract(const BmpLayout *layout, const unsigned char *pixels, uint64_t pos, unsigned char *data, uint64_t n,
+                 uint bits, uint32_t *crc)
+{
+    if(layout -> contiguous)
+    {
+        if(crc != NULL)
+            *crc = lsb_extract_bits_crc(pixels + pos, data, n, bits, *crc);
+        else
+            lsb_extract_bits(pixels + pos, data, n, bits);
+        return;
+    }
+
+    unsigned char chunk[BMP_CHUNK_SIZE];
+    while(n > 0)
+    {
+        uint64_t count = n < BMP_CHUNK_SIZE / 8 ? n : BMP_CHUNK_SIZE / 8;
+        uint64_t len = lsb_carrier_size(count, bits);
+        bmp_gather(layout, pixels, pos, chunk, len);
+        lsb_extract_bits(chunk, data, count, bits);
+        if(crc != NULL)
+            *crc = crc32c_update(*crc, data, count);
+        pos += len;
+        data += count;
+        n -= count;
+    }
+}
@@ -0,0 +1,86 @@
+#ifndef BMP_H
+#define BMP_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "types.h"
+
+/*
+ * BMP carrier layout.
+ *
+ * The carrier is the sequence of pixel bytes data is hidden in, row by
+ * row in file order:
+ *      24 bpp : B G R of every pixel, row padding skipped
+ *      32 bpp : B G R of every pixel (alpha skipped), or all 4 bytes (--alpha)
+ *       8 bpp : palette index of every pixel, row padding skipped
+ *
+ * When a row holds no skipped byte the carrier is one flat byte range
+ * starting at bfOffBits ("contiguous"), and the streaming / mapped paths
+ * work on it directly. Otherwise rows go through the gather / scatter
+ * routines picked once per image.
+ */
+
+/* BITMAPFILEHEADER + BITMAPINFOHEADER, the fields the parser reads */
+#define BMP_HEADER_SIZE 54
+
+/* Carrier bytes gathered per step by bmp_embed() / bmp_extract() */
+#define BMP_CHUNK_SIZE (1 << 15)
+
+/* Pixel layout of one image */
+typedef struct _BmpLayout
+{
+    uint64_t offset;          // bfOffBits : first pixel byte in the file
+    uint32_t width;           // Pixels per row
+    uint32_t height;          // Rows (absolute value, top-down images too)
+    uint32_t bpp;             // 8, 24 or 32
+    uint64_t stride;          // Bytes per row in the file (padded to 4)
+    uint64_t row_bytes;       // Carrier bytes per row
+    uint contiguous;          // Carrier is the flat range [offset, offset + height * stride)
+
+    /* Copy carrier bytes [col, col + len) of one row out of / into the row */
+    void (*gather)(const unsigned char *row, uint64_t col, unsigned char *out, uint64_t len);
+    void (*scatter)(const unsigned char *in, unsigned char *row, uint64_t col, uint64_t len);
+} BmpLayout;
+
+/* Parse the first BMP_HEADER_SIZE bytes of an image of file_size bytes */
+Status bmp_parse(const unsigned char *header, size_t len, uint64_t file_size, uint use_alpha, BmpLayout *layout);
+
+/* Switch a parsed layout between the 32 bpp carriers with and without alpha bytes */
+void bmp_set_alpha(BmpLayout *layout, uint use_alpha);
+
+/* Carrier takes the alpha bytes of a 32 bpp image (--alpha) */
+uint bmp_uses_alpha(const BmpLayout *layout);
+
+/* Parse the header of an open image, the stream is rewound afterwards */
+Status bmp_read_layout(FILE *fptr, uint use_alpha, BmpLayout *layout);
+
+/* Layout of images encoded before the parser: every byte after the 54 byte header */
+void bmp_flat_layout(uint64_t file_size, BmpLayout *layout);
+
+/* Carrier is the flat one (contiguous from byte 54), legacy headers are only read from it */
+uint bmp_is_flat(const BmpLayout *layout);
+
+/* Carrier bytes of the whole image */
+uint64_t bmp_carrier_size(const BmpLayout *layout);
+
+/* File offset just past carrier bytes [0, len) (whole rows unless contiguous) */
+uint64_t bmp_region_end(const BmpLayout *layout, uint64_t len);
+
+/* File offset just past the last of carrier bytes [0, len), exact (no whole rows) */
+uint64_t bmp_carrier_end(const BmpLayout *layout, uint64_t len);
+
+/* Copy carrier bytes [pos, pos + len) out of / into the pixel array (image + offset) */
+void bmp_gather(const BmpLayout *layout, const unsigned char *pixels, uint64_t pos, unsigned char *out, uint64_t len);
+void bmp_scatter(const BmpLayout *layout, const unsigned char *in, unsigned char *pixels, uint64_t pos, uint64_t len);
+
+/* Embed n data bytes at carrier byte pos, bits (1, 2 or 4) per carrier byte (src and dest may be
+ * the same; when they are not and the layout is not contiguous, dest must already hold a copy of the rows).
+ * A non NULL crc is the running CRC32C of the data, updated on the way */
+void bmp_embed(const BmpLayout *layout, const unsigned char *src, unsigned char *dest, uint64_t pos,
+               const unsigned char *data, uint64_t n, uint bits, uint32_t *crc);
+
+/* Extract n data bytes from carrier byte pos, bits (1, 2 or 4) per carrier byte, crc as for bmp_embed() */
+void bmp_extract(const BmpLayout *layout, const unsigned char *pixels, uint64_t pos, unsigned char *data, uint64_t n,
+                 uint bits, uint32_t *crc);
+
+#endif
@@ -0,0 +1,40 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : common.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * State and helpers shared by the encoding and decoding modules and
+ * the worker pools (batch, scan, serve, shard).
+ */
+
+#include <time.h>
+#include <unistd.h>
+#include "common.h"
+
+/* INFO: progress lines are printed unless this is set */
+int quiet_mode = 0;
+
+/* Resolve worker count
+ * Input  : -j N (0 : one per online CPU)
+ * Return : Workers to start, 1 to MAX_WORKERS
+ */
+uint resolve_workers(uint workers)
+{
+    if(workers == 0)
+    {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        workers = cpus > 0 ? cpus : 1;
+    }
+    return workers < MAX_WORKERS ? workers : MAX_WORKERS;
+}
+
+/* Monotonic time in milliseconds */
+double now_msec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
@@ -1,7 +1,26 @@
 #ifndef COMMON_H
 #define COMMON_H
 
+#include <stdio.h>
+#include "types.h"
+
 /* Magic string to identify whether stegged or not */
 #define MAGIC_STRING "#*"
 
+/* Set to silence the INFO: progress lines (--quiet, batch mode) */
+extern int quiet_mode;
+
+/* Upper bound for -j N, the worker / thread count of every pool */
+#define MAX_WORKERS 256
+
+/* printf for INFO: progress lines, skipped entirely in quiet mode. Never
+ * for the reason of a failure, those always go to stderr as "ERROR: ..." */
+#define PRINT_INFO(...) do { if(!quiet_mode) printf(__VA_ARGS__); } while(0)
+
+/* Workers of a pool : -j N, 0 for one per online CPU, at most MAX_WORKERS */
+uint resolve_workers(uint workers);
+
+/* Monotonic time in milliseconds */
+double now_msec(void);
+
 #endif
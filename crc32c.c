@@ -0,0 +1,188 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : crc32c.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the CRC32C checksum of the stego header and the
+ * payload. It is computed on payload blocks while they are still in L1
+ * after the LSB kernel wrote or read them, so it costs no extra pass:
+ *
+ *      → sse4.2 : the crc32 instruction, 8 bytes per step
+ *      → table  : slicing by 8, eight 256 entry tables folded into one
+ *                 lookup per byte of an 8 byte word (any CPU)
+ *
+ * The implementation is picked once from cpuid, like the LSB kernels.
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include "crc32c.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CRC32C_X86
+#include <immintrin.h>
+#endif
+
+/* Slicing by 8 tables, table[k][b] is the CRC of byte b followed by k zero bytes */
+static uint32_t crc32c_table[8][256];
+
+/* Active implementation */
+static uint32_t (*crc32c_active)(uint32_t crc, const unsigned char *data, size_t len);
+static const char *crc32c_name;
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+
+/* Table update
+ * Input  : Inverted running CRC, data and size
+ * Output : Inverted CRC after the data, 8 bytes per step
+ */
+static uint32_t crc32c_update_table(uint32_t crc, const unsigned char *data, size_t len)
+{
+    // Align to 8 bytes so the words below are aligned loads
+    for(; len > 0 && ((uintptr_t)data & 7) != 0; len--)
+        crc = crc32c_table[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+    for(; len >= 8; len -= 8, data += 8)
+    {
+        uint32_t lo, hi;
+        memcpy(&lo, data, 4);
+        memcpy(&hi, data + 4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = crc32c_table[7][lo & 0xFF] ^ crc32c_table[6][(lo >> 8) & 0xFF]
+            ^ crc32c_table[5][(lo >> 16) & 0xFF] ^ crc32c_table[4][lo >> 24]
+            ^ crc32c_table[3][hi & 0xFF] ^ crc32c_table[2][(hi >> 8) & 0xFF]
+            ^ crc32c_table[1][(hi >> 16) & 0xFF] ^ crc32c_table[0][hi >> 24];
+    }
+
+    while(len-- > 0)
+        crc = crc32c_table[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+#if defined(CRC32C_X86)
+/* SSE4.2 update
+ * Input  : Inverted running CRC, data and size
+ * Output : Inverted CRC after the data, 8 bytes per crc32 instruction
+ */
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_update_sse42(uint32_t crc, const unsigned char *data, size_t len)
+{
+    for(; len > 0 && ((uintptr_t)data & 7) != 0; len--)
+        crc = _mm_crc32_u8(crc, *data++);
+#if defined(__x86_64__)
+    uint64_t crc64 = crc;
+    for(; len >= 8; len -= 8, data += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (uint32_t)crc64;
+#endif
+    for(; len >= 4; len -= 4, data += 4)
+    {
+        uint32_t word;
+        memcpy(&word, data, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    while(len-- > 0)
+        crc = _mm_crc32_u8(crc, *data++);
+    return crc;
+}
+#endif
+
+/* Initialise (once)
+ * Output : Tables built, fastest supported implementation active
+ */
+static void crc32c_init(void)
+{
+    for(uint32_t b = 0; b < 256; b++)
+    {
+        uint32_t crc = b;
+        for(int i = 0; i < 8; i++)
+            crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+        crc32c_table[0][b] = crc;
+    }
+    for(uint32_t b = 0; b < 256; b++)
+    {
+        for(int k = 1; k < 8; k++)
+            crc32c_table[k][b] = crc32c_table[0][crc32c_table[k - 1][b] & 0xFF] ^ (crc32c_table[k - 1][b] >> 8);
+    }
+
+    crc32c_active = crc32c_update_table;
+    crc32c_name = "table";
+#if defined(CRC32C_X86)
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("sse4.2"))
+    {
+        crc32c_active = crc32c_update_sse42;
+        crc32c_name = "sse4.2";
+    }
+#endif
+}
+
+/* Update CRC32C
+ * Input  : Running CRC (0 to start), data and size
+ * Output : CRC32C of everything passed so far
+ */
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t len)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+    return ~crc32c_active(~crc, data, len);
+}
+
+/* Multiply modulo the polynomial
+ * Input  : Two polynomials, reflected (bit 31 is x^0), a not 0
+ * Output : a * b mod P
+ */
+static uint32_t crc32c_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = 1u << 31, p = 0;
+
+    for(;;)
+    {
+        if(a & m)
+        {
+            p ^= b;
+            if((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32C_POLY : b >> 1;
+    }
+    return p;
+}
+
+/* Combine CRC32C values
+ * Input  : CRC of piece A, CRC of piece B and the length of B
+ * Output : CRC of A followed by B, i.e. crc1 * x^(8 * len2) + crc2,
+ *          squaring x^8 once per bit of len2 (no pass over the data)
+ */
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2)
+{
+    uint32_t power = 1u << 23;        // x^8
+    uint32_t shift = 1u << 31;        // x^0
+
+    for(; len2 != 0; len2 >>= 1)
+    {
+        if(len2 & 1)
+            shift = crc32c_multmodp(power, shift);
+        power = crc32c_multmodp(power, power);
+    }
+    return crc32c_multmodp(shift, crc1) ^ crc2;
+}
+
+/* Get implementation
+ * Output : Name of the implementation crc32c_update() uses
+ */
+const char *crc32c_impl(void)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+    return crc32c_name;
+}
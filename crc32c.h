@@ -0,0 +1,28 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * CRC32C (Castagnoli, reflected polynomial 0x82F63B78), the checksum of
+ * the stego header and payload.
+ *
+ * Like zlib's crc32(), a running value starts at 0 and is passed back in
+ * with the next piece; crc32c_combine() joins the values of two adjacent
+ * pieces computed independently (one per thread).
+ */
+
+/* Reflected CRC32C polynomial */
+#define CRC32C_POLY 0x82F63B78u
+
+/* CRC32C of len more bytes after a running value crc (0 to start) */
+uint32_t crc32c_update(uint32_t crc, const void *data, size_t len);
+
+/* CRC32C of A followed by B, from crc(A), crc(B) and the length of B */
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, uint64_t len2);
+
+/* Implementation in use : "sse4.2" or "table" */
+const char *crc32c_impl(void);
+
+#endif
@@ -15,14 +15,31 @@
  * ------------------------
  * 1) Opening encoded BMP (stego) file
  * 2) Validating decoding arguments and preparing output filename
- * 3) Skipping BMP header (first 54 bytes)
+ * 3) Parsing the BMP header and skipping to the pixel array (bfOffBits)
  * 4) Decoding:
  *      → Magic string (#*) to confirm valid encoded file
+ *      → Header version marker and flags (images written before the
+ *        marker have the extension size there, they are read with the
+ *        flat layout and a 32-bit file size)
  *      → Secret file extension size
  *      → Secret file extension (.txt / .c / .sh)
- *      → Secret file size
- *      → Extracting secret file data byte by byte
- * 5) Writing extracted data into the final output file
+ *      → Secret file size (64-bit)
+ *      → Header checksum, so a carrier that merely starts with "#*" is
+ *        rejected before any output file is created
+ *      → Extracting secret file data byte by byte, checked against its
+ *        CRC32C (taken block by block in the same pass)
+ * 5) Writing extracted data into the final output file (nothing is
+ *    written with --verify, which only checks the checksums)
+ * 6) Optional memory mapped decoding (--mmap), where the secret data is
+ *    extracted straight from the mapped image into the mapped output
+ * 7) Compressed payloads (--compress at encoding), decompressed block
+ *    by block in the same pass that extracts them
+ * 8) Block pipeline of the payload stage, where reads of the next
+ *    image blocks, the LSB stage and writes of the output overlap on
+ *    reader / writer threads, or through io_uring (--uring)
+ * 9) Optional streaming ("-" arguments), the stego image read from
+ *    standard input and / or the secret written to standard output in
+ *    one forward pass, a window of rows at a time
  *
  * Output :
  * --------
@@ -34,10 +51,22 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
 #include "common.h"
+#include "crc32c.h"
 #include "decode.h"
+#include "lsb.h"
+#include "lz.h"
+#include "stats.h"
+#include "stego.h"
+#include "stream.h"
 #include "types.h"
 
+static int decode_retry_alpha(DecodeInfo* decInfo);
+static int decode_retry_flat(DecodeInfo* decInfo);
+
 /* Open stego BMP image file
  * Input  : DecodeInfo pointer containing stego filename
  * Output : Opens fptr_stego_image
@@ -45,7 +74,8 @@
  */
 Status open_files_dec(DecodeInfo* decInfo)
 {
-    printf("INFO: Opening required files\n");
+    PRINT_INFO("INFO: Opening required files\n");
+    decInfo -> fptr_secret_output = NULL;
 
     // Open stego image file (encoded BMP)
     decInfo -> fptr_stego_image = fopen(decInfo -> stego_image_fname, "r");
@@ -57,7 +87,11 @@ Status open_files_dec(DecodeInfo* decInfo)
         return e_failure;
     }
 
-    printf("INFO: Opened %s\n", decInfo -> stego_image_fname);
+    PRINT_INFO("INFO: Opened %s\n", decInfo -> stego_image_fname);
+    if(decInfo -> io_buffer != NULL)
+    {
+        setvbuf(decInfo -> fptr_stego_image, decInfo -> io_buffer, _IOFBF, decInfo -> io_buffer_size / 2);
+    }
     return e_success;
 }
 
@@ -68,33 +102,40 @@ Status open_files_dec(DecodeInfo* decInfo)
  */
 Status read_and_validate_decode_args(char* argv[], DecodeInfo *decInfo)
 {
-    printf("INFO: Validating Arguments\n");
+    PRINT_INFO("INFO: Validating Arguments\n");
 
-     // Validate stego BMP filename
+     // Validate stego BMP filename ("-" : standard input)
     char* sub = strstr(argv[2], ".bmp");
-    if(sub != NULL && strcmp(sub, ".bmp") == 0)
+    if((sub != NULL && strcmp(sub, ".bmp") == 0) || stream_is_std(argv[2]))
     {
         decInfo -> stego_image_fname = argv[2];
     }
     else
     {
-        printf("INFO: ## Error: Encoded file is not a .bmp file\n");
+        fprintf(stderr, "ERROR: Encoded file %s is not a .bmp file\n", argv[2]);
         return e_failure;
     }
 
-    // Check if user provided output filename
+    decInfo -> stream = stream_is_std(argv[2]) || stream_is_std(argv[3]);
+
+    // Check if user provided output filename ("-" : standard output, no extension added)
     if(argv[3] != NULL)
     {
+        if(strlen(argv[3]) + DECODE_EXTN_MAX >= sizeof(decInfo -> secret_output_fname))
+        {
+            fprintf(stderr, "ERROR: Output file name is too long\n");
+            return e_failure;
+        }
         strcpy(decInfo -> secret_output_fname, argv[3]); // Storing output name
-        printf("INFO: Validation Successfull\n");
+        PRINT_INFO("INFO: Validation Successfull\n");
         return e_success;
     }
     else
     {
         // Default output file name
-        printf("Output File not mentioned. Creating secret_output as default\n");
+        PRINT_INFO("Output File not mentioned. Creating secret_output as default\n");
         strcpy(decInfo -> secret_output_fname, "secret_output");
-        printf("INFO: Validation Successfull\n");
+        PRINT_INFO("INFO: Validation Successfull\n");
         return e_success;
     }
 }
@@ -106,47 +147,124 @@ Status read_and_validate_decode_args(char* argv[], DecodeInfo *decInfo)
  */
 Status do_decoding(DecodeInfo* decInfo)
 {
-    if(open_files_dec(decInfo) == e_success)
+    if(STATS_STAGE("open", open_files_dec(decInfo)) == e_success)
     {
-        printf("INFO: ## Decoding Procedure Started ##\n");
+        PRINT_INFO("INFO: ## Decoding Procedure Started ##\n");
 
-        if(skip_bmp_header(decInfo) == e_success)
+        if(STATS_STAGE("header_skip", skip_bmp_header(decInfo)) == e_success)
         {
-            if(decode_magic_string(decInfo) == e_success)
+            // Row padding / skipped alpha bytes : the carrier is not one byte stream
+            if(!decInfo -> layout.contiguous)
             {
-                if(decode_secret_file_extn_size(decInfo) == e_success)
+                close_files_dec(decInfo);
+                return do_decoding_mmap(decInfo);
+            }
+            Status magic = STATS_STAGE("metadata", decode_magic_string(decInfo));
+            if(magic == e_success && STATS_STAGE("metadata", decode_stego_version(decInfo)) == e_success)
+            {
+                if(STATS_STAGE("metadata", decode_secret_file_extn_size(decInfo)) == e_success)
                 {
-                    if(decode_secret_file_extn(decInfo) == e_success)
+                    if(STATS_STAGE("metadata", decode_secret_file_extn(decInfo)) == e_success)
                     {
-                        if(decode_secret_file_size(decInfo) == e_success)
+                        if(STATS_STAGE("metadata", decode_secret_file_size(decInfo)) == e_success
+                           && STATS_STAGE("metadata", decode_header_crc(decInfo)) == e_success
+                           && STATS_STAGE("open_output", open_output_file_dec(decInfo)) == e_success)
                         {
-                            if(decode_secret_file_data(decInfo) == e_success)
+                            if(STATS_STAGE("payload", decode_secret_file_data(decInfo)) == e_success)
                             {
-                               fclose(decInfo->fptr_stego_image);
-                               fclose(decInfo->fptr_secret_output);
+                                double start = stats_now();
+                                close_files_dec(decInfo);
+                                stats_stage_end("close", start);
                                 return e_success;
                             }
                         }
                     }
                 }
-
+            }
+            else if((magic != e_success && decode_retry_alpha(decInfo)) || decode_retry_flat(decInfo))
+            {
+                close_files_dec(decInfo);
+                return do_decoding(decInfo);
+            }
+            else if(magic != e_success)
+            {
+                fprintf(stderr, "ERROR: %s : %s\n", decInfo -> stego_image_fname, stego_strerror(e_stego_not_stego));
             }
         }
     }
+    close_files_dec(decInfo);
     return e_failure;
 }
 
-/* Skip BMP header (54 bytes)
+/* Close files
  * Input  : DecodeInfo pointer
- * Output : Moves file pointer to pixel data
+ * Output : Closes the stego image and output file, also after a
+ *          failed stage, so repeated jobs do not leak descriptors
+ */
+void close_files_dec(DecodeInfo* decInfo)
+{
+    if(decInfo -> fptr_stego_image != NULL)
+        fclose(decInfo -> fptr_stego_image);
+    if(decInfo -> fptr_secret_output != NULL)
+        fclose(decInfo -> fptr_secret_output);
+    decInfo -> fptr_stego_image = decInfo -> fptr_secret_output = NULL;
+}
+
+/* Skip BMP header
+ * Input  : DecodeInfo pointer
+ * Output : Pixel layout parsed from the header (or the flat layout of
+ *          images encoded before the parser), file pointer moved to
+ *          the pixel data
  */
 Status skip_bmp_header(DecodeInfo* decInfo)
 {
-    // skip the 54-byte BMP header
-    fseek(decInfo -> fptr_stego_image, 54, SEEK_SET);
+    if(decInfo -> flat_layout)
+    {
+        fseeko(decInfo -> fptr_stego_image, 0, SEEK_END);
+        bmp_flat_layout(ftello(decInfo -> fptr_stego_image), &decInfo -> layout);
+    }
+    else if(bmp_read_layout(decInfo -> fptr_stego_image, decInfo -> use_alpha, &decInfo -> layout) != e_success)
+    {
+        fprintf(stderr, "ERROR: %s is not a supported BMP (uncompressed 8, 24 or 32 bpp)\n", decInfo -> stego_image_fname);
+        return e_failure;
+    }
+    fseeko(decInfo -> fptr_stego_image, decInfo -> layout.offset, SEEK_SET);
     return e_success;
 }
 
+/* Retry with the other 32 bpp carrier
+ * Input  : DecodeInfo whose magic string did not match
+ * Output : --alpha is recorded in the stego header (STEGO_FLAG_ALPHA),
+ *          which lies in the carrier it names; a 32 bpp image whose
+ *          header is not found starts over once with use_alpha switched
+ * Return : 1 if a retry is worthwhile
+ */
+static int decode_retry_alpha(DecodeInfo* decInfo)
+{
+    if(decInfo -> alpha_probed || decInfo -> flat_layout || decInfo -> layout.bpp != 32)
+        return 0;
+    decInfo -> alpha_probed = 1;
+    decInfo -> use_alpha = !decInfo -> use_alpha;
+    return 1;
+}
+
+/* Retry with the flat layout
+ * Input  : DecodeInfo whose magic string did not match, or whose header
+ *          is a version 1 one
+ * Output : Images encoded before the BMP parser (version 1 headers) hid
+ *          their data right after the 54 byte header whatever the layout;
+ *          when the parsed layout differs from that, decoding starts over
+ *          with it
+ * Return : 1 if a retry is worthwhile
+ */
+static int decode_retry_flat(DecodeInfo* decInfo)
+{
+    if(decInfo -> flat_layout || bmp_is_flat(&decInfo -> layout))
+        return 0;
+    decInfo -> flat_layout = 1;
+    return 1;
+}
+
 /* Decode magic string "#*"
  * Input  : DecodeInfo structure
  * Output : Reads 2 encoded bytes and compares with MAGIC_STRING
@@ -154,7 +272,7 @@ Status skip_bmp_header(DecodeInfo* decInfo)
  */
 Status decode_magic_string(DecodeInfo* decInfo)
 {
-    printf("INFO: Decoding Magic String Signature\n");
+    PRINT_INFO("INFO: Decoding Magic String Signature\n");
     char magic_string[3];
     char image_buffer[8];
 
@@ -168,49 +286,94 @@ Status decode_magic_string(DecodeInfo* decInfo)
 
     if(strcmp(MAGIC_STRING, magic_string) == 0) // Comparing magic string with decoded magic string
     {
-        printf("INFO: Done\n");
+        PRINT_INFO("INFO: Done\n");
         return e_success;
     }
     return e_failure;
 }
 
-/* Decode 1 byte from 8 LSBs of buffer
- * Input  : 8-byte image buffer
- * Output : Decoded character
+/* Decode header version
+ * Input  : DecodeInfo structure, stream right after the magic string
+ * Output : Version and flags. The marker word is the extension size in
+ *          a version 1 header; the stream is then moved back onto it
+ * Return : e_success, or e_failure for an unknown version / flags and
+ *          for a version 1 header outside the flat layout
  */
-char decode_bytes_from_lsb(char* image_buffer)
+Status decode_stego_version(DecodeInfo* decInfo)
 {
-    char ch = 0;
-    for(int i = 0; i < 8; i++)
+    PRINT_INFO("INFO: Decoding Stego Header Version\n");
+    char image_buffer[32];
+
+    fread(image_buffer, sizeof(char), 32, decInfo -> fptr_stego_image);
+    uint marker = decode_int_from_lsb(image_buffer);
+    if(marker <= DECODE_EXTN_MAX)
     {
-        uint bit = image_buffer[i] & 1;  // Extract LSB
+        decInfo -> version = 1;
+        decInfo -> flags = 0;
+        fseeko(decInfo -> fptr_stego_image, -32, SEEK_CUR);
+        return bmp_is_flat(&decInfo -> layout) ? e_success : e_failure;
+    }
+    if(marker != (STEGO_MARKER | STEGO_VERSION) && marker != (STEGO_MARKER | 2))
+    {
+        fprintf(stderr, "ERROR: %s has an unsupported stego header version\n", decInfo -> stego_image_fname);
+        return e_failure;
+    }
 
-        if(bit)
-        {
-            ch = ch | 1 << (7 - i); // Form character bit by bit (MSB first)
-        }
+    fread(image_buffer, sizeof(char), 32, decInfo -> fptr_stego_image);
+    decInfo -> version = marker & 0xFFFF;
+    decInfo -> flags = decode_int_from_lsb(image_buffer);
+    if((decInfo -> flags & ~STEGO_FLAGS_KNOWN) || STEGO_BITS(decInfo -> flags) > 4)
+    {
+        fprintf(stderr, "ERROR: %s uses stego header flags 0x%x this version cannot read\n", decInfo -> stego_image_fname, decInfo -> flags);
+        return e_failure;
+    }
+    if(decInfo -> flags & STEGO_FLAG_SHARD)
+    {
+        fprintf(stderr, "ERROR: %s : %s\n", decInfo -> stego_image_fname, stego_strerror(e_stego_shard));
+        return e_failure;
     }
+    PRINT_INFO("INFO: Done. Version %u, %u bit(s) per byte%s\n", decInfo -> version, STEGO_BITS(decInfo -> flags),
+               decInfo -> flags & STEGO_FLAG_COMPRESSED ? ", compressed" : "");
+    return e_success;
+}
+
+/* Decode 1 byte from 8 LSBs of buffer
+ * Input  : 8-byte image buffer
+ * Output : Decoded character (MSB first)
+ */
+char decode_bytes_from_lsb(char* image_buffer)
+{
+    unsigned char ch;
+    lsb_extract((unsigned char *)image_buffer, &ch, 1);
     return ch;
 }
 
 /* Decode integer (4 bytes) from 32 LSBs
  * Input  : 32-byte buffer
- * Output : Decoded integer
+ * Output : Decoded integer (stored MSB first, i.e. big endian bytes)
  */
 uint decode_int_from_lsb(char* image_buffer)
 { 
-    uint num = 0;
+    unsigned char bytes[4];
 
     // Extracting 32 bits from 32 bytes
-    for(int i = 0; i < 32; i++)
-    {
-        uint bit = image_buffer[i] & 1;
-        if(bit)
-        {
-            num = num | (1 << (31 - i)); 
-        } 
-    }
-    return num;
+    lsb_extract((unsigned char *)image_buffer, bytes, 4);
+    return (uint)bytes[0] << 24 | (uint)bytes[1] << 16 | (uint)bytes[2] << 8 | bytes[3];
+}
+
+/* Decode 64-bit size from 64 LSBs
+ * Input  : 64-byte buffer
+ * Output : Decoded size (stored MSB first)
+ */
+uint64_t decode_size_from_lsb(char* image_buffer)
+{
+    unsigned char bytes[8];
+    uint64_t size = 0;
+
+    lsb_extract((unsigned char *)image_buffer, bytes, 8);
+    for(int i = 0; i < 8; i++)
+        size = size << 8 | bytes[i];
+    return size;
 }
 
 /* Decode secret file extension size
@@ -219,23 +382,28 @@ uint decode_int_from_lsb(char* image_buffer)
  */
 Status decode_secret_file_extn_size(DecodeInfo* decInfo)
 {
-    printf("INFO: Decoding Output File Extension Size\n");
+    PRINT_INFO("INFO: Decoding Output File Extension Size\n");
     char image_buffer[32];
 
     fread(image_buffer, sizeof(char), 32, decInfo -> fptr_stego_image);
     decInfo -> extn_size = decode_int_from_lsb(image_buffer); // Decoding 32 bit integer
+    if(decInfo -> extn_size > DECODE_EXTN_MAX)
+    {
+        fprintf(stderr, "ERROR: %s has an invalid extension size\n", decInfo -> stego_image_fname);
+        return e_failure;
+    }
 
-    printf("INFO: Done\n");
+    PRINT_INFO("INFO: Done\n");
     return e_success; 
 }
 
 /* Decode secret file extension (.txt / .c / .sh)
  * Input  : DecodeInfo pointer
- * Output : Builds output file name and opens output file
+ * Output : Builds output file name
  */
 Status decode_secret_file_extn(DecodeInfo* decInfo)
 {
-    printf("INFO: Decoding Output File Extension\n");
+    PRINT_INFO("INFO: Decoding Output File Extension\n");
     char extn[decInfo -> extn_size + 1];
     char image_buffer[8];
 
@@ -247,9 +415,24 @@ Status decode_secret_file_extn(DecodeInfo* decInfo)
     }
     extn[decInfo -> extn_size] = '\0'; // Adding null terminator
 
+    strcpy(decInfo -> extn_secret_file, extn);   // Kept for the header checksum
     strcat(decInfo -> secret_output_fname, extn); // Appends extension to output filename
 
-    printf("INFO: Opening %s\n", decInfo -> secret_output_fname);
+    PRINT_INFO("INFO: Done\n");
+    return e_success; 
+}
+
+/* Open output file
+ * Input  : DecodeInfo pointer, header decoded and checked
+ * Output : Opens the output file (only once the header is known good,
+ *          so a non stego image leaves no empty file behind); nothing
+ *          is opened with --verify
+ */
+Status open_output_file_dec(DecodeInfo* decInfo)
+{
+    if(decInfo -> verify)
+        return e_success;
+    PRINT_INFO("INFO: Opening %s\n", decInfo -> secret_output_fname);
 
     // Opening the final output file
     decInfo -> fptr_secret_output = fopen(decInfo -> secret_output_fname, "w");
@@ -259,45 +442,898 @@ Status decode_secret_file_extn(DecodeInfo* decInfo)
     	fprintf(stderr, "ERROR: Unable to open file %s\n", decInfo->secret_output_fname);
         return e_failure;
     }
-    printf("INFO: Done.Opened %s\n", decInfo -> secret_output_fname);
-
-    printf("INFO: Done\n");
+    if(decInfo -> io_buffer != NULL)
+    {
+        setvbuf(decInfo -> fptr_secret_output, decInfo -> io_buffer + decInfo -> io_buffer_size / 2, _IOFBF, decInfo -> io_buffer_size / 2);
+    }
+    PRINT_INFO("INFO: Done.Opened %s\n", decInfo -> secret_output_fname);
     return e_success; 
 }
 
 /* Decode secret file size
  * Input  : DecodeInfo pointer
- * Output : Extracts file size (integer)
+ * Output : Extracts file size (64-bit, 32-bit in a version 1 header)
+ * Return : e_failure if the carrier ends before that much data
  */
 Status decode_secret_file_size(DecodeInfo* decInfo)
 {
-    printf("INFO: Decoding %s File Size\n", decInfo -> secret_output_fname);
+    PRINT_INFO("INFO: Decoding %s File Size\n", decInfo -> secret_output_fname);
+    char image_buffer[64];
+
+    if(decInfo -> version == 1)
+    {
+        fread(image_buffer, sizeof(char), 32, decInfo -> fptr_stego_image);
+        decInfo -> secret_file_size = decode_int_from_lsb(image_buffer);
+    }
+    else
+    {
+        fread(image_buffer, sizeof(char), 64, decInfo -> fptr_stego_image);
+        decInfo -> secret_file_size = decode_size_from_lsb(image_buffer);
+    }
+
+    // Checked before any output is sized from it (division, no overflow)
+    uint64_t used = ftello(decInfo -> fptr_stego_image) - decInfo -> layout.offset;
+    uint64_t carrier = bmp_carrier_size(&decInfo -> layout);
+    uint64_t room = used > carrier ? 0 : lsb_payload_size(carrier - used, STEGO_BITS(decInfo -> flags));
+    if(used > carrier || decInfo -> secret_file_size > room
+       || room - decInfo -> secret_file_size < STEGO_TRAILER_SIZE(decInfo -> version))
+    {
+        fprintf(stderr, "ERROR: %s ends before the secret data\n", decInfo -> stego_image_fname);
+        return e_failure;
+    }
+
+    PRINT_INFO("INFO: Done\n");
+    return e_success; 
+}
+
+/* Decode header checksum
+ * Input  : DecodeInfo pointer, stream right after the file size
+ * Output : Reads the 32-bit header crc of a version 3 header and
+ *          compares it with the CRC32C of the fields decoded before it
+ * Return : e_success, or e_failure on a mismatch (and with --verify for
+ *          older images, which have no checksums)
+ */
+Status decode_header_crc(DecodeInfo* decInfo)
+{
+    unsigned char header[STEGO_HEADER_MAX];
     char image_buffer[32];
 
+    if(STEGO_TRAILER_SIZE(decInfo -> version) == 0)
+    {
+        if(!decInfo -> verify)
+            return e_success;
+        fprintf(stderr, "ERROR: %s has no checksums (stego header version %u)\n", decInfo -> stego_image_fname, decInfo -> version);
+        return e_failure;
+    }
+
+    PRINT_INFO("INFO: Checking Stego Header Checksum\n");
     fread(image_buffer, sizeof(char), 32, decInfo -> fptr_stego_image);
-    decInfo -> secret_file_size = decode_int_from_lsb(image_buffer);
+    size_t size = stego_build_header(decInfo -> extn_secret_file, decInfo -> secret_file_size, decInfo -> flags, header);
+    uint crc = (uint)header[size - 4] << 24 | (uint)header[size - 3] << 16 | (uint)header[size - 2] << 8 | header[size - 1];
+    if(decode_int_from_lsb(image_buffer) != crc)
+    {
+        fprintf(stderr, "ERROR: %s has a corrupt stego header (checksum mismatch)\n", decInfo -> stego_image_fname);
+        return e_failure;
+    }
+    PRINT_INFO("INFO: Done\n");
+    return e_success;
+}
 
-    printf("INFO: Done\n");
-    return e_success; 
+/* Check payload checksum
+ * Input  : DecodeInfo, the payload crc bytes extracted after the data
+ *          and the CRC32C of the extracted data
+ * Output : Reports a mismatch; a written output file is removed rather
+ *          than left holding damaged data
+ * Return : e_success if they match (or the image has no checksums)
+ */
+static Status decode_check_crc(DecodeInfo* decInfo, const unsigned char *trailer, uint32_t crc)
+{
+    if(STEGO_TRAILER_SIZE(decInfo -> version) == 0)
+        return e_success;
+    if(((uint32_t)trailer[0] << 24 | (uint32_t)trailer[1] << 16 | (uint32_t)trailer[2] << 8 | trailer[3]) == crc)
+    {
+        PRINT_INFO("INFO: Payload checksum %08x OK\n", crc);
+        return e_success;
+    }
+    fprintf(stderr, "ERROR: %s payload checksum mismatch, the image is corrupt%s\n", decInfo -> stego_image_fname,
+            stream_is_std(decInfo -> secret_output_fname) ? " (the data written to standard output is not valid)" : "");
+    if(decInfo -> fptr_secret_output != NULL && !stream_is_std(decInfo -> secret_output_fname))
+        remove(decInfo -> secret_output_fname);
+    return e_failure;
+}
+
+/* Write decompressed bytes to the output file (LzSink), dropped with --verify */
+static Status decode_sink(void *ctx, const unsigned char *data, size_t len)
+{
+    if(ctx == NULL)
+        return e_success;
+    return fwrite(data, 1, len, ctx) == len ? e_success : e_failure;
 }
 
 /* Decode secret file data (raw contents)
  * Input  : DecodeInfo pointer
  * Output : Writes decoded characters into output file
+ * Description : Image bytes are read in blocks of up to
+ * DECODE_BLOCK_SIZE payload bytes (8 / bits image bytes each, bits from
+ * the header flags), the LSB kernel extracts the whole block and it is
+ * written out with a single fwrite. A compressed payload is fed to the
+ * streaming decoder instead, which writes each block as it completes
+ * (always one thread, the stream is only decodable front to back).
+ * Each block is checksummed right after extraction and the total is
+ * checked against the payload crc that follows the data. Payloads of
+ * two pipeline blocks or more (and every payload with --uring) go
+ * through decode_secret_file_data_pipelined() instead
  */
 Status decode_secret_file_data(DecodeInfo* decInfo)
 {
-    printf("INFO: Decoding %s File Data\n", decInfo -> secret_output_fname);
-    char image_buffer[8];
+    uint compressed = decInfo -> flags & STEGO_FLAG_COMPRESSED;
+    if(decInfo -> threads > 1 && !compressed && !decInfo -> verify)
+    {
+        return decode_secret_file_data_parallel(decInfo);
+    }
+    uint block_size = decInfo -> block_size != 0 ? decInfo -> block_size : PIPE_BLOCK_SIZE;
+    if(decInfo -> ring != NULL || decInfo -> secret_file_size + STEGO_TRAILER_SIZE(decInfo -> version) >= 2 * (uint64_t)block_size)
+    {
+        return decode_secret_file_data_pipelined(decInfo);
+    }
+    PRINT_INFO("INFO: Decoding %s File Data\n", decInfo -> secret_output_fname);
+    unsigned char image_buffer[DECODE_BLOCK_SIZE * 8];
+    unsigned char data[DECODE_BLOCK_SIZE];
+    uint bits = STEGO_BITS(decInfo -> flags);
+    Status ret = e_success;
+    uint32_t crc = 0;
+    LzStream lz;
 
-    // Decode each byte of secret file
-    for(uint i = 0; i < decInfo -> secret_file_size; i++)
+    if(compressed && lz_stream_init(&lz, decode_sink, decInfo -> fptr_secret_output) != e_success)
     {
-        fread(image_buffer, sizeof(char), 8, decInfo -> fptr_stego_image);
-        char ch = decode_bytes_from_lsb(image_buffer); // convert LSBs to character
-        fputc(ch, decInfo -> fptr_secret_output);     // Writing to output file
+        fprintf(stderr, "ERROR: Out of memory\n");
+        return e_failure;
+    }
+
+    stats_block_size(DECODE_BLOCK_SIZE);
+    // Decode secret file block by block
+    for(uint64_t i = 0; i < decInfo -> secret_file_size; i += DECODE_BLOCK_SIZE)
+    {
+        uint count = decInfo -> secret_file_size - i < DECODE_BLOCK_SIZE ? decInfo -> secret_file_size - i : DECODE_BLOCK_SIZE;
+        size_t len = lsb_carrier_size(count, bits);
+
+        if(fread(image_buffer, 1, len, decInfo -> fptr_stego_image) != len)
+        {
+            fprintf(stderr, "ERROR: %s ends before the secret data\n", decInfo -> stego_image_fname);
+            ret = e_failure;
+            break;
+        }
+        crc = lsb_extract_bits_crc(image_buffer, data, count, bits, crc);     // convert LSBs to characters
+        if(compressed)
+        {
+            if((ret = lz_stream_feed(&lz, data, count)) != e_success)
+                break;
+        }
+        else if(decInfo -> fptr_secret_output != NULL)
+        {
+            fwrite(data, 1, count, decInfo -> fptr_secret_output);  // Writing to output file
+        }
+    }
+    if(compressed)
+    {
+        if(ret == e_success && lz_stream_end(&lz) != e_success)
+            ret = e_failure;
+        if(ret != e_success)
+            fprintf(stderr, "ERROR: %s holds a corrupt compressed payload\n", decInfo -> stego_image_fname);
+        lz_stream_free(&lz);
+    }
+    if(ret == e_success && STEGO_TRAILER_SIZE(decInfo -> version) > 0)
+    {
+        size_t len = lsb_carrier_size(STEGO_CRC_SIZE, bits);
+        if(fread(image_buffer, 1, len, decInfo -> fptr_stego_image) != len)
+        {
+            fprintf(stderr, "ERROR: %s ends before the payload checksum\n", decInfo -> stego_image_fname);
+            return e_failure;
+        }
+        lsb_extract_bits(image_buffer, data, STEGO_CRC_SIZE, bits);
+        ret = decode_check_crc(decInfo, data, crc);
+    }
+    if(ret == e_success)
+        PRINT_INFO("INFO: Done\n");
+    return ret;
+}
+
+/* State of the pipelined payload pass : the data stream is the secret
+ * data followed by its crc (version 3), cut into block_size blocks */
+typedef struct _DecodePipe
+{
+    DecodeInfo *decInfo;
+    int fd_stego, fd_out;         // fd_out -1 : nothing written (--verify, compressed payload)
+    off_t stego_off, out_off;     // First carrier byte of the secret data, first output byte
+    uint64_t size;                // Secret bytes
+    uint64_t total;               // Stream bytes (secret and trailer)
+    uint bits;
+    uint block_size;              // Stream bytes per block
+    uint32_t crc;
+    LzStream *lz;                 // Decoder of a compressed payload
+    unsigned char trailer[STEGO_CRC_SIZE];
+    unsigned char *data;          // Extracted bytes of the block in each slot, PIPE_SLOTS * block_size
+} DecodePipe;
+
+/* Reads of one block
+ * Input  : DecodePipe, block, slot and its carrier buffer
+ * Output : The carrier bytes of the block (slot buffer)
+ */
+static uint decode_pipe_reads(void *ctx, uint64_t block, uint slot, unsigned char *buffer, PipeIo *io)
+{
+    DecodePipe *job = ctx;
+    uint64_t start = block * job -> block_size;
+    uint count = job -> total - start < job -> block_size ? job -> total - start : job -> block_size;
+
+    (void)slot;
+    io[0] = (PipeIo) { job -> fd_stego, buffer, lsb_carrier_size(count, job -> bits),
+                        job -> stego_off + lsb_carrier_size(start, job -> bits), 1 };
+    return 1;
+}
+
+/* Transform one block
+ * Input  : DecodePipe, block (in order), slot and its carrier buffer
+ * Output : Secret bytes extracted and checksummed, then written to the
+ *          output at their offset (or fed to the stream decoder); trailer
+ *          bytes kept for the check at the end
+ */
+static Status decode_pipe_transform(void *ctx, uint64_t block, uint slot, unsigned char *buffer, PipeIo *io, uint *writes)
+{
+    DecodePipe *job = ctx;
+    uint64_t start = block * job -> block_size;
+    uint count = job -> total - start < job -> block_size ? job -> total - start : job -> block_size;
+    uint secret = start >= job -> size ? 0 : job -> size - start < count ? job -> size - start : count;
+
+    *writes = 0;
+    job -> crc = lsb_extract_bits_crc(buffer, job -> data + slot * job -> block_size, secret, job -> bits, job -> crc);
+    if(secret < count)
+        lsb_extract_bits(buffer + lsb_carrier_size(secret, job -> bits), job -> trailer + (start + secret - job -> size),
+                         count - secret, job -> bits);
+
+    if(job -> lz != NULL)
+    {
+        if(lz_stream_feed(job -> lz, job -> data + slot * job -> block_size, secret) != e_success)
+        {
+            fprintf(stderr, "ERROR: %s holds a corrupt compressed payload\n", job -> decInfo -> stego_image_fname);
+            return e_failure;
+        }
+    }
+    else if(job -> fd_out >= 0 && secret > 0)
+    {
+        io[0] = (PipeIo) { job -> fd_out, job -> data + slot * job -> block_size, secret, job -> out_off + start, 0 };
+        *writes = 1;
     }
-    printf("INFO: Done\n");
     return e_success;
 }
 
+/* Decode secret file data through the block pipeline
+ * Input  : DecodeInfo, the image stream just past the header
+ * Output : Same output as decode_secret_file_data(), with up to
+ *          PIPE_SLOTS blocks in flight : image reads of upcoming blocks
+ *          and output writes of extracted ones overlap the LSB stage, on
+ *          reader / writer threads or through the ring (--uring).
+ *          A compressed payload is decompressed on the way and written
+ *          through stdio
+ * Return : e_success, or e_failure on an I/O error or a checksum mismatch
+ */
+Status decode_secret_file_data_pipelined(DecodeInfo* decInfo)
+{
+    PRINT_INFO("INFO: Decoding %s File Data (%s)\n", decInfo -> secret_output_fname, decInfo -> ring != NULL ? "io_uring" : "pipeline");
+    DecodePipe job = { 0 };
+    PipeJob pass = { 0 };
+    LzStream lz;
+
+    job.decInfo = decInfo;
+    job.fd_stego = fileno(decInfo -> fptr_stego_image);
+    job.fd_out = -1;
+    job.stego_off = ftello(decInfo -> fptr_stego_image);    // logical position, stdio may have read ahead
+    job.size = decInfo -> secret_file_size;
+    job.total = job.size + STEGO_TRAILER_SIZE(decInfo -> version);
+    job.bits = STEGO_BITS(decInfo -> flags);
+    job.block_size = decInfo -> block_size != 0 ? decInfo -> block_size : PIPE_BLOCK_SIZE;
+    if(decInfo -> flags & STEGO_FLAG_COMPRESSED)
+    {
+        if(lz_stream_init(&lz, decode_sink, decInfo -> fptr_secret_output) != e_success)
+        {
+            fprintf(stderr, "ERROR: Out of memory\n");
+            return e_failure;
+        }
+        job.lz = &lz;
+    }
+    else if(decInfo -> fptr_secret_output != NULL)
+    {
+        fflush(decInfo -> fptr_secret_output);
+        job.fd_out = fileno(decInfo -> fptr_secret_output);
+        job.out_off = ftello(decInfo -> fptr_secret_output);
+    }
+    job.data = malloc((size_t)PIPE_SLOTS * job.block_size);
+
+    Status ret = job.stego_off < 0 || job.out_off < 0 || job.data == NULL ? e_failure : e_success;
+    if(ret == e_success)
+    {
+        pass.blocks = (job.total + job.block_size - 1) / job.block_size;
+        pass.block_size = job.block_size;
+        pass.ctx = &job;
+        pass.reads = decode_pipe_reads;
+        pass.transform = decode_pipe_transform;
+        stats_block_size(job.block_size);
+        ret = decInfo -> ring != NULL ? uring_run(decInfo -> ring, &pass) : pipe_run(&pass);
+    }
+    free(job.data);
+    if(job.lz != NULL)
+    {
+        if(ret == e_success && lz_stream_end(job.lz) != e_success)
+        {
+            fprintf(stderr, "ERROR: %s holds a corrupt compressed payload\n", decInfo -> stego_image_fname);
+            ret = e_failure;
+        }
+        lz_stream_free(job.lz);
+    }
+    if(ret != e_success)
+    {
+        fprintf(stderr, "ERROR: Unable to decode %s\n", decInfo -> stego_image_fname);
+        return e_failure;
+    }
+
+    // Keep the streams consistent with the bytes moved behind their back
+    fseeko(decInfo -> fptr_stego_image, job.stego_off + lsb_carrier_size(job.total, job.bits), SEEK_SET);
+    if(job.fd_out >= 0)
+        fseeko(decInfo -> fptr_secret_output, job.out_off + job.size, SEEK_SET);
+    ret = decode_check_crc(decInfo, job.trailer, job.crc);
+    if(ret == e_success)
+        PRINT_INFO("INFO: Done\n");
+    return ret;
+}
+
+/* Decode a stream from a mapped image
+ * Input  : DecodeInfo (output file open unless --verify), layout, pixel
+ *          array and carrier position of the payload
+ * Output : Payload extracted a block at a time through bmp_extract() and
+ *          decompressed into the output file (compressed payloads) or
+ *          only checksummed (--verify)
+ * Return : e_success, with the CRC32C of the payload in crc
+ */
+static Status decode_stream_mapped(DecodeInfo* decInfo, const BmpLayout *layout, const unsigned char *pixels, uint64_t pos,
+                                   uint32_t *crc)
+{
+    unsigned char data[DECODE_BLOCK_SIZE];
+    uint bits = STEGO_BITS(decInfo -> flags);
+    uint compressed = decInfo -> flags & STEGO_FLAG_COMPRESSED;
+    Status ret = e_success;
+    LzStream lz;
+
+    if(compressed && lz_stream_init(&lz, decode_sink, decInfo -> fptr_secret_output) != e_success)
+    {
+        fprintf(stderr, "ERROR: Out of memory\n");
+        return e_failure;
+    }
+    for(uint64_t i = 0; ret == e_success && i < decInfo -> secret_file_size; i += DECODE_BLOCK_SIZE)
+    {
+        uint count = decInfo -> secret_file_size - i < DECODE_BLOCK_SIZE ? decInfo -> secret_file_size - i : DECODE_BLOCK_SIZE;
+        bmp_extract(layout, pixels, pos, data, count, bits, crc);
+        pos += lsb_carrier_size(count, bits);
+        if(compressed)
+            ret = lz_stream_feed(&lz, data, count);
+    }
+    if(compressed)
+    {
+        if(ret == e_success)
+            ret = lz_stream_end(&lz);
+        if(ret != e_success)
+            fprintf(stderr, "ERROR: %s holds a corrupt compressed payload\n", decInfo -> stego_image_fname);
+        lz_stream_free(&lz);
+    }
+    return ret;
+}
+
+/* One thread's share of the secret data */
+typedef struct _DecodeSlice
+{
+    int fd_image;                 // Stego image (pread) or -1 when mapped
+    int fd_output;                // Output file (pwrite) or -1 when mapped
+    const unsigned char *image;   // Mapped image bytes of this slice
+    unsigned char *output;        // Mapped output bytes of this slice
+    off_t image_offset;           // Image offset of the slice's first byte
+    off_t output_offset;          // Output offset of the slice's first byte
+    uint64_t size;                // Secret bytes in this slice
+    uint bits;                    // Secret bits per image byte
+    uint32_t crc;                 // CRC32C of the slice's secret bytes
+    Status status;
+} DecodeSlice;
+
+/* Decode slice (thread entry)
+ * Input  : DecodeSlice
+ * Output : Secret bytes of the slice extracted and checksummed, either
+ *          map to map or block wise with pread / pwrite at the computed
+ *          offsets
+ */
+static void *decode_slice_worker(void *arg)
+{
+    DecodeSlice *slice = arg;
+    slice -> status = e_success;
+    slice -> crc = 0;
+
+    if(slice -> fd_image < 0)
+    {
+        slice -> crc = lsb_extract_bits_crc(slice -> image, slice -> output, slice -> size, slice -> bits, 0);
+        return NULL;
+    }
+
+    unsigned char image_buffer[DECODE_BLOCK_SIZE * 8];
+    unsigned char data[DECODE_BLOCK_SIZE];
+    for(uint64_t i = 0; i < slice -> size; i += DECODE_BLOCK_SIZE)
+    {
+        uint count = slice -> size - i < DECODE_BLOCK_SIZE ? slice -> size - i : DECODE_BLOCK_SIZE;
+        ssize_t len = lsb_carrier_size(count, slice -> bits);
+
+        if(pread(slice -> fd_image, image_buffer, len, slice -> image_offset + (off_t)lsb_carrier_size(i, slice -> bits)) != len)
+        {
+            slice -> status = e_failure;
+            break;
+        }
+        slice -> crc = lsb_extract_bits_crc(image_buffer, data, count, slice -> bits, slice -> crc);
+        if(pwrite(slice -> fd_output, data, count, slice -> output_offset + i) != (ssize_t)count)
+        {
+            slice -> status = e_failure;
+            break;
+        }
+    }
+    return NULL;
+}
+
+/* Run decode slices
+ * Input  : Template slice covering the whole secret data, thread count
+ * Output : The range is cut into one disjoint slice per thread (secret
+ *          byte i always comes from image bytes image_offset + 8 / bits * i),
+ *          the slices run concurrently and are joined
+ * Output : CRC32C of the whole range, combined from the slices in order
+ * Return : e_success if every slice succeeded
+ */
+static Status decode_run_slices(const DecodeSlice *whole, uint threads, uint32_t *crc)
+{
+    DecodeSlice slices[MAX_WORKERS];
+    pthread_t tids[MAX_WORKERS];
+    int started[MAX_WORKERS];
+    Status ret = e_success;
+
+    if(threads > MAX_WORKERS)
+        threads = MAX_WORKERS;
+    uint64_t step = (whole -> size / threads + 4095) & ~(uint64_t)4095;  // whole output pages
+
+    for(uint t = 0; t < threads; t++)
+    {
+        uint64_t start = t * step < whole -> size ? t * step : whole -> size;
+        uint64_t end = (t == threads - 1 || start + step > whole -> size) ? whole -> size : start + step;
+
+        slices[t] = *whole;
+        slices[t].image_offset += (off_t)lsb_carrier_size(start, whole -> bits);
+        slices[t].output_offset += start;
+        if(whole -> fd_image < 0)
+        {
+            slices[t].image += lsb_carrier_size(start, whole -> bits);
+            slices[t].output += start;
+        }
+        slices[t].size = end - start;
+        started[t] = pthread_create(&tids[t], NULL, decode_slice_worker, &slices[t]) == 0;
+        if(!started[t])
+        {
+            decode_slice_worker(&slices[t]);    // no thread, do it here
+        }
+    }
+    *crc = 0;
+    for(uint t = 0; t < threads; t++)
+    {
+        if(started[t])
+            pthread_join(tids[t], NULL);
+        if(slices[t].status != e_success)
+            ret = e_failure;
+        *crc = crc32c_combine(*crc, slices[t].crc, slices[t].size);
+    }
+    return ret;
+}
+
+/* Decode secret file data in parallel
+ * Input  : DecodeInfo pointer, stego image positioned at the data
+ * Output : Output file sized to secret_file_size, then every thread
+ *          preads its part of the image and pwrites its part of the
+ *          output at the computed offsets. The slice checksums are
+ *          combined and checked against the payload crc
+ */
+Status decode_secret_file_data_parallel(DecodeInfo* decInfo)
+{
+    PRINT_INFO("INFO: Decoding %s File Data (%u threads)\n", decInfo -> secret_output_fname, decInfo -> threads);
+
+    fflush(decInfo -> fptr_secret_output);
+    uint bits = STEGO_BITS(decInfo -> flags);
+    DecodeSlice whole = { fileno(decInfo -> fptr_stego_image), fileno(decInfo -> fptr_secret_output), NULL, NULL,
+                          ftello(decInfo -> fptr_stego_image), 0, decInfo -> secret_file_size, bits, 0, e_success };
+    unsigned char image_buffer[STEGO_CRC_SIZE * 8];
+    unsigned char trailer[STEGO_CRC_SIZE];
+    ssize_t len = lsb_carrier_size(STEGO_CRC_SIZE, bits);
+    uint32_t crc;
+
+    if(ftruncate(whole.fd_output, decInfo -> secret_file_size) != 0 || decode_run_slices(&whole, decInfo -> threads, &crc) != e_success)
+    {
+        fprintf(stderr, "ERROR: Unable to decode %s from %s\n", decInfo -> secret_output_fname, decInfo -> stego_image_fname);
+        return e_failure;
+    }
+    if(STEGO_TRAILER_SIZE(decInfo -> version) > 0)
+    {
+        if(pread(whole.fd_image, image_buffer, len, whole.image_offset + (off_t)lsb_carrier_size(whole.size, bits)) != len)
+        {
+            fprintf(stderr, "ERROR: %s ends before the payload checksum\n", decInfo -> stego_image_fname);
+            return e_failure;
+        }
+        lsb_extract_bits(image_buffer, trailer, STEGO_CRC_SIZE, bits);
+        if(decode_check_crc(decInfo, trailer, crc) != e_success)
+            return e_failure;
+    }
+    PRINT_INFO("INFO: Done\n");
+    return e_success;
+}
+
+/* Do decoding over memory mapped files
+ * Input  : DecodeInfo structure
+ * Output : Same secret file as do_decoding(), but the stego image is
+ *          mapped read-only and the output file is pre-sized with
+ *          ftruncate to exactly secret_file_size bytes and mapped, so
+ *          the data is extracted from pixel memory into output memory
+ *          in one pass without any per-block read or write calls
+ */
+Status do_decoding_mmap(DecodeInfo* decInfo)
+{
+    if(STATS_STAGE("open", open_files_dec(decInfo)) != e_success)
+    {
+        close_files_dec(decInfo);
+        return e_failure;
+    }
+    PRINT_INFO("INFO: ## Decoding Procedure Started (mmap) ##\n");
+
+    double start = stats_now();
+    fseeko(decInfo -> fptr_stego_image, 0, SEEK_END);
+    off_t image_size = ftello(decInfo -> fptr_stego_image);
+    unsigned char *image = MAP_FAILED;
+    if(image_size > 0)
+    {
+        image = mmap(NULL, image_size, PROT_READ, MAP_PRIVATE, fileno(decInfo -> fptr_stego_image), 0);
+    }
+    if(image == MAP_FAILED)
+    {
+        perror("mmap");
+        fprintf(stderr, "ERROR: Unable to map %s\n", decInfo -> stego_image_fname);
+        close_files_dec(decInfo);
+        return e_failure;
+    }
+    madvise(image, image_size, MADV_SEQUENTIAL);
+    stats_stage_end("map", start);
+
+    Status ret = e_failure;
+    int retry = 0;
+    uint64_t pos = 0;
+    unsigned char *output = MAP_FAILED;
+    unsigned char trailer[STEGO_CRC_SIZE];
+    uint32_t crc = 0;
+
+    do
+    {
+        start = stats_now();
+        if(decInfo -> flat_layout)
+        {
+            bmp_flat_layout(image_size, &decInfo -> layout);
+        }
+        else if(bmp_parse(image, image_size, image_size, decInfo -> use_alpha, &decInfo -> layout) != e_success)
+        {
+            fprintf(stderr, "ERROR: %s is not a supported BMP image\n", decInfo -> stego_image_fname);
+            break;
+        }
+        const BmpLayout *layout = &decInfo -> layout;
+        const unsigned char *pixels = image + layout -> offset;
+        uint64_t carrier = bmp_carrier_size(layout);
+
+        // Whole stego header, at most STEGO_HEADER_MAX bytes, lies before the data
+        unsigned char header[STEGO_HEADER_MAX * 8];
+        StegoHeader stego;
+        bmp_gather(layout, pixels, 0, header, carrier < sizeof(header) ? carrier : sizeof(header));
+
+        PRINT_INFO("INFO: Decoding Stego Header\n");
+        StegoStatus status = stego_parse_header(header, carrier, &stego);
+        if(status == e_stego_ok && decInfo -> alpha_probed && bmp_uses_alpha(layout) && !STEGO_ALPHA_CONFIRMED(stego))
+            status = e_stego_not_stego;
+        if(status == e_stego_ok && (stego.flags & STEGO_FLAG_SHARD))
+            status = e_stego_shard;
+        if(status == e_stego_not_stego || (status == e_stego_ok && stego.version == 1 && !bmp_is_flat(layout)))
+        {
+            retry = (status == e_stego_not_stego && decode_retry_alpha(decInfo)) || decode_retry_flat(decInfo);
+            if(!retry && status == e_stego_not_stego)
+                fprintf(stderr, "ERROR: %s : %s\n", decInfo -> stego_image_fname, stego_strerror(status));
+            break;
+        }
+        if(status != e_stego_ok)
+        {
+            fprintf(stderr, "ERROR: %s : %s\n", decInfo -> stego_image_fname, stego_strerror(status));
+            break;
+        }
+        if(decInfo -> verify && STEGO_TRAILER_SIZE(stego.version) == 0)
+        {
+            fprintf(stderr, "ERROR: %s has no checksums (stego header version %u)\n", decInfo -> stego_image_fname, stego.version);
+            break;
+        }
+        decInfo -> version = stego.version;
+        decInfo -> flags = stego.flags;
+        decInfo -> extn_size = strlen(stego.extn);
+        decInfo -> secret_file_size = stego.payload_len;
+        pos = (uint64_t)stego.size * 8;
+        strcpy(decInfo -> extn_secret_file, stego.extn);
+        strcat(decInfo -> secret_output_fname, stego.extn);
+        uint compressed = decInfo -> flags & STEGO_FLAG_COMPRESSED;
+        uint streamed = compressed || decInfo -> verify;
+        PRINT_INFO("INFO: Done. Version %u, %u bit(s) per byte, %s, %llu bytes%s\n", decInfo -> version, STEGO_BITS(decInfo -> flags),
+                   decInfo -> secret_output_fname, (unsigned long long)decInfo -> secret_file_size, compressed ? " compressed" : "");
+
+        stats_stage_end("metadata", start);
+
+        // Output is created with its final size and mapped shared (a
+        // compressed payload is written as it is decompressed instead,
+        // --verify writes nothing)
+        start = stats_now();
+        if(!decInfo -> verify)
+        {
+            PRINT_INFO("INFO: Opening %s\n", decInfo -> secret_output_fname);
+            decInfo -> fptr_secret_output = fopen(decInfo -> secret_output_fname, "w+");
+            if(decInfo -> fptr_secret_output == NULL)
+            {
+                perror("fopen");
+                fprintf(stderr, "ERROR: Unable to open file %s\n", decInfo -> secret_output_fname);
+                break;
+            }
+        }
+        if(decInfo -> secret_file_size > 0 && !streamed)
+        {
+            if(ftruncate(fileno(decInfo -> fptr_secret_output), decInfo -> secret_file_size) == 0)
+            {
+                output = mmap(NULL, decInfo -> secret_file_size, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(decInfo -> fptr_secret_output), 0);
+            }
+            if(output == MAP_FAILED)
+            {
+                perror("mmap");
+                fprintf(stderr, "ERROR: Unable to map %s\n", decInfo -> secret_output_fname);
+                break;
+            }
+        }
+
+        stats_stage_end("open_output", start);
+
+        start = stats_now();
+        PRINT_INFO("INFO: Decoding %s File Data\n", decInfo -> secret_output_fname);
+        if(streamed)
+        {
+            if(decode_stream_mapped(decInfo, layout, pixels, pos, &crc) != e_success)
+                break;
+        }
+        else if(decInfo -> secret_file_size > 0 && layout -> contiguous)
+        {
+            long offset = layout -> offset + pos;
+            DecodeSlice whole = { -1, -1, image + offset, output, offset, 0, decInfo -> secret_file_size,
+                                  STEGO_BITS(decInfo -> flags), 0, e_success };
+            decode_run_slices(&whole, decInfo -> threads > 1 ? decInfo -> threads : 1, &crc);
+        }
+        else if(decInfo -> secret_file_size > 0)
+        {
+            // Padded rows / skipped alpha : gathered chunk by chunk
+            bmp_extract(layout, pixels, pos, output, decInfo -> secret_file_size, STEGO_BITS(decInfo -> flags), &crc);
+        }
+
+        // Payload crc follows the data at the same depth
+        if(STEGO_TRAILER_SIZE(decInfo -> version) > 0)
+        {
+            bmp_extract(layout, pixels, pos + lsb_carrier_size(decInfo -> secret_file_size, STEGO_BITS(decInfo -> flags)),
+                        trailer, STEGO_CRC_SIZE, STEGO_BITS(decInfo -> flags), NULL);
+            if(decode_check_crc(decInfo, trailer, crc) != e_success)
+                break;
+        }
+        stats_stage_end("payload", start);
+        PRINT_INFO("INFO: Done\n");
+        ret = e_success;
+    } while(0);
+
+    start = stats_now();
+    if(output != MAP_FAILED)
+        munmap(output, decInfo -> secret_file_size);
+    munmap(image, image_size);
+    close_files_dec(decInfo);
+    stats_stage_end("close", start);
+    return retry ? do_decoding_mmap(decInfo) : ret;
+}
+
+/* Decode the pixel array in one forward pass
+ * Input  : DecodeInfo, the stego image stream at its first pixel byte
+ * Output : Windows of stream_window_rows() rows are read in order; the
+ *          stego header is parsed from the first one, then the secret
+ *          data and payload crc are extracted from the part of each
+ *          window they fall in and written out (or fed to the stream
+ *          decoder) straight away. The rest of the image is read and
+ *          dropped, so a writer upstream is never cut off
+ * Return : e_success, or e_failure on a bad header, an I/O error or a
+ *          checksum mismatch
+ */
+static Status decode_stream_pixels(DecodeInfo* decInfo)
+{
+    BmpLayout *layout = &decInfo -> layout;
+    uint64_t rows = stream_window_rows(layout);
+    unsigned char *window = malloc(rows * layout -> stride);
+    unsigned char *data = malloc(rows * layout -> stride);
+    unsigned char header[STEGO_HEADER_MAX * 8];
+    unsigned char trailer[STEGO_CRC_SIZE];
+    uint64_t payload = 0, trailer_pos = 0, end = 1, first, n;
+    uint bits = 1;
+    uint32_t crc = 0;
+    LzStream lz, *stream = NULL;
+    Status ret = window != NULL && data != NULL ? e_success : e_failure;
+
+    for(uint64_t row = 0, pos = 0; ret == e_success && pos < end; row += rows)
+    {
+        uint64_t count = layout -> height - row < rows ? layout -> height - row : rows;
+        uint64_t next = pos + count * layout -> row_bytes;
+
+        if(stream_read(decInfo -> fptr_stego_image, window, count * layout -> stride) != e_success)
+        {
+            fprintf(stderr, "ERROR: %s ends inside its pixel array\n", decInfo -> stego_image_fname);
+            ret = e_failure;
+            break;
+        }
+
+        // Stego header : the first window holds all of it. When it is not
+        // found in a 32 bpp image, the carrier with --alpha switched is tried
+        if(row == 0)
+        {
+            StegoHeader stego;
+            bmp_gather(layout, window, 0, header, next < sizeof(header) ? next : sizeof(header));
+
+            PRINT_INFO("INFO: Decoding Stego Header\n");
+            StegoStatus status = stego_parse_header(header, bmp_carrier_size(layout), &stego);
+            if(status == e_stego_not_stego && layout -> bpp == 32)
+            {
+                bmp_set_alpha(layout, !decInfo -> use_alpha);
+                next = count * layout -> row_bytes;
+                bmp_gather(layout, window, 0, header, next < sizeof(header) ? next : sizeof(header));
+                status = stego_parse_header(header, bmp_carrier_size(layout), &stego);
+                if(status == e_stego_ok && bmp_uses_alpha(layout) && !STEGO_ALPHA_CONFIRMED(stego))
+                    status = e_stego_not_stego;
+            }
+            if(status == e_stego_ok && (stego.flags & STEGO_FLAG_SHARD))
+                status = e_stego_shard;
+            if(status != e_stego_ok)
+            {
+                fprintf(stderr, "ERROR: %s : %s\n", decInfo -> stego_image_fname, stego_strerror(status));
+                ret = e_failure;
+                break;
+            }
+            if(decInfo -> verify && STEGO_TRAILER_SIZE(stego.version) == 0)
+            {
+                fprintf(stderr, "ERROR: %s has no checksums (stego header version %u)\n", decInfo -> stego_image_fname, stego.version);
+                ret = e_failure;
+                break;
+            }
+            decInfo -> version = stego.version;
+            decInfo -> flags = stego.flags;
+            decInfo -> extn_size = strlen(stego.extn);
+            decInfo -> secret_file_size = stego.payload_len;
+            strcpy(decInfo -> extn_secret_file, stego.extn);
+            bits = STEGO_BITS(stego.flags);
+            payload = (uint64_t)stego.size * 8;
+            trailer_pos = payload + lsb_carrier_size(stego.payload_len, bits);
+            end = trailer_pos + lsb_carrier_size(STEGO_TRAILER_SIZE(stego.version), bits);
+
+            // Standard output takes the data as is, a named output gets the extension
+            if(!decInfo -> verify && stream_is_std(decInfo -> secret_output_fname))
+            {
+                decInfo -> fptr_secret_output = stream_stdout();
+                ret = decInfo -> fptr_secret_output != NULL ? e_success : e_failure;
+            }
+            else
+            {
+                strcat(decInfo -> secret_output_fname, stego.extn);
+                ret = open_output_file_dec(decInfo);
+            }
+            if(ret == e_success && (decInfo -> flags & STEGO_FLAG_COMPRESSED))
+            {
+                if(lz_stream_init(&lz, decode_sink, decInfo -> fptr_secret_output) != e_success)
+                {
+                    fprintf(stderr, "ERROR: Out of memory\n");
+                    ret = e_failure;
+                    break;
+                }
+                stream = &lz;
+            }
+            if(ret != e_success)
+                break;
+            PRINT_INFO("INFO: Decoding %s File Data (%llu rows per window)\n", decInfo -> secret_output_fname, (unsigned long long)rows);
+        }
+
+        if((n = stream_window_part(pos, next, payload, decInfo -> secret_file_size, bits, &first)) > 0)
+        {
+            bmp_extract(layout, window, payload + lsb_carrier_size(first, bits) - pos, data, n, bits, &crc);
+            if(stream != NULL)
+            {
+                if(lz_stream_feed(stream, data, n) != e_success)
+                {
+                    fprintf(stderr, "ERROR: %s holds a corrupt compressed payload\n", decInfo -> stego_image_fname);
+                    ret = e_failure;
+                }
+            }
+            else if(decInfo -> fptr_secret_output != NULL && fwrite(data, 1, n, decInfo -> fptr_secret_output) != n)
+            {
+                fprintf(stderr, "ERROR: Unable to write %s\n", decInfo -> secret_output_fname);
+                ret = e_failure;
+            }
+        }
+        if((n = stream_window_part(pos, next, trailer_pos, STEGO_TRAILER_SIZE(decInfo -> version), bits, &first)) > 0)
+            bmp_extract(layout, window, trailer_pos + lsb_carrier_size(first, bits) - pos, trailer + first, n, bits, NULL);
+        pos = next;
+    }
+    free(window);
+    free(data);
+
+    if(stream != NULL)
+    {
+        if(ret == e_success && lz_stream_end(stream) != e_success)
+        {
+            fprintf(stderr, "ERROR: %s holds a corrupt compressed payload\n", decInfo -> stego_image_fname);
+            ret = e_failure;
+        }
+        lz_stream_free(stream);
+    }
+    if(ret == e_success && decInfo -> fptr_secret_output != NULL && fflush(decInfo -> fptr_secret_output) != 0)
+    {
+        perror("fflush");
+        ret = e_failure;
+    }
+    if(ret == e_success)
+        ret = decode_check_crc(decInfo, trailer, crc);
+    if(ret == e_success)
+        ret = stream_copy(decInfo -> fptr_stego_image, NULL, UINT64_MAX);
+    if(ret == e_success)
+        PRINT_INFO("INFO: Done\n");
+    return ret;
+}
+
+/* Do decoding in one forward pass
+ * Input  : DecodeInfo with "-" for the stego image and / or the output
+ * Output : Same secret as do_decoding(), the stego image read front to
+ *          back without seeking and the secret written as it is
+ *          extracted, memory bounded by one window of rows. A payload
+ *          crc mismatch is only known once the data has gone out, it is
+ *          reported on stderr and through the return value. Images
+ *          written before the BMP parser whose parsed layout is not the
+ *          flat one can not be told apart without going back, they need
+ *          a named file
+ * Return : e_success or e_failure
+ */
+Status do_decoding_stream(DecodeInfo* decInfo)
+{
+    Status ret = e_failure;
+
+    PRINT_INFO("INFO: Opening required files (streaming)\n");
+    decInfo -> fptr_secret_output = NULL;
+    decInfo -> fptr_stego_image = stream_is_std(decInfo -> stego_image_fname) ? stdin : fopen(decInfo -> stego_image_fname, "r");
+    if(decInfo -> fptr_stego_image == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: Unable to open file %s\n", decInfo -> stego_image_fname);
+        return e_failure;
+    }
+
+    PRINT_INFO("INFO: ## Decoding Procedure Started ##\n");
+    if(STATS_STAGE("header_skip", stream_read_layout(decInfo -> fptr_stego_image, NULL, decInfo -> use_alpha, &decInfo -> layout)) != e_success)
+    {
+        fprintf(stderr, "ERROR: %s is not a supported BMP (uncompressed 8, 24 or 32 bpp)\n", decInfo -> stego_image_fname);
+    }
+    else
+    {
+        ret = STATS_STAGE("payload", decode_stream_pixels(decInfo));
+    }
+    double start = stats_now();
+    close_files_dec(decInfo);
+    stats_stage_end("close", start);
+    return ret;
+}
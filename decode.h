@@ -1,8 +1,18 @@
 #ifndef DECODE_H
 #define DECODE_H
 
+#include <stdio.h>
+#include <stdint.h>
+#include "bmp.h"
+#include "uring.h"
 #include "types.h"
 
+/* Payload bytes extracted per read/extract/write block */
+#define DECODE_BLOCK_SIZE 4096
+
+/* Longest secret file extension (".txt") */
+#define DECODE_EXTN_MAX 4
+
 /* 
  * Structure to store information required for 
  * decoding a secret file from a stego BMP image.
@@ -17,11 +27,28 @@ typedef struct _DecodeInfo
     FILE* fptr_stego_image;  // Encoded image file pointer
 
     /* Output Secret File Info */
-    char secret_output_fname[50]; // Storing filename of output file(without extension)
+    char secret_output_fname[FILENAME_MAX]; // Storing filename of output file(without extension)
     FILE* fptr_secret_output; // Output file pointer
 
+    uint version;             // Stego header version (1 : legacy 32-bit sizes)
+    uint flags;               // Stego header flag bits
     uint extn_size;           // Stores secret file extension size
-    uint secret_file_size;  // stores secret file size
+    char extn_secret_file[DECODE_EXTN_MAX + 1]; // Secret file extension
+    uint64_t secret_file_size;  // stores secret file size
+    BmpLayout layout;       // Pixel layout of the stego image
+
+    /* Decoding options */
+    uint use_mmap;          // Decode through memory mapped files (--mmap)
+    uint threads;           // Threads extracting the secret data (-j N)
+    uint use_alpha;         // 32 bpp carriers also hold data in alpha bytes (--alpha)
+    uint flat_layout;       // Read the carrier right after the 54 byte header (images encoded before the BMP parser)
+    uint alpha_probed;      // use_alpha was switched after the header was not found (STEGO_FLAG_ALPHA)
+    uint verify;            // Check the header and payload checksums only, write no output (--verify)
+    uint stream;            // Single forward pass over pipes ("-" stego image / output)
+    char *io_buffer;        // Optional caller owned stdio buffer for the streams
+    size_t io_buffer_size;  // Its size (split between stego image and output)
+    Uring *ring;            // Optional io_uring of the streaming payload stage (--uring), NULL : reader / writer threads
+    uint block_size;        // Payload bytes per pipeline block (--block-size), 0 : PIPE_BLOCK_SIZE
 
 }DecodeInfo;
 
@@ -36,18 +63,27 @@ Status read_and_validate_decode_args(char* argv[], DecodeInfo *decInfo);
 /* Perform the decoding */
 Status do_decoding(DecodeInfo* decInfo);
 
-/* Skip BMP header (54 bytes) */
+/* Close the stego image and output file */
+void close_files_dec(DecodeInfo* decInfo);
+
+/* Parse BMP header and seek to the pixel array */
 Status skip_bmp_header(DecodeInfo* decInfo);
 
 /* Decode magic string from image (#*) */
 Status decode_magic_string(DecodeInfo* decInfo);
 
+/* Decode header version marker and flags */
+Status decode_stego_version(DecodeInfo* decInfo);
+
 /* Decode a byte from 8 LSBs */
 char decode_bytes_from_lsb(char* image_buffer);
 
 /* Decde an integer (32 bits) from 32 LSBs */
 uint decode_int_from_lsb(char* image_buffer);
 
+/* Decode a 64-bit size from 64 LSBs */
+uint64_t decode_size_from_lsb(char* image_buffer);
+
 /* Decode secret file extension size */
 Status decode_secret_file_extn_size(DecodeInfo* decInfo);
 
@@ -57,7 +93,25 @@ Status decode_secret_file_extn(DecodeInfo* decInfo);
 /* Decode secret file size */
 Status decode_secret_file_size(DecodeInfo* decInfo);
 
+/* Check the header checksum (version 3 headers) */
+Status decode_header_crc(DecodeInfo* decInfo);
+
+/* Open the output file, named after the decoded extension (not with --verify) */
+Status open_output_file_dec(DecodeInfo* decInfo);
+
 /* Decode secret file data */
 Status decode_secret_file_data(DecodeInfo* decInfo);
 
+/* Decode secret file data through the block pipeline (reader / writer threads, or --uring) */
+Status decode_secret_file_data_pipelined(DecodeInfo* decInfo);
+
+/* Decode secret file data on N threads, each extracting a disjoint range */
+Status decode_secret_file_data_parallel(DecodeInfo* decInfo);
+
+/* Perform the decoding in one forward pass over pipes ("-" arguments) */
+Status do_decoding_stream(DecodeInfo* decInfo);
+
+/* Perform the decoding over memory mapped files (--mmap) */
+Status do_decoding_mmap(DecodeInfo* decInfo);
+
 #endif
\ No newline at end of file
@@ -22,8 +22,21 @@
  *      → Secret file extension size
  *      → Secret file extension (.txt / .c / .sh)
  *      → Secret file size (in bytes)
- *      → Entire secret file data byte by byte
+ *      → Header checksum (CRC32C)
+ *      → Entire secret file data byte by byte, then its CRC32C
  * 6) Writing leftover image data to keep BMP structure intact
+ * 7) Optional memory mapped encoding (--mmap), where the LSB stages
+ *    write straight into the mapped pixel array of the stego image
+ * 8) Optional in-place encoding (--in-place), which patches only the
+ *    encoded region of the source image under a rollback journal
+ * 9) Optional payload compression (--compress), the secret file is
+ *    replaced by its compressed stream before the capacity check
+ * 10) Block pipeline of the payload stage, where reads of the next
+ *    image and secret blocks, the LSB stage and writes of finished blocks
+ *    overlap on reader / writer threads, or through io_uring (--uring)
+ * 11) Optional streaming ("-" arguments), the source image read from
+ *    standard input and / or the stego image written to standard output
+ *    in one forward pass, a window of rows at a time
  *
  * Output :
  * --------
@@ -32,37 +45,47 @@
  *
  */
 
+#define _GNU_SOURCE             // copy_file_range()
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <linux/fs.h>
+#endif
 #include "common.h"
+#include "crc32c.h"
 #include "encode.h"
+#include "journal.h"
+#include "lsb.h"
+#include "lz.h"
+#include "stats.h"
+#include "stego.h"
+#include "stream.h"
 #include "types.h"
 
+static Status encode_mapped(EncodeInfo *encInfo);
+
 /* Function Definitions */
 
 /* Get image size
  * Input: Image file ptr
- * Output: width * height * bytes per pixel (3 in our case)
- * Description: In BMP Image, width is stored in offset 18,
- * and height after that. size is 4 bytes
+ * Output: Carrier bytes of the pixel array (0 if the BMP is not supported)
+ * Description: Width, height and bit depth come from the header
+ * (bmp_read_layout), row padding and skipped alpha bytes do not count
  */
-uint get_image_size_for_bmp(FILE *fptr_image)
+uint64_t get_image_size_for_bmp(FILE *fptr_image)
 {
-    uint width, height;
-    // Seek to 18th byte
-    fseek(fptr_image, 18, SEEK_SET);
-
-    // Read the width (an int)
-    fread(&width, sizeof(int), 1, fptr_image);
-    //printf("width = %u\n", width);
-
-    // Read the height (an int)j
-    fread(&height, sizeof(int), 1, fptr_image);
-    //printf("height = %u\n", height);
+    BmpLayout layout;
 
-    // Return image capacity
-    return width * height * 3;
+    if(bmp_read_layout(fptr_image, 0, &layout) != e_success)
+        return 0;
+    return bmp_carrier_size(&layout);
 }
 
 /* 
@@ -74,9 +97,11 @@ uint get_image_size_for_bmp(FILE *fptr_image)
  */
 Status open_files(EncodeInfo *encInfo)
 {
-    printf("INFO: Opening Required files\n");
-    // Src Image file
-    encInfo->fptr_src_image = fopen(encInfo->src_image_fname, "r");
+    PRINT_INFO("INFO: Opening Required files\n");
+    encInfo -> fptr_src_image = encInfo -> fptr_secret = encInfo -> fptr_stego_image = NULL;
+
+    // Src Image file (patched directly when encoding in place)
+    encInfo->fptr_src_image = fopen(encInfo->src_image_fname, encInfo -> in_place ? "r+" : "r");
     // Do Error handling
     if (encInfo->fptr_src_image == NULL)
     {
@@ -85,7 +110,11 @@ Status open_files(EncodeInfo *encInfo)
 
     	return e_failure;
     }
-    printf("INFO: Opened %s\n", encInfo -> src_image_fname);
+    PRINT_INFO("INFO: Opened %s\n", encInfo -> src_image_fname);
+    if(encInfo -> io_buffer != NULL)
+    {
+        setvbuf(encInfo -> fptr_src_image, encInfo -> io_buffer, _IOFBF, encInfo -> io_buffer_size / 2);
+    }
 
     // Secret file
     encInfo->fptr_secret = fopen(encInfo->secret_fname, "r");
@@ -97,10 +126,18 @@ Status open_files(EncodeInfo *encInfo)
 
     	return e_failure;
     }
-    printf("INFO: Opened %s\n", encInfo -> secret_fname);
+    PRINT_INFO("INFO: Opened %s\n", encInfo -> secret_fname);
 
-    // Stego Image file
-    encInfo->fptr_stego_image = fopen(encInfo->stego_image_fname, "w");
+    // In place : the source image is the stego image
+    if(encInfo -> in_place)
+    {
+        encInfo -> fptr_stego_image = NULL;
+        PRINT_INFO("INFO: DONE\n");
+        return e_success;
+    }
+
+    // Stego Image file (read + write, padded carriers are encoded through a shared mapping)
+    encInfo->fptr_stego_image = fopen(encInfo->stego_image_fname, "w+");
     // Do Error handling
     if (encInfo->fptr_stego_image == NULL)
     {
@@ -109,8 +146,12 @@ Status open_files(EncodeInfo *encInfo)
 
     	return e_failure;
     }
-    printf("INFO: Opened %s\n", encInfo -> stego_image_fname);
-    printf("INFO: DONE\n");
+    PRINT_INFO("INFO: Opened %s\n", encInfo -> stego_image_fname);
+    if(encInfo -> io_buffer != NULL)
+    {
+        setvbuf(encInfo -> fptr_stego_image, encInfo -> io_buffer + encInfo -> io_buffer_size / 2, _IOFBF, encInfo -> io_buffer_size / 2);
+    }
+    PRINT_INFO("INFO: DONE\n");
 
     // No failure return e_success
     return e_success;
@@ -123,17 +164,17 @@ Status open_files(EncodeInfo *encInfo)
  */
 Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
 {
-    printf("INFO: Validating Arguments\n");
+    PRINT_INFO("INFO: Validating Arguments\n");
 
-    // check if source is BMP image
+    // check if source is BMP image ("-" : standard input)
     char* sub = strstr(argv[2], ".bmp");                
-    if((sub != NULL) && strcmp(sub, ".bmp") == 0)
+    if(((sub != NULL) && strcmp(sub, ".bmp") == 0) || stream_is_std(argv[2]))
     { 
         encInfo -> src_image_fname = argv[2];            // store source filename
     }
     else
     {
-        printf("INFO: ## Error: Source file is not a .bmp file\n");
+        fprintf(stderr, "ERROR: Source file %s is not a .bmp file\n", argv[2]);
         return e_failure;
     }
 
@@ -144,33 +185,64 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
         encInfo -> secret_fname = argv[3];            // storing secret filename
         strcpy(encInfo -> extn_secret_file, sub1);    // storing secret file extension
     }
+    else if(stream_is_std(argv[3]) || strncmp(argv[3], "/dev/fd/", 8) == 0)
+    {
+        encInfo -> secret_fname = argv[3];            // standard input or an inherited descriptor, stored as text
+        strcpy(encInfo -> extn_secret_file, ".txt");
+    }
     else
     {
-        printf("INFO: ## Error: Secret file is not a .txt/.c/.sh file\n");
+        fprintf(stderr, "ERROR: Secret file %s is not a .txt/.c/.sh file\n", argv[3]);
+        return e_failure;
+    }
+
+    if(stream_is_std(argv[2]) && stream_is_std(argv[3]))
+    {
+        fprintf(stderr, "ERROR: Source image and secret file can not both be standard input\n");
         return e_failure;
     }
+    encInfo -> stream = stream_is_std(argv[2]) || stream_is_std(argv[3]) || strncmp(argv[3], "/dev/fd/", 8) == 0
+                        || stream_is_std(argv[4]);
+
+    // In place : source image is also the output
+    if(encInfo -> in_place)
+    {
+        if(encInfo -> stream)
+        {
+            fprintf(stderr, "ERROR: --in-place needs named files\n");
+            return e_failure;
+        }
+        if(argv[4] != NULL)
+        {
+            fprintf(stderr, "ERROR: Output file can not be given with --in-place\n");
+            return e_failure;
+        }
+        encInfo -> stego_image_fname = encInfo -> src_image_fname;
+        PRINT_INFO("INFO: Validation Successfull\n");
+        return e_success;
+    }
 
     // Optional: user can give output stego filename
     if(argv[4] != NULL)
     {
        char* sub2 = strstr(argv[4], ".bmp");
-        if((sub2 != NULL) && strcmp(sub2, ".bmp") == 0)
+        if(((sub2 != NULL) && strcmp(sub2, ".bmp") == 0) || stream_is_std(argv[4]))
         {
             encInfo -> stego_image_fname = argv[4]; // Filename given by user
-            printf("INFO: Validation Successfull\n");
+            PRINT_INFO("INFO: Validation Successfull\n");
             return e_success;
         }
         else
         {
-            printf("INFO: ## Error: Output file is not a .bmp file\n");
+            fprintf(stderr, "ERROR: Output file %s is not a .bmp file\n", argv[4]);
             return e_failure;
         }
     }
     else
     {
-        printf("INFO: Output file not mentioned.Creating Stego.bmp as default\n");
+        PRINT_INFO("INFO: Output file not mentioned.Creating Stego.bmp as default\n");
         encInfo -> stego_image_fname = "stego.bmp";   // Default name if user is not given name
-        printf("INFO: Validation Successfull\n");
+        PRINT_INFO("INFO: Validation Successfull\n");
         return e_success;
     }
 }
@@ -182,28 +254,38 @@ Status read_and_validate_encode_args(char *argv[], EncodeInfo *encInfo)
  */
 Status do_encoding(EncodeInfo *encInfo)
 {
-    if(open_files(encInfo) == e_success)            
+    if(STATS_STAGE("open", open_files(encInfo)) == e_success)
     {
-        printf("INFO: ## Encoding Procedure Started ##\n");
-        if(check_capacity(encInfo) == e_success)
+        PRINT_INFO("INFO: ## Encoding Procedure Started ##\n");
+        if(STATS_STAGE("compress", compress_secret_file(encInfo)) == e_success
+           && STATS_STAGE("capacity", check_capacity(encInfo)) == e_success)
         {
-            if(copy_bmp_header(encInfo -> fptr_src_image, encInfo -> fptr_stego_image) == e_success)
+            // Row padding / skipped alpha bytes : the carrier is not one byte stream
+            if(!encInfo -> layout.contiguous)
+            {
+                Status ret = encode_mapped(encInfo);
+                close_files(encInfo);
+                return ret;
+            }
+            if(STATS_STAGE("header_copy", copy_bmp_header(encInfo -> fptr_src_image, encInfo -> fptr_stego_image)) == e_success)
             {
-                if(encode_magic_string(MAGIC_STRING, encInfo) == e_success)
+                if(STATS_STAGE("metadata", encode_magic_string(MAGIC_STRING, encInfo)) == e_success
+                   && STATS_STAGE("metadata", encode_stego_version(encInfo -> flags, encInfo)) == e_success)
                 {
-                    if(encode_secret_file_extn_size(strlen(encInfo -> extn_secret_file), encInfo) == e_success)
+                    if(STATS_STAGE("metadata", encode_secret_file_extn_size(strlen(encInfo -> extn_secret_file), encInfo)) == e_success)
                     {
-                        if(encode_secret_file_extn(encInfo -> extn_secret_file, encInfo) == e_success)
+                        if(STATS_STAGE("metadata", encode_secret_file_extn(encInfo -> extn_secret_file, encInfo)) == e_success)
                         {
-                            if(encode_secret_file_size(encInfo -> secret_file_size, encInfo) == e_success)
+                            if(STATS_STAGE("metadata", encode_secret_file_size(encInfo -> secret_file_size, encInfo)) == e_success
+                               && STATS_STAGE("metadata", encode_header_crc(encInfo)) == e_success)
                             {
-                                if(encode_secret_file_data(encInfo) == e_success)
+                                if(STATS_STAGE("payload", encode_secret_file_data(encInfo)) == e_success)
                                 {
-                                    if(copy_remaining_img_data(encInfo -> fptr_src_image, encInfo -> fptr_stego_image) == e_success)
+                                    if(STATS_STAGE("tail_copy", copy_remaining_img_data(encInfo -> fptr_src_image, encInfo -> fptr_stego_image)) == e_success)
                                     {
-                                        fclose(encInfo->fptr_src_image);
-                                        fclose(encInfo->fptr_secret);
-                                        fclose(encInfo->fptr_stego_image);
+                                        double start = stats_now();
+                                        close_files(encInfo);
+                                        stats_stage_end("close", start);
                                         return e_success;
                                     }
                                 }
@@ -214,9 +296,64 @@ Status do_encoding(EncodeInfo *encInfo)
             }
         }
     }
+    close_files(encInfo);
     return e_failure;
 }
 
+/* Close files
+ * Input  : EncodeInfo structure
+ * Output : Closes every file opened by open_files(), also after a
+ *          failed stage, so repeated jobs do not leak descriptors
+ */
+void close_files(EncodeInfo *encInfo)
+{
+    if(encInfo -> fptr_src_image != NULL)
+        fclose(encInfo -> fptr_src_image);
+    if(encInfo -> fptr_secret != NULL)
+        fclose(encInfo -> fptr_secret);
+    if(encInfo -> fptr_stego_image != NULL)
+        fclose(encInfo -> fptr_stego_image);
+    encInfo -> fptr_src_image = encInfo -> fptr_secret = encInfo -> fptr_stego_image = NULL;
+}
+
+/* Compress secret file
+ * Input  : EncodeInfo with the secret file open
+ * Output : With STEGO_FLAG_COMPRESSED, fptr_secret is swapped for an
+ *          anonymous memory file holding the compressed stream, so every
+ *          later stage (capacity, stdio, mmap, in place) embeds it as is
+ * Return : e_success, or e_failure on a read / write error
+ */
+Status compress_secret_file(EncodeInfo *encInfo)
+{
+    uint64_t size = get_file_size(encInfo -> fptr_secret);
+    uint64_t packed_size;
+
+    if(!(encInfo -> flags & STEGO_FLAG_COMPRESSED) || size == 0)
+        return e_success;
+
+    PRINT_INFO("INFO: Compressing %s\n", encInfo -> secret_fname);
+    int fd = memfd_create("stego-payload", MFD_CLOEXEC);
+    FILE *fptr = fd < 0 ? NULL : fdopen(fd, "w+");
+    if(fptr == NULL)
+    {
+        perror("memfd_create");
+        if(fd >= 0)
+            close(fd);
+        return e_failure;
+    }
+    if(lz_compress_file(encInfo -> fptr_secret, size, fptr, &packed_size) != e_success || fflush(fptr) != 0)
+    {
+        fprintf(stderr, "ERROR: Unable to compress %s\n", encInfo -> secret_fname);
+        fclose(fptr);
+        return e_failure;
+    }
+    rewind(fptr);
+    fclose(encInfo -> fptr_secret);
+    encInfo -> fptr_secret = fptr;
+    PRINT_INFO("INFO: Done. %llu -> %llu bytes\n", (unsigned long long)size, (unsigned long long)packed_size);
+    return e_success;
+}
+
 /* Check image have enough capacity to encode secret file
  * Input  : EncodeInfo structure
  * Output : Calculates image capacity and required size
@@ -224,63 +361,85 @@ Status do_encoding(EncodeInfo *encInfo)
  */
 Status check_capacity(EncodeInfo *encInfo)
 {
-    printf("INFO: Checking for %s size\n", encInfo -> secret_fname);
+    PRINT_INFO("INFO: Checking for %s size\n", encInfo -> secret_fname);
 
     // Get size of secret file
     encInfo -> secret_file_size = get_file_size(encInfo -> fptr_secret);
     if(encInfo -> secret_file_size == 0)
     {
-        printf("INFO: Empty. No data to encode\n");
+        fprintf(stderr, "ERROR: %s is empty, no data to encode\n", encInfo -> secret_fname);
         return e_failure;
     }
-    printf("INFO: Done.Not Empty\n");
+    PRINT_INFO("INFO: Done.Not Empty\n");
 
     // Get BMP capacity
-    printf("INFO: Checking for %s capacity to handle %s\n", encInfo -> src_image_fname, encInfo -> secret_fname);
-    encInfo -> image_capacity = get_image_size_for_bmp(encInfo -> fptr_src_image); 
+    PRINT_INFO("INFO: Checking for %s capacity to handle %s\n", encInfo -> src_image_fname, encInfo -> secret_fname);
+    // Streaming : already parsed off the source image stream
+    if(!encInfo -> stream && bmp_read_layout(encInfo -> fptr_src_image, encInfo -> use_alpha, &encInfo -> layout) != e_success)
+    {
+        fprintf(stderr, "ERROR: %s is not a supported BMP (uncompressed 8, 24 or 32 bpp)\n", encInfo -> src_image_fname);
+        return e_failure;
+    }
+    encInfo -> image_capacity = bmp_carrier_size(&encInfo -> layout);
+    // Recorded so the image decodes without --alpha
+    if(bmp_uses_alpha(&encInfo -> layout))
+        encInfo -> flags |= STEGO_FLAG_ALPHA;
 
-    uint magic_string_len = strlen(MAGIC_STRING);
-    uint Extension_len = strlen(encInfo -> extn_secret_file);
-    
-    // Total bytes needed for encoding
-    uint Encoding_things = 54 + (magic_string_len + sizeof(int) + Extension_len + sizeof(int) + encInfo -> secret_file_size) * 8;
+    // Largest secret the carrier holds after the stego header, computed by
+    // division so multi-GB carriers and secrets cannot overflow
+    uint64_t max_secret_size = stego_capacity_bits(encInfo -> image_capacity, strlen(encInfo -> extn_secret_file),
+                                                   STEGO_BITS(encInfo -> flags));
 
-    if(encInfo -> image_capacity > Encoding_things)
+    if(encInfo -> secret_file_size <= max_secret_size)
     {
-        printf("INFO: Done. Capacity available\n");
+        PRINT_INFO("INFO: Done. Capacity available\n");
         return e_success;
     }
     else
     {
-        printf("INFO: ## Error: Capacity not available\n");
+        fprintf(stderr, "ERROR: Capacity not available, %s does not fit in %s\n", encInfo -> secret_fname, encInfo -> src_image_fname);
         return e_failure;
     }
 }
 
 /* Get file size
  * Input  : File pointer
- * Output : File size in bytes
+ * Output : File size in bytes (64-bit, 0 if it cannot be told)
  */
-uint get_file_size(FILE* fptr)
+uint64_t get_file_size(FILE* fptr)
 {
-    fseek(fptr, 0, SEEK_END);         // Moving file pointer to end
-    uint pos = ftell(fptr);            // Storing the position that is file size
+    fseeko(fptr, 0, SEEK_END);        // Moving file pointer to end
+    off_t pos = ftello(fptr);         // Storing the position that is file size
     rewind(fptr);                     // Resetting to the beginning
-    return pos;
+    return pos > 0 ? (uint64_t)pos : 0;
 }
 
 /* Copy BMP header
  * Input  : Source and destination file pointers
- * Output : Writes first 54 bytes (header) from source to destination
+ * Output : Writes every byte before the pixel array (bfOffBits: file
+ *          header, DIB header of any size, palette) from source to
+ *          destination, both streams end up at the first pixel byte
  */
 Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_dest_image)
 {
-    printf("INFO: Copying Image Header\n");
-   char header[54];
+    PRINT_INFO("INFO: Copying Image Header\n");
+    char header[BMP_HEADER_SIZE];
     rewind(fptr_src_image);                      // moving the fiepointer to the start
-     fread(header, sizeof(char), 54, fptr_src_image); // Read header
-    fwrite(header, sizeof(char), 54, fptr_dest_image); // Write header
-    printf("INFO: Done\n");
+    if(fread(header, sizeof(char), BMP_HEADER_SIZE, fptr_src_image) != BMP_HEADER_SIZE) // Read header
+        return e_failure;
+    fwrite(header, sizeof(char), BMP_HEADER_SIZE, fptr_dest_image); // Write header
+
+    // Larger DIB headers and the palette up to bfOffBits
+    uint offset = (unsigned char)header[10] | (unsigned char)header[11] << 8 | (unsigned char)header[12] << 16 | (uint)(unsigned char)header[13] << 24;
+    for(uint done = BMP_HEADER_SIZE; done < offset; )
+    {
+        uint count = offset - done < BMP_HEADER_SIZE ? offset - done : BMP_HEADER_SIZE;
+        if(fread(header, sizeof(char), count, fptr_src_image) != count)
+            return e_failure;
+        fwrite(header, sizeof(char), count, fptr_dest_image);
+        done += count;
+    }
+    PRINT_INFO("INFO: Done\n");
     return e_success;
 }
 
@@ -290,51 +449,45 @@ Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_dest_image)
  */
 Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo)
 {
-    printf("INFO: Encoding Magic String Signature\n");
-    if(encode_data_to_image(magic_string, strlen(magic_string), encInfo) == e_success)
+    PRINT_INFO("INFO: Encoding Magic String Signature\n");
+    if(encode_data_to_image(magic_string, strlen(magic_string), 1, encInfo) == e_success)
     {
-        printf("INFO: Done\n");
+        PRINT_INFO("INFO: Done\n");
         return e_success;
     }
     return e_failure;
 }
 
 /* Encode data to image
- * Input  : Data, size, and EncodeInfo structure
+ * Input  : Data, size, bits per image byte (1 for the header, --bits
+ *          for the secret data) and EncodeInfo structure
  * Output : Writes encoded data into fptr_stego_image
+ * Description : Image bytes are read in blocks of up to
+ * ENCODE_BLOCK_SIZE payload bytes (8 / bits image bytes each) and
+ * encoded with the LSB kernel, instead of one round trip per byte
  */
-Status encode_data_to_image(const char *data, int size, EncodeInfo* encInfo)
+Status encode_data_to_image(const char *data, int size, uint bits, EncodeInfo* encInfo)
 {
-    char buffer[8];
-    for(int i = 0; i < size; i++)
+    unsigned char buffer[ENCODE_BLOCK_SIZE * 8];
+    for(int i = 0; i < size; i += ENCODE_BLOCK_SIZE)
     {
-        fread(buffer, sizeof(char), 8, encInfo -> fptr_src_image);    // Reading 8 bytes
-        encode_byte_to_lsb(data[i], buffer);                          // Encoding 1 byte of data
-        fwrite(buffer, sizeof(char), 8, encInfo -> fptr_stego_image); // Write modified bytes
+        int count = (size - i) < ENCODE_BLOCK_SIZE ? (size - i) : ENCODE_BLOCK_SIZE;
+        size_t len = lsb_carrier_size(count, bits);
+
+        fread(buffer, sizeof(char), len, encInfo -> fptr_src_image);                  // Reading 8 / bits bytes per data byte
+        lsb_embed_bits(buffer, buffer, (const unsigned char *)data + i, count, bits); // Encoding the whole block
+        fwrite(buffer, sizeof(char), len, encInfo -> fptr_stego_image);               // Write modified bytes
     }
     return e_success;
 }
 
 /* Encodes a single byte into 8 LSBs of a buffer
  * Input  : One byte of data and 8-byte image buffer
- * Output : Modified image buffer with encoded bits
+ * Output : Modified image buffer with encoded bits (MSB first)
  */
 Status encode_byte_to_lsb(char data, char *image_buffer)
 {
-    for(int i = 0; i < 8; i++)
-    {
-       // Extract bit at position (7-i) to encode MSB first
-        uint bit = data & (1 << (7 - i));
-
-        // Clear LSB of current image byte using mask 11111110
-        image_buffer[i] = image_buffer[i] & (~1);
-
-        // If extracted bit is set, set the LSB to 1
-        if(bit)
-        {
-            image_buffer[i] = image_buffer[i] | 1;
-        }
-    }
+    lsb_embed((unsigned char *)image_buffer, (unsigned char *)image_buffer, (unsigned char *)&data, 1);
     return e_success;
 }
 
@@ -342,23 +495,50 @@ Status encode_byte_to_lsb(char data, char *image_buffer)
 /* Encode 32-bit integer into 32 bytes LSBs
  * Input  : Integer data and 32 -byte image buffer
  * Output : Modified buffer with encoded integer
+ * Description : MSB first, so the integer is encoded as its 4 bytes
+ * in big endian order
  */
 Status encode_int_to_lsb(int data, char* image_buffer)
 {
-    for(int i = 0; i < 32; i++)
-    {
-        int bit = data & (1 << (31 - i));    // Get MSB first
+    unsigned char bytes[4] = { (uint)data >> 24, (uint)data >> 16, (uint)data >> 8, (uint)data };
 
-        image_buffer[i] = image_buffer[i] & (~1);   // Clear LSB
+    lsb_embed((unsigned char *)image_buffer, (unsigned char *)image_buffer, bytes, 4);
+    return e_success;
+}
 
-        if(bit)
-        {
-            image_buffer[i] = image_buffer[i] | 1;  // Set LSB if bit = 1
-        }
-    }
+
+/* Encode 64-bit size into 64 bytes LSBs
+ * Input  : Size and 64-byte image buffer
+ * Output : Modified buffer with the size encoded MSB first
+ */
+Status encode_size_to_lsb(uint64_t data, char *image_buffer)
+{
+    unsigned char bytes[8];
+
+    for(int i = 0; i < 8; i++)
+        bytes[i] = data >> (56 - 8 * i);
+    lsb_embed((unsigned char *)image_buffer, (unsigned char *)image_buffer, bytes, 8);
     return e_success;
 }
 
+/* Encode header version
+ * Input  : Flag bits and EncodeInfo structure
+ * Output : Marker word (STEGO_MARKER | STEGO_VERSION) and flags encoded
+ *          into the 64 image bytes after the magic string
+ */
+Status encode_stego_version(uint flags, EncodeInfo *encInfo)
+{
+    PRINT_INFO("INFO: Encoding Stego Header Version %d\n", STEGO_VERSION);
+    char buffer[64];
+
+    fread(buffer, sizeof(char), 64, encInfo -> fptr_src_image);
+    encode_int_to_lsb(STEGO_MARKER | STEGO_VERSION, buffer);
+    encode_int_to_lsb(flags, buffer + 32);
+    fwrite(buffer, sizeof(char), 64, encInfo -> fptr_stego_image);
+
+    PRINT_INFO("INFO: Done\n");
+    return e_success;
+}
 
 /* Encode secret file extension size (integer)
  * Input  : Size of file extension and EncodeInfo structure
@@ -366,14 +546,14 @@ Status encode_int_to_lsb(int data, char* image_buffer)
  */
 Status encode_secret_file_extn_size(int size, EncodeInfo *encInfo) 
 {
-    printf("INFO: Encoding %s File Extension Size\n", encInfo -> secret_fname);
+    PRINT_INFO("INFO: Encoding %s File Extension Size\n", encInfo -> secret_fname);
     char buffer[32];        
 
     fread(buffer, sizeof(char), 32, encInfo -> fptr_src_image);      // Reading 32 Bytes from source image
     encode_int_to_lsb(size, buffer);                                 // Encoding extension size into LSBs
     fwrite(buffer, sizeof(char), 32, encInfo -> fptr_stego_image);   // Write encoded bytes to stego image
     
-    printf("INFO: Done\n");
+    PRINT_INFO("INFO: Done\n");
     return e_success;
 }
 
@@ -385,11 +565,11 @@ Status encode_secret_file_extn_size(int size, EncodeInfo *encInfo)
 
 Status encode_secret_file_extn(const char *file_extn, EncodeInfo *encInfo)
 {
-    printf("INFO: Encoding %s File extension\n", encInfo -> secret_fname);
+    PRINT_INFO("INFO: Encoding %s File extension\n", encInfo -> secret_fname);
     // Encoding files extension (.txt, .c, .sh)
-    if(encode_data_to_image(file_extn, strlen(file_extn), encInfo) == e_success)
+    if(encode_data_to_image(file_extn, strlen(file_extn), 1, encInfo) == e_success)
     {
-        printf("INFO: Done\n");
+        PRINT_INFO("INFO: Done\n");
         return e_success;
     }
     return e_failure;
@@ -397,54 +577,942 @@ Status encode_secret_file_extn(const char *file_extn, EncodeInfo *encInfo)
 
 /* Encode secret file size (in bytes)
  * Input  : Size of secret file
- * Output : Write file size into 32 pixels
+ * Output : Write file size (64-bit) into 64 pixels
  */
-Status encode_secret_file_size(long file_size, EncodeInfo *encInfo)
+Status encode_secret_file_size(uint64_t file_size, EncodeInfo *encInfo)
 {
-    printf("INFO: Encoding %s File Size\n", encInfo -> secret_fname);
-    char buffer[32];        
+    PRINT_INFO("INFO: Encoding %s File Size\n", encInfo -> secret_fname);
+    char buffer[64];        
 
-    fread(buffer, sizeof(char), 32, encInfo -> fptr_src_image);    // Read 32 bytes from image
-    encode_int_to_lsb(file_size, buffer);                          // Encoding file size into LSBs
-    fwrite(buffer, sizeof(char), 32, encInfo -> fptr_stego_image); // writing modified bytes to stego image
+    fread(buffer, sizeof(char), 64, encInfo -> fptr_src_image);    // Read 64 bytes from image
+    encode_size_to_lsb(file_size, buffer);                         // Encoding file size into LSBs
+    fwrite(buffer, sizeof(char), 64, encInfo -> fptr_stego_image); // writing modified bytes to stego image
    
-    printf("INFO: Done\n");
+    PRINT_INFO("INFO: Done\n");
+    return e_success;
+}
+
+/* Encode header checksum
+ * Input  : EncodeInfo structure
+ * Output : Writes the CRC32C of the header fields encoded so far into
+ *          32 pixels (the last 4 bytes of build_stego_header())
+ */
+Status encode_header_crc(EncodeInfo *encInfo)
+{
+    PRINT_INFO("INFO: Encoding Stego Header Checksum\n");
+    unsigned char header[STEGO_HEADER_MAX];
+    uint header_size = build_stego_header(encInfo, header);
+
+    encode_data_to_image((char *)header + header_size - STEGO_CRC_SIZE, STEGO_CRC_SIZE, 1, encInfo);
+    PRINT_INFO("INFO: Done\n");
+    return e_success;
+}
+
+/* Payload checksum bytes
+ * Input  : CRC32C and a STEGO_CRC_SIZE byte buffer
+ * Output : CRC stored MSB first, as encoded after the secret data
+ */
+static void encode_crc_bytes(uint32_t crc, unsigned char *bytes)
+{
+    bytes[0] = crc >> 24;
+    bytes[1] = crc >> 16;
+    bytes[2] = crc >> 8;
+    bytes[3] = crc;
+}
+
+/* Encode secret file data in lockstep
+ * Input  : EncodeInfo structure
+ * Output : Writes encoded bytes to stego image, followed by the CRC32C
+ *          of the secret data
+ * Description : The secret file is streamed in blocks of
+ * ENCODE_BLOCK_SIZE bytes, each block is embedded into the matching
+ * image block and written before the next one is read, so memory use
+ * stays the same whatever the secret file or image size. The CRC is
+ * taken over each block while it is still in cache
+ */
+static Status encode_secret_file_data_lockstep(EncodeInfo *encInfo)
+{
+    PRINT_INFO("INFO: Encoding %s File Data\n", encInfo -> secret_fname);
+    char secret_file_data[ENCODE_BLOCK_SIZE];
+    uint64_t remaining = encInfo -> secret_file_size;
+    uint bits = STEGO_BITS(encInfo -> flags);
+    unsigned char trailer[STEGO_CRC_SIZE];
+    uint32_t crc = 0;
+
+    stats_block_size(ENCODE_BLOCK_SIZE);
+    while(remaining > 0)
+    {
+        uint count = remaining < ENCODE_BLOCK_SIZE ? remaining : ENCODE_BLOCK_SIZE;
+
+        // Reads next block of secret file
+        if(fread(secret_file_data, sizeof(char), count, encInfo -> fptr_secret) != count)
+        {
+            fprintf(stderr, "ERROR: Unable to read %s\n", encInfo -> secret_fname);
+            return e_failure;
+        }
+
+        // Encode data bytes into image pixels
+        if(encode_data_to_image(secret_file_data, count, bits, encInfo) != e_success)
+        {
+            return e_failure; //If encoding failed returns failure
+        }
+        crc = crc32c_update(crc, secret_file_data, count);
+        remaining -= count;
+    }
+    encode_crc_bytes(crc, trailer);
+    encode_data_to_image((char *)trailer, STEGO_CRC_SIZE, bits, encInfo);
+    PRINT_INFO("INFO: Done\n");
+    return e_success;
+}
+
+/* State of the pipelined payload pass : the data stream is the secret
+ * data followed by its CRC32C, cut into block_size blocks */
+typedef struct _EncodePipe
+{
+    int fd_src, fd_secret, fd_stego;
+    off_t src_off, stego_off;     // First carrier byte of the secret data in both images
+    off_t secret_off;             // First secret byte
+    uint64_t size;                // Secret bytes
+    uint64_t total;               // Stream bytes (secret and trailer)
+    uint bits;
+    uint block_size;              // Stream bytes per block
+    uint32_t crc;
+    unsigned char trailer[STEGO_CRC_SIZE];
+    unsigned char *data;          // Secret bytes of the block in each slot, PIPE_SLOTS * block_size
+} EncodePipe;
+
+/* Reads of one block
+ * Input  : EncodePipe, block, slot and its carrier buffer
+ * Output : The source carrier bytes of the block (slot buffer) and the
+ *          secret bytes in it (none for a trailer only block)
+ */
+static uint encode_pipe_reads(void *ctx, uint64_t block, uint slot, unsigned char *buffer, PipeIo *io)
+{
+    EncodePipe *job = ctx;
+    uint64_t start = block * job -> block_size;
+    uint count = job -> total - start < job -> block_size ? job -> total - start : job -> block_size;
+    uint n = 0;
+
+    io[n++] = (PipeIo) { job -> fd_src, buffer, lsb_carrier_size(count, job -> bits),
+                        job -> src_off + lsb_carrier_size(start, job -> bits), 1 };
+    if(start < job -> size)
+    {
+        uint secret = job -> size - start < count ? job -> size - start : count;
+        io[n++] = (PipeIo) { job -> fd_secret, job -> data + slot * job -> block_size, secret, job -> secret_off + start, 0 };
+    }
+    return n;
+}
+
+/* Transform one block
+ * Input  : EncodePipe, block (in order), slot and its carrier buffer
+ * Output : Secret bytes embedded into the carrier bytes, the CRC taken
+ *          on the way; the trailer once the last secret byte is in.
+ *          The buffer is then written to the stego image
+ */
+static Status encode_pipe_transform(void *ctx, uint64_t block, uint slot, unsigned char *buffer, PipeIo *io, uint *writes)
+{
+    EncodePipe *job = ctx;
+    uint64_t start = block * job -> block_size;
+    uint count = job -> total - start < job -> block_size ? job -> total - start : job -> block_size;
+    uint secret = start >= job -> size ? 0 : job -> size - start < count ? job -> size - start : count;
+
+    job -> crc = lsb_embed_bits_crc(buffer, buffer, job -> data + slot * job -> block_size, secret, job -> bits, job -> crc);
+    if(secret < count)
+    {
+        encode_crc_bytes(job -> crc, job -> trailer);
+        lsb_embed_bits(buffer + lsb_carrier_size(secret, job -> bits), buffer + lsb_carrier_size(secret, job -> bits),
+                       job -> trailer + (start + secret - job -> size), count - secret, job -> bits);
+    }
+    io[0] = (PipeIo) { job -> fd_stego, buffer, lsb_carrier_size(count, job -> bits),
+                        job -> stego_off + lsb_carrier_size(start, job -> bits), 1 };
+    *writes = 1;
+    return e_success;
+}
+
+/* Encode secret file data through the block pipeline
+ * Input  : EncodeInfo, every stream just past the header
+ * Output : Same bytes as encode_secret_file_data_lockstep(), with up to
+ *          PIPE_SLOTS blocks in flight : the image and secret reads of
+ *          upcoming blocks and the writes of embedded ones overlap the
+ *          LSB stage, on reader / writer threads or through the ring
+ *          (--uring). The streams are left just past the trailer
+ */
+static Status encode_secret_file_data_pipelined(EncodeInfo *encInfo)
+{
+    PRINT_INFO("INFO: Encoding %s File Data (%s)\n", encInfo -> secret_fname, encInfo -> ring != NULL ? "io_uring" : "pipeline");
+    EncodePipe job = { 0 };
+    PipeJob pass = { 0 };
+
+    fflush(encInfo -> fptr_stego_image);
+    job.fd_src = fileno(encInfo -> fptr_src_image);
+    job.fd_secret = fileno(encInfo -> fptr_secret);
+    job.fd_stego = fileno(encInfo -> fptr_stego_image);
+    job.src_off = ftello(encInfo -> fptr_src_image);        // logical positions, stdio may have read ahead
+    job.stego_off = ftello(encInfo -> fptr_stego_image);
+    job.secret_off = ftello(encInfo -> fptr_secret);
+    job.size = encInfo -> secret_file_size;
+    job.total = job.size + STEGO_CRC_SIZE;
+    job.bits = STEGO_BITS(encInfo -> flags);
+    job.block_size = encInfo -> block_size != 0 ? encInfo -> block_size : PIPE_BLOCK_SIZE;
+    job.data = malloc((size_t)PIPE_SLOTS * job.block_size);
+    if(job.src_off < 0 || job.stego_off < 0 || job.secret_off < 0 || job.data == NULL)
+    {
+        free(job.data);
+        return e_failure;
+    }
+
+    pass.blocks = (job.total + job.block_size - 1) / job.block_size;
+    pass.block_size = job.block_size;
+    pass.ctx = &job;
+    pass.reads = encode_pipe_reads;
+    pass.transform = encode_pipe_transform;
+    stats_block_size(job.block_size);
+    Status ret = encInfo -> ring != NULL ? uring_run(encInfo -> ring, &pass) : pipe_run(&pass);
+    free(job.data);
+    if(ret != e_success)
+    {
+        fprintf(stderr, "ERROR: Unable to encode %s into %s\n", encInfo -> secret_fname, encInfo -> stego_image_fname);
+        return e_failure;
+    }
+
+    // Keep the streams consistent with the bytes moved behind their back
+    uint64_t len = lsb_carrier_size(job.total, job.bits);
+    fseeko(encInfo -> fptr_src_image, job.src_off + len, SEEK_SET);
+    fseeko(encInfo -> fptr_stego_image, job.stego_off + len, SEEK_SET);
+    fseeko(encInfo -> fptr_secret, job.secret_off + job.size, SEEK_SET);
+    PRINT_INFO("INFO: Done\n");
     return e_success;
 }
 
 /* Encode secret file data (raw contents)
  * Input  : EncodeInfo structure
- * Output : Writes encoded bytes to stego image
+ * Output : Writes encoded bytes to stego image, followed by the CRC32C
+ *          of the secret data
+ * Description : Payloads of two blocks or more (and every payload with
+ * --uring) go through the block pipeline, so reading, embedding and
+ * writing overlap; smaller ones are not worth the thread start up and
+ * stay in lockstep. Both write the same bytes
  */
 Status encode_secret_file_data(EncodeInfo *encInfo)
 {
-    printf("INFO: Encoding %s File Data\n", encInfo -> secret_fname);
-    char secret_file_data[encInfo -> secret_file_size];
+    uint block_size = encInfo -> block_size != 0 ? encInfo -> block_size : PIPE_BLOCK_SIZE;
 
-    // Reads entire secret file
-    fread(secret_file_data, sizeof(char), encInfo -> secret_file_size, encInfo -> fptr_secret);
+    if(encInfo -> ring != NULL || encInfo -> secret_file_size + STEGO_CRC_SIZE >= 2 * (uint64_t)block_size)
+        return encode_secret_file_data_pipelined(encInfo);
+    return encode_secret_file_data_lockstep(encInfo);
+}
 
-    // Encode data bytes into image pixels
-    if(encode_data_to_image(secret_file_data, encInfo -> secret_file_size, encInfo) == e_success)
+/* Copy file range inside the kernel
+ * Input  : Source fd and offset, destination fd and offset, length
+ * Output : Copies len bytes, trying in order
+ *          → FICLONERANGE  : share (reflink) the blocks, when both
+ *                            offsets are equal and the filesystem can
+ *          → copy_file_range / sendfile : in-kernel copy
+ *          → pread / pwrite with a large buffer
+ * Return : e_success or e_failure
+ */
+Status copy_fd_range(int fd_src, off_t src_off, int fd_dest, off_t dest_off, off_t len)
+{
+#ifdef __linux__
+    struct stat st;
+    if(src_off == dest_off && fstat(fd_src, &st) == 0 && st.st_blksize > 0 && src_off + len == st.st_size)
     {
-        printf("INFO: Done\n");
-        return e_success;
+        // Bytes up to the next block boundary are copied, the rest is cloned
+        off_t head = (st.st_blksize - src_off % st.st_blksize) % st.st_blksize;
+        if(head < len && copy_fd_range(fd_src, src_off, fd_dest, dest_off, head) == e_success)
+        {
+            struct file_clone_range clone = { fd_src, src_off + head, 0, dest_off + head };  // length 0 : up to EOF
+            if(ioctl(fd_dest, FICLONERANGE, &clone) == 0)
+            {
+                return e_success;
+            }
+        }
+    }
+
+    while(len > 0)
+    {
+        ssize_t copied = copy_file_range(fd_src, &src_off, fd_dest, &dest_off, len, 0);
+        if(copied <= 0)
+            break;
+        len -= copied;
+    }
+
+    if(len > 0 && lseek(fd_dest, dest_off, SEEK_SET) == dest_off)
+    {
+        while(len > 0)
+        {
+            ssize_t copied = sendfile(fd_dest, fd_src, &src_off, len);
+            if(copied <= 0)
+                break;
+            dest_off += copied;
+            len -= copied;
+        }
+    }
+#endif
+
+    char *buffer = len > 0 ? malloc(COPY_BUFFER_SIZE) : NULL;
+    if(len > 0 && buffer == NULL)
+    {
+        return e_failure;
+    }
+    while(len > 0)
+    {
+        ssize_t count = pread(fd_src, buffer, len < COPY_BUFFER_SIZE ? len : COPY_BUFFER_SIZE, src_off);
+        if(count <= 0 || pwrite(fd_dest, buffer, count, dest_off) != count)
+        {
+            perror("copy");
+            free(buffer);
+            return e_failure;
+        }
+        src_off += count;
+        dest_off += count;
+        len -= count;
     }
-    return e_failure; //If encoding failed returns failure
+    free(buffer);
+    return e_success;
 }
 
 /* Copy remaining image data
  * Input  : Source and destination file pointers
  * Output : Copies unmodified remaining bytes of image
+ * Description : Everything after the encoded bytes is copied by the
+ * kernel (reflinked where the filesystem supports it), so the cost no
+ * longer grows with the part of the image that was not touched
  */
 Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest)
 {
-    printf("INFO: Copying Left Over Data\n");
-    int ch;
-    while((ch = fgetc(fptr_src)) != EOF)  // Reading each byte until EOF
+    PRINT_INFO("INFO: Copying Left Over Data\n");
+    struct stat st;
+    off_t src_off = ftello(fptr_src);       // logical position, stdio may have read ahead
+    fflush(fptr_dest);
+    off_t dest_off = ftello(fptr_dest);
+
+    if(src_off < 0 || dest_off < 0 || fstat(fileno(fptr_src), &st) != 0)
     {
-        fputc(ch, fptr_dest);             // Writing to destination image
+        perror("ftell");
+        return e_failure;
     }
-    printf("INFO: Done\n");
+    if(st.st_size > src_off)
+    {
+        if(copy_fd_range(fileno(fptr_src), src_off, fileno(fptr_dest), dest_off, st.st_size - src_off) != e_success)
+        {
+            return e_failure;
+        }
+    }
+
+    // Keep both streams consistent with the bytes copied behind their back
+    fseeko(fptr_src, 0, SEEK_END);
+    fseeko(fptr_dest, dest_off + (st.st_size - src_off), SEEK_SET);
+    PRINT_INFO("INFO: Done\n");
     return e_success;
 }
+
+/* Encode data from mapped source pixels into mapped stego pixels
+ * Input  : Data, size, source pixels and destination pixels
+ * Output : Writes 8 * size encoded bytes into dest, reading the
+ *          original pixel bytes from src (no intermediate buffer)
+ */
+Status encode_data_to_mapped(const char *data, uint size, const char *src, char *dest)
+{
+    lsb_embed((const unsigned char *)src, (unsigned char *)dest, (const unsigned char *)data, size);
+    return e_success;
+}
+
+/* Encode 32-bit integer from mapped source pixels into mapped stego pixels
+ * Input  : Integer data, 32 source bytes and 32 destination bytes
+ * Output : Integer encoded MSB first, same layout as encode_int_to_lsb()
+ */
+Status encode_int_to_mapped(uint data, const char *src, char *dest)
+{
+    unsigned char bytes[4] = { data >> 24, data >> 16, data >> 8, data };
+
+    lsb_embed((const unsigned char *)src, (unsigned char *)dest, bytes, 4);
+    return e_success;
+}
+
+/* One thread's share of the mapped payload encoding */
+typedef struct _EncodeSlice
+{
+    const char *src;          // Source image map
+    char *dest;               // Stego image map
+    const char *data;         // Secret data of this slice
+    uint64_t data_size;       // Secret bytes of this slice
+    uint64_t data_offset;     // Image offset encoding this slice
+    uint bits;                // Secret bits per image byte
+    uint64_t tail_offset;     // Image offset of this slice's left over data
+    uint64_t tail_size;       // Left over bytes copied by this slice
+    uint32_t crc;             // CRC32C of this slice's secret data
+} EncodeSlice;
+
+/* Encode slice (thread entry)
+ * Input  : EncodeSlice
+ * Output : Slice of secret data encoded and checksummed, slice of left
+ *          over data copied
+ */
+static void *encode_slice_worker(void *arg)
+{
+    EncodeSlice *slice = arg;
+
+    slice -> crc = lsb_embed_bits_crc((const unsigned char *)slice -> src + slice -> data_offset,
+                                      (unsigned char *)slice -> dest + slice -> data_offset,
+                                      (const unsigned char *)slice -> data, slice -> data_size, slice -> bits, 0);
+    memcpy(slice -> dest + slice -> tail_offset, slice -> src + slice -> tail_offset, slice -> tail_size);
+    return NULL;
+}
+
+/* Encode payload over mapped images
+ * Input  : Source and stego maps, image size, image offset of the secret
+ *          data, secret data, its size, bits per image byte and thread
+ *          count
+ * Output : Secret data encoded from offset on and the left over data
+ *          copied. Secret byte i always lands on image bytes
+ *          offset + 8 / bits * i, so the data and the left over bytes are
+ *          cut into disjoint slices and each thread handles one of each;
+ *          the result is byte-identical to the single threaded path.
+ *          The slice CRCs are combined in order into *crc (if not NULL)
+ */
+Status encode_payload_mapped(const char *src, char *dest, uint64_t image_size, uint64_t offset, const char *data, uint64_t size,
+                             uint bits, uint threads, uint32_t *crc)
+{
+    uint64_t tail_offset = offset + lsb_carrier_size(size, bits);
+    uint64_t tail_size = image_size - tail_offset;
+
+    if(threads > MAX_WORKERS)
+        threads = MAX_WORKERS;
+    if(threads <= 1)
+    {
+        EncodeSlice slice = { src, dest, data, size, offset, bits, tail_offset, tail_size, 0 };
+        encode_slice_worker(&slice);
+        if(crc != NULL)
+            *crc = slice.crc;
+        return e_success;
+    }
+
+    EncodeSlice slices[MAX_WORKERS];
+    pthread_t tids[MAX_WORKERS];
+    uint64_t data_step = (size / threads + 63) & ~(uint64_t)63;          // whole cache lines of output
+    uint64_t tail_step = (tail_size / threads + 4095) & ~(uint64_t)4095; // whole pages
+    Status ret = e_success;
+
+    for(uint t = 0; t < threads; t++)
+    {
+        uint64_t data_start = t * data_step < size ? t * data_step : size;
+        uint64_t data_end = data_start + data_step < size ? data_start + data_step : size;
+        uint64_t tail_start = t * tail_step < tail_size ? t * tail_step : tail_size;
+        uint64_t tail_end = tail_start + tail_step < tail_size ? tail_start + tail_step : tail_size;
+
+        if(t == threads - 1)
+        {
+            data_end = size;
+            tail_end = tail_size;
+        }
+        slices[t] = (EncodeSlice) { src, dest, data + data_start, data_end - data_start,
+                                    offset + lsb_carrier_size(data_start, bits), bits,
+                                    tail_offset + tail_start, tail_end - tail_start, 0 };
+        if(pthread_create(&tids[t], NULL, encode_slice_worker, &slices[t]) != 0)
+        {
+            encode_slice_worker(&slices[t]);    // no thread, do it here
+            tids[t] = pthread_self();
+        }
+    }
+    for(uint t = 0; t < threads; t++)
+    {
+        if(!pthread_equal(tids[t], pthread_self()) && pthread_join(tids[t], NULL) != 0)
+            ret = e_failure;
+    }
+    if(crc != NULL)
+    {
+        *crc = slices[0].crc;
+        for(uint t = 1; t < threads; t++)
+            *crc = crc32c_combine(*crc, slices[t].crc, slices[t].data_size);
+    }
+    return ret;
+}
+
+/* Do encoding over memory mapped files
+ * Input  : EncodeInfo structure
+ * Output : Creates stego image identical to do_encoding(), but the
+ *          source image and secret file are mapped read-only and the
+ *          preallocated stego image is mapped shared, so every stage
+ *          reads and writes pixel memory directly instead of going
+ *          through fread/fwrite round trips
+ */
+Status do_encoding_mmap(EncodeInfo *encInfo)
+{
+    if(STATS_STAGE("open", open_files(encInfo)) != e_success)
+    {
+        close_files(encInfo);
+        return e_failure;
+    }
+    PRINT_INFO("INFO: ## Encoding Procedure Started (mmap) ##\n");
+    if(STATS_STAGE("compress", compress_secret_file(encInfo)) != e_success
+       || STATS_STAGE("capacity", check_capacity(encInfo)) != e_success)
+    {
+        close_files(encInfo);
+        return e_failure;
+    }
+
+    Status ret = encode_mapped(encInfo);
+    close_files(encInfo);
+    return ret;
+}
+
+/* Encode mapped
+ * Input  : EncodeInfo with open files and a checked capacity
+ * Output : Stego image written through the maps. A contiguous carrier
+ *          is encoded field by field straight from source to stego
+ *          pixels and the secret data is split over -j N threads;
+ *          otherwise the image is copied first and the stego header and
+ *          secret data are embedded through the layout's gather / scatter
+ */
+static Status encode_mapped(EncodeInfo *encInfo)
+{
+    const BmpLayout *layout = &encInfo -> layout;
+    uint64_t image_size = get_file_size(encInfo -> fptr_src_image);
+    unsigned char header[STEGO_HEADER_MAX];
+    uint header_size = build_stego_header(encInfo, header);
+    unsigned char trailer[STEGO_CRC_SIZE];
+    uint bits = STEGO_BITS(encInfo -> flags);
+    uint32_t crc = 0;
+    Status ret = e_failure;
+
+    // Map source image, secret file and the preallocated stego image
+    double start = stats_now();
+    char *src = mmap(NULL, image_size, PROT_READ, MAP_PRIVATE, fileno(encInfo -> fptr_src_image), 0);
+    char *secret = mmap(NULL, encInfo -> secret_file_size, PROT_READ, MAP_PRIVATE, fileno(encInfo -> fptr_secret), 0);
+    char *dest = MAP_FAILED;
+    if(ftruncate(fileno(encInfo -> fptr_stego_image), image_size) == 0)
+    {
+        dest = mmap(NULL, image_size, PROT_READ | PROT_WRITE, MAP_SHARED, fileno(encInfo -> fptr_stego_image), 0);
+    }
+    if(src == MAP_FAILED || secret == MAP_FAILED || dest == MAP_FAILED)
+    {
+        perror("mmap");
+        fprintf(stderr, "ERROR: Unable to map %s\n", encInfo -> stego_image_fname);
+    }
+    else if(layout -> contiguous)
+    {
+        madvise(src, image_size, MADV_SEQUENTIAL);
+        madvise(secret, encInfo -> secret_file_size, MADV_SEQUENTIAL);
+        stats_stage_end("map", start);
+
+        start = stats_now();
+        PRINT_INFO("INFO: Copying Image Header\n");
+        memcpy(dest, src, layout -> offset);
+        uint64_t offset = layout -> offset;
+        stats_stage_end("header_copy", start);
+
+        // Magic string, marker, flags, extension size, extension, file size and header crc
+        start = stats_now();
+        PRINT_INFO("INFO: Encoding Stego Header\n");
+        encode_data_to_mapped((char *)header, header_size, src + offset, dest + offset);
+        offset += (uint64_t)header_size * 8;
+        stats_stage_end("metadata", start);
+
+        start = stats_now();
+        PRINT_INFO("INFO: Encoding %s File Data and Copying Left Over Data (%u threads)\n", encInfo -> secret_fname, encInfo -> threads > 1 ? encInfo -> threads : 1);
+        ret = encode_payload_mapped(src, dest, image_size, offset, secret, encInfo -> secret_file_size,
+                                    bits, encInfo -> threads, &crc);
+
+        // Payload crc goes over the left over bytes copied after it
+        offset += lsb_carrier_size(encInfo -> secret_file_size, bits);
+        encode_crc_bytes(crc, trailer);
+        lsb_embed_bits((unsigned char *)src + offset, (unsigned char *)dest + offset, trailer, STEGO_CRC_SIZE, bits);
+        stats_stage_end("payload", start);
+        PRINT_INFO("INFO: Done\n");
+    }
+    else
+    {
+        stats_stage_end("map", start);
+
+        // Padding and skipped alpha bytes must come through unchanged
+        start = stats_now();
+        PRINT_INFO("INFO: Copying Image (%u bpp, %u bytes per row)\n", layout -> bpp, (uint)layout -> stride);
+        ret = encode_payload_mapped(src, dest, image_size, 0, "", 0, 1, encInfo -> threads, NULL);
+        stats_stage_end("image_copy", start);
+
+        start = stats_now();
+        unsigned char *pixels = (unsigned char *)dest + layout -> offset;
+
+        PRINT_INFO("INFO: Encoding Stego Header\n");
+        bmp_embed(layout, (unsigned char *)src + layout -> offset, pixels, 0, header, header_size, 1, NULL);
+        stats_stage_end("metadata", start);
+
+        start = stats_now();
+        PRINT_INFO("INFO: Encoding %s File Data\n", encInfo -> secret_fname);
+        uint64_t pos = (uint64_t)header_size * 8;
+        bmp_embed(layout, (unsigned char *)src + layout -> offset, pixels, pos,
+                  (unsigned char *)secret, encInfo -> secret_file_size, bits, &crc);
+        pos += lsb_carrier_size(encInfo -> secret_file_size, bits);
+        encode_crc_bytes(crc, trailer);
+        bmp_embed(layout, (unsigned char *)src + layout -> offset, pixels, pos, trailer, STEGO_CRC_SIZE, bits, NULL);
+        stats_stage_end("payload", start);
+        PRINT_INFO("INFO: Done\n");
+    }
+
+    start = stats_now();
+    if(src != MAP_FAILED)
+        munmap(src, image_size);
+    if(secret != MAP_FAILED)
+        munmap(secret, encInfo -> secret_file_size);
+    if(dest != MAP_FAILED)
+        munmap(dest, image_size);
+    stats_stage_end("unmap", start);
+    return ret;
+}
+
+/* Build stego header
+ * Input  : EncodeInfo structure and buffer of STEGO_HEADER_MAX bytes
+ * Output : Magic string, marker, flags, extension size (32-bit, MSB
+ *          first), extension, secret file size (64-bit, MSB first) and
+ *          header crc, i.e. the bytes the stages before
+ *          encode_secret_file_data() encode one by one
+ * Return : Number of header bytes
+ */
+uint build_stego_header(EncodeInfo *encInfo, unsigned char *header)
+{
+    return stego_build_header(encInfo -> extn_secret_file, encInfo -> secret_file_size, encInfo -> flags, header);
+}
+
+/* Encode a block in place
+ * Input  : Image fd, its shared map (NULL for a contiguous carrier),
+ *          layout, carrier position, data, its size and bits per byte
+ * Output : Contiguous carrier : reads the 8 / bits * size image bytes at
+ *          the position, encodes data into them and writes them back at
+ *          the same offset. Otherwise the rows are patched through the map
+ */
+static Status encode_block_in_place(int fd, unsigned char *map, const BmpLayout *layout, uint64_t pos, const unsigned char *data,
+                                    uint size, uint bits)
+{
+    unsigned char buffer[ENCODE_BLOCK_SIZE * 8];
+    off_t offset = layout -> offset + pos;
+    ssize_t len = lsb_carrier_size(size, bits);
+
+    if(map != NULL)
+    {
+        bmp_embed(layout, map + layout -> offset, map + layout -> offset, pos, data, size, bits, NULL);
+        return e_success;
+    }
+    if(pread(fd, buffer, len, offset) != len)
+    {
+        return e_failure;
+    }
+    lsb_embed_bits(buffer, buffer, data, size, bits);
+    if(pwrite(fd, buffer, len, offset) != len)
+    {
+        return e_failure;
+    }
+    return e_success;
+}
+
+/* Do encoding in place
+ * Input  : EncodeInfo structure
+ * Output : Source image patched into a stego image. The header copy and
+ *          the left over data copy are skipped, only the carrier bytes
+ *          of the header, secret data and its crc after the BMP header
+ *          (whole rows of a padded carrier) are rewritten. Their original
+ *          contents are journaled first; a failed run is rolled back
+ *          at once, an interrupted one by the next in-place run
+ */
+Status do_encoding_in_place(EncodeInfo *encInfo)
+{
+    if(STATS_STAGE("open", open_files(encInfo)) != e_success)
+    {
+        close_files(encInfo);
+        return e_failure;
+    }
+    PRINT_INFO("INFO: ## Encoding Procedure Started (in place) ##\n");
+
+    int fd = fileno(encInfo -> fptr_src_image);
+    Status ret = e_failure;
+    unsigned char header[STEGO_HEADER_MAX];
+    unsigned char trailer[STEGO_CRC_SIZE];
+    char secret_file_data[ENCODE_BLOCK_SIZE];
+    uint32_t crc = 0;
+
+    if(STATS_STAGE("journal_recover", journal_recover(encInfo -> src_image_fname, fd)) == e_success
+       && STATS_STAGE("compress", compress_secret_file(encInfo)) == e_success
+       && STATS_STAGE("capacity", check_capacity(encInfo)) == e_success)
+    {
+        uint header_size = build_stego_header(encInfo, header);
+        const BmpLayout *layout = &encInfo -> layout;
+        uint64_t pos = 0;
+        off_t offset = layout -> offset;
+        uint bits = STEGO_BITS(encInfo -> flags);
+        off_t length = bmp_region_end(layout, (uint64_t)header_size * 8
+                                      + lsb_carrier_size(encInfo -> secret_file_size + STEGO_CRC_SIZE, bits)) - offset;
+
+        PRINT_INFO("INFO: Journaling %lld image bytes\n", (long long)length);
+        if(STATS_STAGE("journal_begin", journal_begin(encInfo -> src_image_fname, fd, offset, length)) == e_success)
+        {
+            double start = stats_now();
+            unsigned char *map = NULL;
+            if(!layout -> contiguous)
+            {
+                map = mmap(NULL, offset + length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                if(map == MAP_FAILED)
+                {
+                    perror("mmap");
+                    map = NULL;
+                }
+            }
+
+            PRINT_INFO("INFO: Encoding Stego Header\n");
+            ret = layout -> contiguous || map != NULL ? encode_block_in_place(fd, map, layout, pos, header, header_size, 1) : e_failure;
+            pos += header_size * 8;
+
+            PRINT_INFO("INFO: Encoding %s File Data\n", encInfo -> secret_fname);
+            uint64_t remaining = encInfo -> secret_file_size;
+            while(ret == e_success && remaining > 0)
+            {
+                uint count = remaining < ENCODE_BLOCK_SIZE ? remaining : ENCODE_BLOCK_SIZE;
+                if(fread(secret_file_data, 1, count, encInfo -> fptr_secret) != count)
+                {
+                    ret = e_failure;
+                    break;
+                }
+                ret = encode_block_in_place(fd, map, layout, pos, (unsigned char *)secret_file_data, count, bits);
+                crc = crc32c_update(crc, secret_file_data, count);
+                pos += lsb_carrier_size(count, bits);
+                remaining -= count;
+            }
+            if(ret == e_success)
+            {
+                encode_crc_bytes(crc, trailer);
+                ret = encode_block_in_place(fd, map, layout, pos, trailer, STEGO_CRC_SIZE, bits);
+            }
+            if(map != NULL)
+            {
+                if(msync(map, offset + length, MS_SYNC) != 0)
+                    ret = e_failure;
+                munmap(map, offset + length);
+            }
+
+            stats_stage_end("payload", start);
+
+            // Journal is dropped only once the patched image is on disk
+            start = stats_now();
+            int synced = ret == e_success && fsync(fd) == 0;
+            stats_stage_end("fsync", start);
+            if(synced)
+            {
+                ret = STATS_STAGE("journal_commit", journal_commit(encInfo -> src_image_fname));
+            }
+            else if(STATS_STAGE("journal_recover", journal_recover(encInfo -> src_image_fname, fd)) == e_success)
+            {
+                // Failed half way : the saved bytes go back at once, the image is left as it was
+                fprintf(stderr, "ERROR: In-place encoding of %s failed, the image was rolled back\n", encInfo -> src_image_fname);
+                ret = e_failure;
+            }
+            else
+            {
+                fprintf(stderr, "ERROR: In-place encoding of %s failed and could not be rolled back, run again to roll back\n",
+                        encInfo -> src_image_fname);
+                ret = e_failure;
+            }
+            PRINT_INFO("INFO: Done\n");
+        }
+    }
+    close_files(encInfo);
+    return ret;
+}
+
+/* Open the files of a streaming encode
+ * Input  : EncodeInfo with "-" for any of the names
+ * Output : "-" opens standard input (source image, secret) or the data
+ *          stream on standard output (stego image), other names are
+ *          opened as usual; nothing is ever seeked but the secret
+ * Return : e_success or e_failure, on file errors
+ */
+static Status open_files_stream(EncodeInfo *encInfo)
+{
+    PRINT_INFO("INFO: Opening Required files (streaming)\n");
+    encInfo -> fptr_src_image = stream_is_std(encInfo -> src_image_fname) ? stdin : fopen(encInfo -> src_image_fname, "r");
+    encInfo -> fptr_secret = stream_is_std(encInfo -> secret_fname) ? stdin : fopen(encInfo -> secret_fname, "r");
+    encInfo -> fptr_stego_image = stream_is_std(encInfo -> stego_image_fname) ? stream_stdout() : fopen(encInfo -> stego_image_fname, "w");
+
+    if(encInfo -> fptr_src_image == NULL || encInfo -> fptr_secret == NULL || encInfo -> fptr_stego_image == NULL)
+    {
+        perror("fopen");
+        fprintf(stderr, "ERROR: Unable to open file %s\n", encInfo -> fptr_src_image == NULL ? encInfo -> src_image_fname
+                        : encInfo -> fptr_secret == NULL ? encInfo -> secret_fname : encInfo -> stego_image_fname);
+        return e_failure;
+    }
+    PRINT_INFO("INFO: DONE\n");
+    return e_success;
+}
+
+/* Spool a piped secret
+ * Input  : EncodeInfo with the secret open and the source image layout
+ * Output : A secret that is not a regular file (pipe, socket, terminal)
+ *          is copied into an anonymous memory file, so its size is known
+ *          before the header is written. Reading stops as soon as it
+ *          no longer fits the carrier : past the capacity, or with
+ *          --compress past LZ_MAX_RATIO times the capacity, which no
+ *          stream can be decoded to. Memory stays bounded either way
+ * Return : e_success, or e_failure on a read error or a secret too big
+ */
+static Status spool_secret_file(EncodeInfo *encInfo)
+{
+    struct stat st;
+    char buffer[1 << 16];
+    uint64_t limit;
+    uint64_t size = 0;
+    size_t count;
+
+    if(fstat(fileno(encInfo -> fptr_secret), &st) == 0 && S_ISREG(st.st_mode))
+        return e_success;
+    limit = stego_capacity_bits(bmp_carrier_size(&encInfo -> layout), strlen(encInfo -> extn_secret_file),
+                                STEGO_BITS(encInfo -> flags));
+    if(encInfo -> flags & STEGO_FLAG_COMPRESSED)
+        limit *= LZ_MAX_RATIO;
+
+    PRINT_INFO("INFO: Reading %s\n", encInfo -> secret_fname);
+    int fd = memfd_create("stego-secret", MFD_CLOEXEC);
+    FILE *fptr = fd < 0 ? NULL : fdopen(fd, "w+");
+    if(fptr == NULL)
+    {
+        perror("memfd_create");
+        if(fd >= 0)
+            close(fd);
+        return e_failure;
+    }
+    while((count = fread(buffer, 1, sizeof(buffer), encInfo -> fptr_secret)) > 0)
+    {
+        if(size + count > limit)
+        {
+            fprintf(stderr, "ERROR: Capacity not available, %s does not fit in %s\n", encInfo -> secret_fname, encInfo -> src_image_fname);
+            fclose(fptr);
+            return e_failure;
+        }
+        if(fwrite(buffer, 1, count, fptr) != count)
+            break;
+        size += count;
+    }
+    if(ferror(encInfo -> fptr_secret) || ferror(fptr) || fflush(fptr) != 0)
+    {
+        fprintf(stderr, "ERROR: Unable to read %s\n", encInfo -> secret_fname);
+        fclose(fptr);
+        return e_failure;
+    }
+    rewind(fptr);
+    fclose(encInfo -> fptr_secret);
+    encInfo -> fptr_secret = fptr;
+    PRINT_INFO("INFO: Done. %llu bytes\n", (unsigned long long)size);
+    return e_success;
+}
+
+/* Encode the pixel array in one forward pass
+ * Input  : EncodeInfo, the source image stream at its first pixel byte
+ *          and the stego image stream just past its copied header
+ * Output : Windows of stream_window_rows() rows are read, get the part
+ *          of the stego header, secret data and payload crc that falls
+ *          in their carrier bytes, and are written out; the secret is
+ *          read in order on the way. Rows after the data are left to
+ *          the tail copy
+ * Return : e_success, or e_failure on an I/O error or a short image
+ */
+static Status encode_stream_pixels(EncodeInfo *encInfo)
+{
+    const BmpLayout *layout = &encInfo -> layout;
+    unsigned char header[STEGO_HEADER_MAX];
+    uint header_size = build_stego_header(encInfo, header);
+    uint bits = STEGO_BITS(encInfo -> flags);
+    uint64_t payload = (uint64_t)header_size * 8;                          // First carrier byte of the secret data
+    uint64_t trailer_pos = payload + lsb_carrier_size(encInfo -> secret_file_size, bits);
+    uint64_t end = trailer_pos + lsb_carrier_size(STEGO_CRC_SIZE, bits);
+    uint64_t rows = stream_window_rows(layout);
+    unsigned char *window = malloc(rows * layout -> stride);
+    unsigned char *data = malloc(rows * layout -> row_bytes);
+    unsigned char trailer[STEGO_CRC_SIZE];
+    uint32_t crc = 0;
+    Status ret = window != NULL && data != NULL ? e_success : e_failure;
+
+    PRINT_INFO("INFO: Encoding Stego Header and %s File Data (%llu rows per window)\n", encInfo -> secret_fname, (unsigned long long)rows);
+    for(uint64_t row = 0, pos = 0; ret == e_success && pos < end; row += rows)
+    {
+        uint64_t count = layout -> height - row < rows ? layout -> height - row : rows;
+        uint64_t next = pos + count * layout -> row_bytes;
+        uint64_t first, n;
+
+        if(stream_read(encInfo -> fptr_src_image, window, count * layout -> stride) != e_success)
+        {
+            fprintf(stderr, "ERROR: %s ends inside its pixel array\n", encInfo -> src_image_fname);
+            ret = e_failure;
+            break;
+        }
+
+        // Header at 1 bit per carrier byte, then secret data and its crc at --bits
+        if((n = stream_window_part(pos, next, 0, header_size, 1, &first)) > 0)
+            bmp_embed(layout, window, window, lsb_carrier_size(first, 1) - pos, header + first, n, 1, NULL);
+        if((n = stream_window_part(pos, next, payload, encInfo -> secret_file_size, bits, &first)) > 0)
+        {
+            if(stream_read(encInfo -> fptr_secret, data, n) != e_success)
+            {
+                fprintf(stderr, "ERROR: Unable to read %s\n", encInfo -> secret_fname);
+                ret = e_failure;
+                break;
+            }
+            bmp_embed(layout, window, window, payload + lsb_carrier_size(first, bits) - pos, data, n, bits, &crc);
+        }
+        if((n = stream_window_part(pos, next, trailer_pos, STEGO_CRC_SIZE, bits, &first)) > 0)
+        {
+            encode_crc_bytes(crc, trailer);
+            bmp_embed(layout, window, window, trailer_pos + lsb_carrier_size(first, bits) - pos, trailer + first, n, bits, NULL);
+        }
+
+        if(fwrite(window, 1, count * layout -> stride, encInfo -> fptr_stego_image) != count * layout -> stride)
+        {
+            fprintf(stderr, "ERROR: Unable to write %s\n", encInfo -> stego_image_fname);
+            ret = e_failure;
+        }
+        pos = next;
+    }
+    free(window);
+    free(data);
+    if(ret == e_success)
+        PRINT_INFO("INFO: Done\n");
+    return ret;
+}
+
+/* Do encoding in one forward pass
+ * Input  : EncodeInfo with "-" for the source image, the secret and / or
+ *          the output (or a /dev/fd/N secret)
+ * Output : Stego image identical to do_encoding()'s, written front to
+ *          back while the source image is read front to back: header
+ *          passed through, pixel array encoded a window of rows at a
+ *          time, the rest copied to end of file. No stream is seeked and
+ *          memory stays at one window; only a piped secret is held (see
+ *          spool_secret_file()), its size being part of the header
+ * Return : e_success or e_failure
+ */
+Status do_encoding_stream(EncodeInfo *encInfo)
+{
+    Status ret = e_failure;
+
+    if(STATS_STAGE("open", open_files_stream(encInfo)) == e_success)
+    {
+        PRINT_INFO("INFO: ## Encoding Procedure Started ##\n");
+        if(STATS_STAGE("header_copy", stream_read_layout(encInfo -> fptr_src_image, encInfo -> fptr_stego_image,
+                                                        encInfo -> use_alpha, &encInfo -> layout)) != e_success)
+        {
+            fprintf(stderr, "ERROR: %s is not a supported BMP (uncompressed 8, 24 or 32 bpp)\n", encInfo -> src_image_fname);
+        }
+        else if(STATS_STAGE("spool", spool_secret_file(encInfo)) == e_success
+                && STATS_STAGE("compress", compress_secret_file(encInfo)) == e_success
+                && STATS_STAGE("capacity", check_capacity(encInfo)) == e_success
+                && STATS_STAGE("payload", encode_stream_pixels(encInfo)) == e_success)
+        {
+            ret = STATS_STAGE("tail_copy", stream_copy(encInfo -> fptr_src_image, encInfo -> fptr_stego_image, UINT64_MAX));
+            if(ret == e_success && fflush(encInfo -> fptr_stego_image) != 0)
+            {
+                perror("fflush");
+                ret = e_failure;
+            }
+        }
+    }
+    double start = stats_now();
+    close_files(encInfo);
+    stats_stage_end("close", start);
+    return ret;
+}
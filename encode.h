@@ -1,8 +1,17 @@
 #ifndef ENCODE_H
 #define ENCODE_H
 
+#include <stdint.h>
+#include "bmp.h"
+#include "uring.h"
 #include "types.h" // Contains user defined types
 
+/* Payload bytes encoded per read/encode/write block */
+#define ENCODE_BLOCK_SIZE 4096
+
+/* Buffer size of the read/write fallback when copying the image tail */
+#define COPY_BUFFER_SIZE (1 << 20)
+
 /* 
  * Structure to store information required for
  * encoding secret file to source Image
@@ -15,18 +24,31 @@ typedef struct _EncodeInfo
     /* Source Image info */
     char *src_image_fname;        // store the Src_Image_fname
     FILE *fptr_src_image;         // File pointer for src_image
-    uint image_capacity;          // Store the src_img_filesize
+    uint64_t image_capacity;      // Carrier bytes of the src image
+    BmpLayout layout;             // Pixel layout parsed from the src image header
 
     /* Secret File Info */
     char *secret_fname;          // store the Secret_fname
     FILE *fptr_secret;           // File pointer for secret_file
-    uint secret_file_size;       // Storing the secret file size
+    uint64_t secret_file_size;   // Storing the secret file size (of its compressed stream with --compress)
     char extn_secret_file[5];    // Storing the secret file extension
+    uint flags;                  // Stego header flag bits (within STEGO_FLAGS_KNOWN), STEGO_FLAG_BITS(--bits), STEGO_FLAG_COMPRESSED
 
     /* Stego Image Info */
     char *stego_image_fname;     // Store the ouptut_img_fname
     FILE *fptr_stego_image;      // File pointer for output_img
 
+    /* Encoding options */
+    uint use_mmap;               // Encode through memory mapped files (--mmap)
+    uint in_place;               // Patch the source image itself (--in-place)
+    uint stream;                 // Single forward pass over pipes ("-" image / secret / output)
+    uint threads;                // Threads for the mapped payload stage (-j N)
+    uint use_alpha;              // 32 bpp carriers also hide data in alpha bytes (--alpha)
+    char *io_buffer;             // Optional caller owned stdio buffer for the image streams
+    size_t io_buffer_size;       // Its size (split between source and stego image)
+    Uring *ring;                 // Optional io_uring of the streaming payload stage (--uring), NULL : reader / writer threads
+    uint block_size;             // Payload bytes per pipeline block (--block-size), 0 : PIPE_BLOCK_SIZE
+
 } EncodeInfo;
 
 
@@ -44,21 +66,30 @@ Status do_encoding(EncodeInfo *encInfo);
 /* Get File pointers for i/p and o/p files */
 Status open_files(EncodeInfo *encInfo);
 
+/* Close the files opened by open_files() */
+void close_files(EncodeInfo *encInfo);
+
+/* Replace the secret file by its compressed stream (--compress) */
+Status compress_secret_file(EncodeInfo *encInfo);
+
 /* check capacity */
 Status check_capacity(EncodeInfo *encInfo);
 
-/* Get image size */
-uint get_image_size_for_bmp(FILE *fptr_image);
+/* Get image size (carrier bytes of the pixel array) */
+uint64_t get_image_size_for_bmp(FILE *fptr_image);
 
 /* Get file size */
-uint get_file_size(FILE *fptr);
+uint64_t get_file_size(FILE *fptr);
 
-/* Copy bmp image header */
+/* Copy bmp image header (everything before bfOffBits) */
 Status copy_bmp_header(FILE *fptr_src_image, FILE *fptr_dest_image);
 
 /* Store Magic String */
 Status encode_magic_string(const char *magic_string, EncodeInfo *encInfo);
 
+/* Encode header version marker and flags */
+Status encode_stego_version(uint flags, EncodeInfo *encInfo);
+
 /* Encode secret file extension size */
 Status encode_secret_file_extn_size(int size, EncodeInfo *encInfo); 
 
@@ -66,13 +97,16 @@ Status encode_secret_file_extn_size(int size, EncodeInfo *encInfo);
 Status encode_secret_file_extn(const char *file_extn, EncodeInfo *encInfo);
 
 /* Encode secret file size */
-Status encode_secret_file_size(long file_size, EncodeInfo *encInfo);
+Status encode_secret_file_size(uint64_t file_size, EncodeInfo *encInfo);
 
-/* Encode secret file data*/
+/* Encode header checksum */
+Status encode_header_crc(EncodeInfo *encInfo);
+
+/* Encode secret file data and its checksum */
 Status encode_secret_file_data(EncodeInfo *encInfo);
 
 /* Encode function, which does the real encoding #*/
-Status encode_data_to_image(const char *data, int size, EncodeInfo* encInfo);
+Status encode_data_to_image(const char *data, int size, uint bits, EncodeInfo* encInfo);
 
 /* Encode a byte into LSB of image data array #*/
 Status encode_byte_to_lsb(char data, char *image_buffer); 
@@ -80,8 +114,37 @@ Status encode_byte_to_lsb(char data, char *image_buffer);
 // Encoding an into to LSB of image data array
 Status encode_int_to_lsb(int data, char* buffer );
 
+/* Encode a 64-bit size into 64 LSBs of image data array */
+Status encode_size_to_lsb(uint64_t data, char *image_buffer);
+
 /* Copy remaining image bytes from src to stego image after encoding */
 Status copy_remaining_img_data(FILE *fptr_src, FILE *fptr_dest);
 
+/* Copy a byte range between files inside the kernel (reflink / copy_file_range / sendfile) */
+Status copy_fd_range(int fd_src, off_t src_off, int fd_dest, off_t dest_off, off_t len);
+
+/* Perform the encoding in one forward pass over pipes ("-" arguments) */
+Status do_encoding_stream(EncodeInfo *encInfo);
+
+/* Perform the encoding over memory mapped files (--mmap) */
+Status do_encoding_mmap(EncodeInfo *encInfo);
+
+/* Encode data from mapped source pixels straight into mapped stego pixels */
+Status encode_data_to_mapped(const char *data, uint size, const char *src, char *dest);
+
+/* Encode a 32-bit integer from mapped source pixels into mapped stego pixels */
+Status encode_int_to_mapped(uint data, const char *src, char *dest);
+
+/* Encode the secret data (bits per image byte) and copy the left over data of mapped images, on N threads,
+ * the CRC32C of the secret data returned in crc (may be NULL) */
+Status encode_payload_mapped(const char *src, char *dest, uint64_t image_size, uint64_t offset, const char *data, uint64_t size,
+                             uint bits, uint threads, uint32_t *crc);
+
+/* Build the bytes encoded before the secret data (magic, marker, flags, extn size, extn, file size, crc), STEGO_HEADER_MAX at most */
+uint build_stego_header(EncodeInfo *encInfo, unsigned char *header);
+
+/* Perform the encoding by patching the source image in place (--in-place) */
+Status do_encoding_in_place(EncodeInfo *encInfo);
+
 #endif
  
\ No newline at end of file
@@ -0,0 +1,228 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : journal.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the rollback journal used by in-place encoding.
+ *
+ * Journal file layout :
+ * ---------------------
+ *      → JournalHeader (magic, region offset, region length)
+ *      → Original bytes of the region
+ *      → 32-bit FNV-1a checksum of everything above
+ *
+ * A journal is only trusted when its size and checksum match, which can
+ * only happen after it was fully written and fsync'ed. A partial journal
+ * means the carrier was never touched, so it is simply discarded.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "journal.h"
+
+/* Bytes copied per read/write while saving or restoring a region */
+#define JOURNAL_BUFFER_SIZE (1 << 16)
+
+/* FNV-1a checksum
+ * Input  : Running hash, data and size
+ * Output : Updated hash
+ */
+static uint32_t journal_checksum(uint32_t hash, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    for(size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+/* Sync the directory holding a file, so its creation / removal is durable
+ * Input  : File name
+ */
+static void journal_sync_dir(const char *fname)
+{
+    char dir[4096];
+    const char *slash = strrchr(fname, '/');
+
+    if(slash == NULL)
+    {
+        strcpy(dir, ".");
+    }
+    else
+    {
+        snprintf(dir, sizeof(dir), "%.*s", (int)(slash - fname) + 1, fname);
+    }
+    int fd = open(dir, O_RDONLY);
+    if(fd >= 0)
+    {
+        fsync(fd);
+        close(fd);
+    }
+}
+
+/* Build journal file name
+ * Input  : Image file name, output buffer and its size
+ * Output : "<image>.journal"
+ */
+void journal_fname(const char *image_fname, char *journal, size_t size)
+{
+    snprintf(journal, size, "%s%s", image_fname, JOURNAL_SUFFIX);
+}
+
+/* Begin journal
+ * Input  : Image file name and fd, region offset and length
+ * Output : Journal holding the original region bytes, fsync'ed
+ * Return : e_success or e_failure (the image is untouched either way)
+ */
+Status journal_begin(const char *image_fname, int fd_image, uint64_t offset, uint64_t length)
+{
+    char fname[4096];
+    journal_fname(image_fname, fname, sizeof(fname));
+
+    int fd = open(fname, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if(fd < 0)
+    {
+        perror("open");
+        fprintf(stderr, "ERROR: Unable to create journal %s\n", fname);
+        return e_failure;
+    }
+
+    JournalHeader header = { JOURNAL_MAGIC, offset, length };
+    uint32_t hash = journal_checksum(2166136261u, &header, sizeof(header));
+    Status ret = write(fd, &header, sizeof(header)) == sizeof(header) ? e_success : e_failure;
+
+    char *buffer = malloc(JOURNAL_BUFFER_SIZE);
+    uint64_t done = 0;
+    while(ret == e_success && done < length)
+    {
+        size_t count = length - done < JOURNAL_BUFFER_SIZE ? length - done : JOURNAL_BUFFER_SIZE;
+        if(buffer == NULL || pread(fd_image, buffer, count, offset + done) != (ssize_t)count
+           || write(fd, buffer, count) != (ssize_t)count)
+        {
+            ret = e_failure;
+            break;
+        }
+        hash = journal_checksum(hash, buffer, count);
+        done += count;
+    }
+    free(buffer);
+
+    if(ret == e_success && (write(fd, &hash, sizeof(hash)) != sizeof(hash) || fsync(fd) != 0))
+    {
+        ret = e_failure;
+    }
+    close(fd);
+
+    if(ret == e_failure)
+    {
+        fprintf(stderr, "ERROR: Unable to write journal %s\n", fname);
+        unlink(fname);
+        return e_failure;
+    }
+    journal_sync_dir(fname);
+    return e_success;
+}
+
+/* Commit journal
+ * Input  : Image file name (the patched image must be fsync'ed already)
+ * Output : Removes the journal
+ */
+Status journal_commit(const char *image_fname)
+{
+    char fname[4096];
+    journal_fname(image_fname, fname, sizeof(fname));
+
+    if(unlink(fname) != 0)
+    {
+        perror("unlink");
+        return e_failure;
+    }
+    journal_sync_dir(fname);
+    return e_success;
+}
+
+/* Recover from journal
+ * Input  : Image file name and fd opened for writing
+ * Output : If a complete journal exists, its saved bytes are written
+ *          back and fsync'ed; any journal is then removed
+ * Return : e_success (also when there is nothing to recover) or e_failure
+ */
+Status journal_recover(const char *image_fname, int fd_image)
+{
+    char fname[4096];
+    journal_fname(image_fname, fname, sizeof(fname));
+
+    int fd = open(fname, O_RDONLY);
+    if(fd < 0)
+    {
+        return e_success;        // no interrupted run
+    }
+
+    struct stat st;
+    JournalHeader header;
+    int complete = fstat(fd, &st) == 0
+                   && read(fd, &header, sizeof(header)) == sizeof(header)
+                   && memcmp(header.magic, JOURNAL_MAGIC, sizeof(header.magic)) == 0
+                   && (uint64_t)st.st_size == sizeof(header) + header.length + sizeof(uint32_t);
+
+    // Verify the checksum before trusting any saved byte
+    char *buffer = malloc(JOURNAL_BUFFER_SIZE);
+    if(complete && buffer != NULL)
+    {
+        uint32_t hash = journal_checksum(2166136261u, &header, sizeof(header));
+        uint32_t stored = 0;
+        for(uint64_t done = 0; complete && done < header.length; )
+        {
+            size_t count = header.length - done < JOURNAL_BUFFER_SIZE ? header.length - done : JOURNAL_BUFFER_SIZE;
+            complete = read(fd, buffer, count) == (ssize_t)count;
+            hash = journal_checksum(hash, buffer, count);
+            done += count;
+        }
+        complete = complete && read(fd, &stored, sizeof(stored)) == sizeof(stored) && stored == hash;
+    }
+
+    Status ret = e_success;
+    if(complete && buffer != NULL)
+    {
+        PRINT_INFO("INFO: Rolling back interrupted in-place encoding of %s\n", image_fname);
+        for(uint64_t done = 0; done < header.length; )
+        {
+            size_t count = header.length - done < JOURNAL_BUFFER_SIZE ? header.length - done : JOURNAL_BUFFER_SIZE;
+            if(pread(fd, buffer, count, sizeof(header) + done) != (ssize_t)count
+               || pwrite(fd_image, buffer, count, header.offset + done) != (ssize_t)count)
+            {
+                ret = e_failure;
+                break;
+            }
+            done += count;
+        }
+        if(ret == e_success && fsync(fd_image) != 0)
+        {
+            ret = e_failure;
+        }
+    }
+    else if(buffer == NULL)
+    {
+        ret = e_failure;
+    }
+    free(buffer);
+    close(fd);
+
+    if(ret == e_failure)
+    {
+        fprintf(stderr, "ERROR: Unable to roll back %s from %s\n", image_fname, fname);
+        return e_failure;        // keep the journal for the next attempt
+    }
+    unlink(fname);
+    journal_sync_dir(fname);
+    return e_success;
+}
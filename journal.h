@@ -0,0 +1,43 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include "types.h"
+
+/*
+ * Rollback journal for in-place encoding (-e --in-place).
+ *
+ * Before any carrier byte is patched, the original bytes of the region
+ * are saved to "<image>.journal" and fsync'ed. The journal is removed
+ * only after the patched carrier is fsync'ed, so a run interrupted at
+ * any point leaves either an untouched carrier or a complete journal
+ * that the next in-place run rolls back first.
+ */
+
+/* Suffix added to the carrier name for its journal */
+#define JOURNAL_SUFFIX ".journal"
+
+/* Magic at the start of every journal file */
+#define JOURNAL_MAGIC "STGJRNL1"
+
+/* Fixed size journal header, followed by the saved bytes and a checksum */
+typedef struct _JournalHeader
+{
+    char magic[8];           // JOURNAL_MAGIC
+    uint64_t offset;         // Offset of the saved region in the carrier
+    uint64_t length;         // Number of saved bytes
+} JournalHeader;
+
+/* Build the journal file name for an image */
+void journal_fname(const char *image_fname, char *journal, size_t size);
+
+/* Save the original bytes [offset, offset + length) of fd_image */
+Status journal_begin(const char *image_fname, int fd_image, uint64_t offset, uint64_t length);
+
+/* Remove the journal once the patched image is durable */
+Status journal_commit(const char *image_fname);
+
+/* Roll an interrupted run back, if a complete journal exists */
+Status journal_recover(const char *image_fname, int fd_image);
+
+#endif
@@ -0,0 +1,917 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : lsb.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the LSB embedding and extraction kernels used on
+ * the payload hot path. Every kernel produces exactly the same bytes as
+ * the bit by bit loops of encode_byte_to_lsb() / decode_bytes_from_lsb(),
+ * only many payload bytes at a time:
+ *
+ *      → scalar : branch free byte loop (any CPU)
+ *      → sse2   : 4 payload bytes ⇄ 32 carrier bytes per step
+ *      → avx2   : 8 payload bytes ⇄ 64 carrier bytes per step
+ *      → bmi2   : pdep / pext, 1 payload byte ⇄ 8 carrier bytes per step
+ *      → avx512 : 8 payload bytes ⇄ 64 carrier bytes with mask registers
+ *
+ * Multi-bit depths (--bits=2|4) have their own kernels per variant, the
+ * payload bits of a byte are spread MSB first over 8 / bits carrier
+ * bytes, bits in the low end of each (avx512 uses the avx2 ones):
+ *
+ *      → scalar : shift / mask loop with the depth fixed at compile time
+ *      → sse2   : nibble / crumb split and byte interleave (unpack)
+ *      → avx2   : the same on 256 bits, lanes put back in order
+ *      → bmi2   : pdep / pext with 0x0F0F.. and 0x0303.. masks
+ *
+ * All x86 kernels are compiled with per-function target attributes, so
+ * one binary carries every variant. The kernel is picked at startup from
+ * cpuid (the widest one the CPU supports) or pinned with --kernel=NAME.
+ *
+ * The checksummed variants (lsb_embed_bits_crc / lsb_extract_bits_crc)
+ * run the kernel and the CRC32C over the same L1 sized chunk in turn.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <string.h>
+#include "crc32c.h"
+#include "lsb.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define LSB_X86
+#include <immintrin.h>
+#define LSB_TARGET(isa) __attribute__((target(isa)))
+#endif
+
+/* Payload bytes per step of the checksummed embed / extract */
+#define LSB_CRC_CHUNK 4096
+
+/* Mask to clear the LSB of 8 carrier bytes at once */
+#define LSB_CLEAR_MASK64 0xFEFEFEFEFEFEFEFEULL
+
+/* Scalar embed kernel
+ * Input  : Source carrier bytes, destination, payload and payload size
+ * Output : 8 * n destination bytes with payload bits in their LSBs
+ */
+static void lsb_embed_scalar(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        unsigned char byte = data[i];
+        for(int j = 0; j < 8; j++)
+        {
+            dest[j] = (src[j] & 0xFE) | ((byte >> (7 - j)) & 1);
+        }
+        src += 8;
+        dest += 8;
+    }
+}
+
+/* Scalar extract kernel
+ * Input  : Carrier bytes, output buffer and payload size
+ * Output : n payload bytes rebuilt MSB first from carrier LSBs
+ */
+static void lsb_extract_scalar(const unsigned char *src, unsigned char *data, size_t n)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        unsigned char byte = 0;
+        for(int j = 0; j < 8; j++)
+        {
+            byte = (byte << 1) | (src[j] & 1);
+        }
+        data[i] = byte;
+        src += 8;
+    }
+}
+
+/* Scalar k-bit embed
+ * Input  : Source carrier bytes, destination, payload, payload size and
+ *          the depth (2 or 4, a constant in every caller)
+ * Output : 8 / bits destination bytes per payload byte, payload bits in
+ *          their low bits, MSB first
+ */
+static inline void lsb_embed_bits_scalar(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n, int bits)
+{
+    const int per_byte = 8 / bits;
+    const unsigned char mask = (1 << bits) - 1;
+
+    for(size_t i = 0; i < n; i++)
+    {
+        unsigned char byte = data[i];
+        for(int j = 0; j < per_byte; j++)
+        {
+            dest[j] = (src[j] & ~mask) | ((byte >> (8 - bits * (j + 1))) & mask);
+        }
+        src += per_byte;
+        dest += per_byte;
+    }
+}
+
+/* Scalar k-bit extract
+ * Input  : Carrier bytes, output buffer, payload size and the depth
+ * Output : n payload bytes rebuilt MSB first from the low bits
+ */
+static inline void lsb_extract_bits_scalar(const unsigned char *src, unsigned char *data, size_t n, int bits)
+{
+    const int per_byte = 8 / bits;
+    const unsigned char mask = (1 << bits) - 1;
+
+    for(size_t i = 0; i < n; i++)
+    {
+        unsigned char byte = 0;
+        for(int j = 0; j < per_byte; j++)
+        {
+            byte = (byte << bits) | (src[j] & mask);
+        }
+        data[i] = byte;
+        src += per_byte;
+    }
+}
+
+static void lsb_embed2_scalar(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    lsb_embed_bits_scalar(src, dest, data, n, 2);
+}
+
+static void lsb_extract2_scalar(const unsigned char *src, unsigned char *data, size_t n)
+{
+    lsb_extract_bits_scalar(src, data, n, 2);
+}
+
+static void lsb_embed4_scalar(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    lsb_embed_bits_scalar(src, dest, data, n, 4);
+}
+
+static void lsb_extract4_scalar(const unsigned char *src, unsigned char *data, size_t n)
+{
+    lsb_extract_bits_scalar(src, data, n, 4);
+}
+
+#if defined(LSB_X86)
+/* SSE2 embed kernel
+ * Description : Each payload byte is broadcast over 8 lanes, ANDed with
+ * the per-lane bit mask (0x80 .. 0x01) and compared against it, which
+ * leaves 0xFF in lanes whose bit is set. Masking that with 1 gives the
+ * new LSBs for 16 carrier bytes.
+ */
+LSB_TARGET("sse2")
+static void lsb_embed_sse2(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    const __m128i bits = _mm_set_epi8(1, 2, 4, 8, 16, 32, 64, (char)128,
+                                      1, 2, 4, 8, 16, 32, 64, (char)128);
+    const __m128i one = _mm_set1_epi8(1);
+    const __m128i clear = _mm_set1_epi8((char)0xFE);
+    size_t i = 0;
+
+    for(; i + 4 <= n; i += 4)
+    {
+        uint32_t word;
+        memcpy(&word, data + i, 4);
+
+        __m128i v = _mm_cvtsi32_si128((int)word);
+        v = _mm_unpacklo_epi8(v, v);                 // b0 b0 b1 b1 b2 b2 b3 b3
+        v = _mm_unpacklo_epi16(v, v);                // b0 x4, b1 x4, b2 x4, b3 x4
+        __m128i lo = _mm_unpacklo_epi32(v, v);       // b0 x8, b1 x8
+        __m128i hi = _mm_unpackhi_epi32(v, v);       // b2 x8, b3 x8
+
+        __m128i m0 = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(lo, bits), bits), one);
+        __m128i m1 = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(hi, bits), bits), one);
+
+        __m128i c0 = _mm_loadu_si128((const __m128i *)(src + 8 * i));
+        __m128i c1 = _mm_loadu_si128((const __m128i *)(src + 8 * i + 16));
+        _mm_storeu_si128((__m128i *)(dest + 8 * i), _mm_or_si128(_mm_and_si128(c0, clear), m0));
+        _mm_storeu_si128((__m128i *)(dest + 8 * i + 16), _mm_or_si128(_mm_and_si128(c1, clear), m1));
+    }
+    lsb_embed_scalar(src + 8 * i, dest + 8 * i, data + i, n - i);
+}
+
+/* SSE2 extract kernel
+ * Description : The 8 carrier bytes of every payload byte are reversed
+ * (16-bit word shuffle + byte swap), so shifting each LSB up to the
+ * sign bit and taking movemask yields 2 payload bytes per 16 bytes.
+ */
+LSB_TARGET("sse2")
+static void lsb_extract_sse2(const unsigned char *src, unsigned char *data, size_t n)
+{
+    size_t i = 0;
+
+    for(; i + 4 <= n; i += 4)
+    {
+        for(int half = 0; half < 2; half++)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *)(src + 8 * i + 16 * half));
+            v = _mm_shufflehi_epi16(_mm_shufflelo_epi16(v, 0x1B), 0x1B);   // reverse words per 8 bytes
+            v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));   // swap bytes in words
+            int mask = _mm_movemask_epi8(_mm_slli_epi16(v, 7));             // LSB → sign bit
+
+            data[i + 2 * half] = (unsigned char)mask;
+            data[i + 2 * half + 1] = (unsigned char)(mask >> 8);
+        }
+    }
+    lsb_extract_scalar(src + 8 * i, data + i, n - i);
+}
+
+/* AVX2 embed kernel
+ * Description : 4 payload bytes are broadcast to every 128-bit lane and
+ * a byte shuffle repeats each of them 8 times (b0 b1 in the low lane,
+ * b2 b3 in the high lane). The bit mask compare then works as in SSE2.
+ * The tail (less than 8 payload bytes) goes through the SSE2 kernel.
+ */
+LSB_TARGET("avx2")
+static void lsb_embed_avx2(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                            2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+    const __m256i bits = _mm256_set1_epi64x((long long)0x0102040810204080ULL);
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i clear = _mm256_set1_epi8((char)0xFE);
+    size_t i = 0;
+
+    for(; i + 8 <= n; i += 8)
+    {
+        uint32_t w0, w1;
+        memcpy(&w0, data + i, 4);
+        memcpy(&w1, data + i + 4, 4);
+
+        __m256i v0 = _mm256_shuffle_epi8(_mm256_set1_epi32((int)w0), spread);
+        __m256i v1 = _mm256_shuffle_epi8(_mm256_set1_epi32((int)w1), spread);
+        __m256i m0 = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(v0, bits), bits), one);
+        __m256i m1 = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(v1, bits), bits), one);
+
+        __m256i c0 = _mm256_loadu_si256((const __m256i *)(src + 8 * i));
+        __m256i c1 = _mm256_loadu_si256((const __m256i *)(src + 8 * i + 32));
+        _mm256_storeu_si256((__m256i *)(dest + 8 * i), _mm256_or_si256(_mm256_and_si256(c0, clear), m0));
+        _mm256_storeu_si256((__m256i *)(dest + 8 * i + 32), _mm256_or_si256(_mm256_and_si256(c1, clear), m1));
+    }
+    lsb_embed_sse2(src + 8 * i, dest + 8 * i, data + i, n - i);
+}
+
+/* AVX2 extract kernel
+ * Description : A byte shuffle reverses every 8 byte group, then the
+ * LSBs are shifted to the sign bits and movemask packs 32 carrier
+ * bytes into 4 payload bytes.
+ */
+LSB_TARGET("avx2")
+static void lsb_extract_avx2(const unsigned char *src, unsigned char *data, size_t n)
+{
+    const __m256i reverse = _mm256_setr_epi8(7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8,
+                                             7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8);
+    size_t i = 0;
+
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)(src + 8 * i));
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(src + 8 * i + 32));
+        uint32_t w0 = (uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(_mm256_shuffle_epi8(v0, reverse), 7));
+        uint32_t w1 = (uint32_t)_mm256_movemask_epi8(_mm256_slli_epi16(_mm256_shuffle_epi8(v1, reverse), 7));
+
+        memcpy(data + i, &w0, 4);
+        memcpy(data + i + 4, &w1, 4);
+    }
+    lsb_extract_sse2(src + 8 * i, data + i, n - i);
+}
+
+/* SSE2 4-bit embed kernel
+ * Description : 16 payload bytes are split into high and low nibbles,
+ * interleaving them (unpack) gives the 32 new carrier low nibbles.
+ */
+LSB_TARGET("sse2")
+static void lsb_embed4_sse2(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    const __m128i low = _mm_set1_epi8(0x0F);
+    const __m128i clear = _mm_set1_epi8((char)0xF0);
+    size_t i = 0;
+
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i hi = _mm_and_si128(_mm_srli_epi16(d, 4), low);
+        __m128i lo = _mm_and_si128(d, low);
+
+        __m128i c0 = _mm_loadu_si128((const __m128i *)(src + 2 * i));
+        __m128i c1 = _mm_loadu_si128((const __m128i *)(src + 2 * i + 16));
+        _mm_storeu_si128((__m128i *)(dest + 2 * i), _mm_or_si128(_mm_and_si128(c0, clear), _mm_unpacklo_epi8(hi, lo)));
+        _mm_storeu_si128((__m128i *)(dest + 2 * i + 16), _mm_or_si128(_mm_and_si128(c1, clear), _mm_unpackhi_epi8(hi, lo)));
+    }
+    lsb_embed4_scalar(src + 2 * i, dest + 2 * i, data + i, n - i);
+}
+
+/* SSE2 4-bit extract kernel
+ * Description : In every 16-bit word (c0 | c1 << 8) the low nibbles
+ * give (c0 << 4) | c1, packing the words gives 16 payload bytes.
+ */
+LSB_TARGET("sse2")
+static void lsb_extract4_sse2(const unsigned char *src, unsigned char *data, size_t n)
+{
+    const __m128i low = _mm_set1_epi8(0x0F);
+    const __m128i word = _mm_set1_epi16(0x00FF);
+    size_t i = 0;
+
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i t0 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + 2 * i)), low);
+        __m128i t1 = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + 2 * i + 16)), low);
+        t0 = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(t0, 4), _mm_srli_epi16(t0, 8)), word);
+        t1 = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(t1, 4), _mm_srli_epi16(t1, 8)), word);
+        _mm_storeu_si128((__m128i *)(data + i), _mm_packus_epi16(t0, t1));
+    }
+    lsb_extract4_scalar(src + 2 * i, data + i, n - i);
+}
+
+/* SSE2 2-bit embed kernel
+ * Description : 16 payload bytes are split into their 4 bit pairs
+ * (bits 7-6, 5-4, 3-2, 1-0), two levels of interleaving (bytes, then
+ * words) put them in carrier order for 64 carrier bytes.
+ */
+LSB_TARGET("sse2")
+static void lsb_embed2_sse2(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    const __m128i pair = _mm_set1_epi8(0x03);
+    const __m128i clear = _mm_set1_epi8((char)0xFC);
+    size_t i = 0;
+
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i d = _mm_loadu_si128((const __m128i *)(data + i));
+        __m128i s6 = _mm_and_si128(_mm_srli_epi16(d, 6), pair);
+        __m128i s4 = _mm_and_si128(_mm_srli_epi16(d, 4), pair);
+        __m128i s2 = _mm_and_si128(_mm_srli_epi16(d, 2), pair);
+        __m128i s0 = _mm_and_si128(d, pair);
+
+        __m128i a_lo = _mm_unpacklo_epi8(s6, s4), b_lo = _mm_unpacklo_epi8(s2, s0);
+        __m128i a_hi = _mm_unpackhi_epi8(s6, s4), b_hi = _mm_unpackhi_epi8(s2, s0);
+        __m128i out[4] = { _mm_unpacklo_epi16(a_lo, b_lo), _mm_unpackhi_epi16(a_lo, b_lo),
+                           _mm_unpacklo_epi16(a_hi, b_hi), _mm_unpackhi_epi16(a_hi, b_hi) };
+
+        for(int k = 0; k < 4; k++)
+        {
+            __m128i c = _mm_loadu_si128((const __m128i *)(src + 4 * i + 16 * k));
+            _mm_storeu_si128((__m128i *)(dest + 4 * i + 16 * k), _mm_or_si128(_mm_and_si128(c, clear), out[k]));
+        }
+    }
+    lsb_embed2_scalar(src + 4 * i, dest + 4 * i, data + i, n - i);
+}
+
+/* SSE2 2-bit extract kernel
+ * Description : Word step : (c0 << 2) | c1, dword step : (w0 << 4) | w1,
+ * leaving one payload byte per dword; two saturating packs gather 16.
+ */
+LSB_TARGET("sse2")
+static void lsb_extract2_sse2(const unsigned char *src, unsigned char *data, size_t n)
+{
+    const __m128i pair = _mm_set1_epi8(0x03);
+    const __m128i nibble = _mm_set1_epi16(0x000F);
+    const __m128i byte = _mm_set1_epi32(0x000000FF);
+    size_t i = 0;
+
+    for(; i + 16 <= n; i += 16)
+    {
+        __m128i t[4];
+        for(int k = 0; k < 4; k++)
+        {
+            __m128i v = _mm_and_si128(_mm_loadu_si128((const __m128i *)(src + 4 * i + 16 * k)), pair);
+            v = _mm_and_si128(_mm_or_si128(_mm_slli_epi16(v, 2), _mm_srli_epi16(v, 8)), nibble);
+            t[k] = _mm_and_si128(_mm_or_si128(_mm_slli_epi32(v, 4), _mm_srli_epi32(v, 16)), byte);
+        }
+        __m128i w0 = _mm_packs_epi32(t[0], t[1]);
+        __m128i w1 = _mm_packs_epi32(t[2], t[3]);
+        _mm_storeu_si128((__m128i *)(data + i), _mm_packus_epi16(w0, w1));
+    }
+    lsb_extract2_scalar(src + 4 * i, data + i, n - i);
+}
+
+/* AVX2 4-bit embed kernel
+ * Description : As in SSE2 on 32 payload bytes; unpack works per
+ * 128-bit lane, so the lane halves are recombined in order.
+ */
+LSB_TARGET("avx2")
+static void lsb_embed4_avx2(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    const __m256i clear = _mm256_set1_epi8((char)0xF0);
+    size_t i = 0;
+
+    for(; i + 32 <= n; i += 32)
+    {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(d, 4), low);
+        __m256i lo = _mm256_and_si256(d, low);
+        __m256i a = _mm256_unpacklo_epi8(hi, lo);    // payload 0-7 | 16-23
+        __m256i b = _mm256_unpackhi_epi8(hi, lo);    // payload 8-15 | 24-31
+
+        __m256i c0 = _mm256_loadu_si256((const __m256i *)(src + 2 * i));
+        __m256i c1 = _mm256_loadu_si256((const __m256i *)(src + 2 * i + 32));
+        _mm256_storeu_si256((__m256i *)(dest + 2 * i), _mm256_or_si256(_mm256_and_si256(c0, clear), _mm256_permute2x128_si256(a, b, 0x20)));
+        _mm256_storeu_si256((__m256i *)(dest + 2 * i + 32), _mm256_or_si256(_mm256_and_si256(c1, clear), _mm256_permute2x128_si256(a, b, 0x31)));
+    }
+    lsb_embed4_sse2(src + 2 * i, dest + 2 * i, data + i, n - i);
+}
+
+/* AVX2 4-bit extract kernel
+ * Description : maddubs with weights (16, 1) folds every carrier byte
+ * pair into one payload byte, the per lane pack is put back in order.
+ */
+LSB_TARGET("avx2")
+static void lsb_extract4_avx2(const unsigned char *src, unsigned char *data, size_t n)
+{
+    const __m256i low = _mm256_set1_epi8(0x0F);
+    const __m256i weights = _mm256_set1_epi16(0x0110);
+    size_t i = 0;
+
+    for(; i + 32 <= n; i += 32)
+    {
+        __m256i t0 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(src + 2 * i)), low);
+        __m256i t1 = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(src + 2 * i + 32)), low);
+        __m256i p = _mm256_packus_epi16(_mm256_maddubs_epi16(t0, weights), _mm256_maddubs_epi16(t1, weights));
+        _mm256_storeu_si256((__m256i *)(data + i), _mm256_permute4x64_epi64(p, 0xD8));
+    }
+    lsb_extract4_sse2(src + 2 * i, data + i, n - i);
+}
+
+/* AVX2 2-bit embed kernel
+ * Description : As in SSE2 on 32 payload bytes, every output vector
+ * is recombined from the matching halves of two interleaved ones.
+ */
+LSB_TARGET("avx2")
+static void lsb_embed2_avx2(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    const __m256i pair = _mm256_set1_epi8(0x03);
+    const __m256i clear = _mm256_set1_epi8((char)0xFC);
+    size_t i = 0;
+
+    for(; i + 32 <= n; i += 32)
+    {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(data + i));
+        __m256i s6 = _mm256_and_si256(_mm256_srli_epi16(d, 6), pair);
+        __m256i s4 = _mm256_and_si256(_mm256_srli_epi16(d, 4), pair);
+        __m256i s2 = _mm256_and_si256(_mm256_srli_epi16(d, 2), pair);
+        __m256i s0 = _mm256_and_si256(d, pair);
+
+        __m256i a_lo = _mm256_unpacklo_epi8(s6, s4), b_lo = _mm256_unpacklo_epi8(s2, s0);
+        __m256i a_hi = _mm256_unpackhi_epi8(s6, s4), b_hi = _mm256_unpackhi_epi8(s2, s0);
+        __m256i ll = _mm256_unpacklo_epi16(a_lo, b_lo);   // payload 0-3   | 16-19
+        __m256i lh = _mm256_unpackhi_epi16(a_lo, b_lo);   // payload 4-7   | 20-23
+        __m256i hl = _mm256_unpacklo_epi16(a_hi, b_hi);   // payload 8-11  | 24-27
+        __m256i hh = _mm256_unpackhi_epi16(a_hi, b_hi);   // payload 12-15 | 28-31
+        __m256i out[4] = { _mm256_permute2x128_si256(ll, lh, 0x20), _mm256_permute2x128_si256(hl, hh, 0x20),
+                           _mm256_permute2x128_si256(ll, lh, 0x31), _mm256_permute2x128_si256(hl, hh, 0x31) };
+
+        for(int k = 0; k < 4; k++)
+        {
+            __m256i c = _mm256_loadu_si256((const __m256i *)(src + 4 * i + 32 * k));
+            _mm256_storeu_si256((__m256i *)(dest + 4 * i + 32 * k), _mm256_or_si256(_mm256_and_si256(c, clear), out[k]));
+        }
+    }
+    lsb_embed2_sse2(src + 4 * i, dest + 4 * i, data + i, n - i);
+}
+
+/* AVX2 2-bit extract kernel
+ * Description : maddubs with weights (64, 16, 4, 1) and madd with ones
+ * fold 4 carrier bytes into one dword per payload byte, a byte shuffle
+ * gathers them and the cross lane permute orders them.
+ */
+LSB_TARGET("avx2")
+static void lsb_extract2_avx2(const unsigned char *src, unsigned char *data, size_t n)
+{
+    const __m256i pair = _mm256_set1_epi8(0x03);
+    const __m256i weights = _mm256_set1_epi32(0x01041040);
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i gather = _mm256_setr_epi8(0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+                                            -1, -1, -1, -1, 0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m256i order = _mm256_setr_epi32(0, 5, 0, 0, 0, 0, 0, 0);
+    size_t i = 0;
+
+    for(; i + 8 <= n; i += 8)
+    {
+        __m256i v = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(src + 4 * i)), pair);
+        v = _mm256_madd_epi16(_mm256_maddubs_epi16(v, weights), ones);
+        v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, gather), order);
+        _mm_storel_epi64((__m128i *)(data + i), _mm256_castsi256_si128(v));
+    }
+    lsb_extract2_sse2(src + 4 * i, data + i, n - i);
+}
+
+/* AVX-512 embed kernel
+ * Description : 8 payload bytes are broadcast to every 128-bit lane,
+ * the shuffle repeats each of them 8 times and a byte test against
+ * the bit mask gives one mask bit per carrier byte, which selects
+ * between the LSB cleared and LSB set carrier bytes.
+ */
+LSB_TARGET("avx512bw")
+static void lsb_embed_avx512(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    const __m512i spread = _mm512_set_epi64(0x0707070707070707LL, 0x0606060606060606LL,
+                                            0x0505050505050505LL, 0x0404040404040404LL,
+                                            0x0303030303030303LL, 0x0202020202020202LL,
+                                            0x0101010101010101LL, 0x0000000000000000LL);
+    const __m512i bits = _mm512_set1_epi64((long long)0x0102040810204080ULL);
+    const __m512i one = _mm512_set1_epi8(1);
+    const __m512i clear = _mm512_set1_epi8((char)0xFE);
+    size_t i = 0;
+
+    for(; i + 8 <= n; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+
+        /* lane L needs payload bytes 2L and 2L + 1 */
+        __m512i v = _mm512_shuffle_epi8(_mm512_set1_epi64((long long)word), spread);
+        __mmask64 k = _mm512_test_epi8_mask(v, bits);
+
+        __m512i c = _mm512_loadu_si512((const void *)(src + 8 * i));
+        __m512i r = _mm512_mask_blend_epi8(k, _mm512_and_si512(c, clear), _mm512_or_si512(c, one));
+        _mm512_storeu_si512((void *)(dest + 8 * i), r);
+    }
+    lsb_embed_avx2(src + 8 * i, dest + 8 * i, data + i, n - i);
+}
+
+/* AVX-512 extract kernel
+ * Description : Every 8 byte group is reversed and a byte test of the
+ * LSBs packs 64 carrier bytes straight into an 8 byte payload mask.
+ */
+LSB_TARGET("avx512bw")
+static void lsb_extract_avx512(const unsigned char *src, unsigned char *data, size_t n)
+{
+    const __m512i reverse = _mm512_set4_epi32(0x08090A0B, 0x0C0D0E0F, 0x00010203, 0x04050607);
+    const __m512i one = _mm512_set1_epi8(1);
+    size_t i = 0;
+
+    for(; i + 8 <= n; i += 8)
+    {
+        __m512i v = _mm512_shuffle_epi8(_mm512_loadu_si512((const void *)(src + 8 * i)), reverse);
+        uint64_t word = (uint64_t)_mm512_test_epi8_mask(v, one);
+
+        memcpy(data + i, &word, 8);
+    }
+    lsb_extract_avx2(src + 8 * i, data + i, n - i);
+}
+#endif
+
+#if defined(LSB_X86) && defined(__x86_64__)
+/* BMI2 embed kernel
+ * Description : pdep deposits bit k of the payload byte into the LSB of
+ * carrier byte k. Byte swapping the result puts bit 7 (MSB) into the
+ * first carrier byte, matching the MSB first layout.
+ */
+LSB_TARGET("bmi2")
+static void lsb_embed_bmi2(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        uint64_t carrier;
+        memcpy(&carrier, src + 8 * i, 8);
+        uint64_t spread = __builtin_bswap64(_pdep_u64(data[i], 0x0101010101010101ULL));
+        carrier = (carrier & LSB_CLEAR_MASK64) | spread;
+        memcpy(dest + 8 * i, &carrier, 8);
+    }
+}
+
+/* BMI2 extract kernel
+ * Description : Byte swapping 8 carrier bytes and gathering their LSBs
+ * with pext gives the payload byte MSB first.
+ */
+LSB_TARGET("bmi2")
+static void lsb_extract_bmi2(const unsigned char *src, unsigned char *data, size_t n)
+{
+    for(size_t i = 0; i < n; i++)
+    {
+        uint64_t carrier;
+        memcpy(&carrier, src + 8 * i, 8);
+        data[i] = (unsigned char)_pext_u64(__builtin_bswap64(carrier), 0x0101010101010101ULL);
+    }
+}
+
+/* Swap the nibbles of every byte, so pdep / pext (low bits first) see
+ * the high nibble first */
+static inline uint32_t lsb_swap_nibbles(uint32_t word)
+{
+    return (word >> 4 & 0x0F0F0F0Fu) | (word & 0x0F0F0F0Fu) << 4;
+}
+
+/* Reverse the 4 bit pairs of every byte */
+static inline uint32_t lsb_reverse_pairs(uint32_t word)
+{
+    word = (word >> 4 & 0x0F0F0F0Fu) | (word & 0x0F0F0F0Fu) << 4;
+    return (word >> 2 & 0x33333333u) | (word & 0x33333333u) << 2;
+}
+
+/* BMI2 4-bit embed kernel
+ * Description : pdep deposits the nibbles of 4 payload bytes (swapped,
+ * high nibble first) into the low nibbles of 8 carrier bytes.
+ */
+LSB_TARGET("bmi2")
+static void lsb_embed4_bmi2(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    size_t i = 0;
+
+    for(; i + 4 <= n; i += 4)
+    {
+        uint32_t word;
+        uint64_t carrier;
+        memcpy(&word, data + i, 4);
+        memcpy(&carrier, src + 2 * i, 8);
+        carrier = (carrier & 0xF0F0F0F0F0F0F0F0ULL) | _pdep_u64(lsb_swap_nibbles(word), 0x0F0F0F0F0F0F0F0FULL);
+        memcpy(dest + 2 * i, &carrier, 8);
+    }
+    lsb_embed4_scalar(src + 2 * i, dest + 2 * i, data + i, n - i);
+}
+
+/* BMI2 4-bit extract kernel
+ * Description : pext gathers the low nibbles of 8 carrier bytes, the
+ * nibble swap gives 4 payload bytes.
+ */
+LSB_TARGET("bmi2")
+static void lsb_extract4_bmi2(const unsigned char *src, unsigned char *data, size_t n)
+{
+    size_t i = 0;
+
+    for(; i + 4 <= n; i += 4)
+    {
+        uint64_t carrier;
+        memcpy(&carrier, src + 2 * i, 8);
+        uint32_t word = lsb_swap_nibbles((uint32_t)_pext_u64(carrier, 0x0F0F0F0F0F0F0F0FULL));
+        memcpy(data + i, &word, 4);
+    }
+    lsb_extract4_scalar(src + 2 * i, data + i, n - i);
+}
+
+/* BMI2 2-bit embed kernel
+ * Description : pdep deposits the bit pairs of 2 payload bytes (order
+ * reversed, bits 7-6 first) into the low 2 bits of 8 carrier bytes.
+ */
+LSB_TARGET("bmi2")
+static void lsb_embed2_bmi2(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    size_t i = 0;
+
+    for(; i + 2 <= n; i += 2)
+    {
+        uint64_t carrier;
+        memcpy(&carrier, src + 4 * i, 8);
+        uint32_t pairs = lsb_reverse_pairs(data[i] | (uint32_t)data[i + 1] << 8);
+        carrier = (carrier & 0xFCFCFCFCFCFCFCFCULL) | _pdep_u64(pairs, 0x0303030303030303ULL);
+        memcpy(dest + 4 * i, &carrier, 8);
+    }
+    lsb_embed2_scalar(src + 4 * i, dest + 4 * i, data + i, n - i);
+}
+
+/* BMI2 2-bit extract kernel
+ * Description : pext gathers the low 2 bits of 8 carrier bytes,
+ * reversing the pairs gives 2 payload bytes.
+ */
+LSB_TARGET("bmi2")
+static void lsb_extract2_bmi2(const unsigned char *src, unsigned char *data, size_t n)
+{
+    size_t i = 0;
+
+    for(; i + 2 <= n; i += 2)
+    {
+        uint64_t carrier;
+        memcpy(&carrier, src + 4 * i, 8);
+        uint32_t word = lsb_reverse_pairs((uint32_t)_pext_u64(carrier, 0x0303030303030303ULL));
+        data[i] = (unsigned char)word;
+        data[i + 1] = (unsigned char)(word >> 8);
+    }
+    lsb_extract2_scalar(src + 4 * i, data + i, n - i);
+}
+#endif
+
+
+/* Kernel dispatch table, in order of preference */
+static const LsbKernel lsb_kernels[] =
+{
+#if defined(LSB_X86)
+    { "avx512", lsb_embed_avx512, lsb_extract_avx512, lsb_embed2_avx2,   lsb_extract2_avx2,   lsb_embed4_avx2,   lsb_extract4_avx2   },
+    { "avx2",   lsb_embed_avx2,   lsb_extract_avx2,   lsb_embed2_avx2,   lsb_extract2_avx2,   lsb_embed4_avx2,   lsb_extract4_avx2   },
+#if defined(__x86_64__)
+    { "bmi2",   lsb_embed_bmi2,   lsb_extract_bmi2,   lsb_embed2_bmi2,   lsb_extract2_bmi2,   lsb_embed4_bmi2,   lsb_extract4_bmi2   },
+#endif
+    { "sse2",   lsb_embed_sse2,   lsb_extract_sse2,   lsb_embed2_sse2,   lsb_extract2_sse2,   lsb_embed4_sse2,   lsb_extract4_sse2   },
+#endif
+    { "scalar", lsb_embed_scalar, lsb_extract_scalar, lsb_embed2_scalar, lsb_extract2_scalar, lsb_embed4_scalar, lsb_extract4_scalar },
+};
+
+#define LSB_KERNEL_COUNT (sizeof(lsb_kernels) / sizeof(lsb_kernels[0]))
+
+/* Active kernel, chosen on first use or by lsb_select_kernel() */
+static const LsbKernel *lsb_active = NULL;
+static pthread_once_t lsb_once = PTHREAD_ONCE_INIT;
+
+/* Check CPU support for a kernel
+ * Input  : Kernel table entry
+ * Output : 1 if the CPU (and OS) can run it, else 0
+ */
+static int lsb_kernel_supported(const LsbKernel *kernel)
+{
+#if defined(LSB_X86)
+    __builtin_cpu_init();
+    if(strcmp(kernel -> name, "avx512") == 0)
+        return __builtin_cpu_supports("avx512bw");
+    if(strcmp(kernel -> name, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+    if(strcmp(kernel -> name, "bmi2") == 0)
+        return __builtin_cpu_supports("bmi2");
+    if(strcmp(kernel -> name, "sse2") == 0)
+        return __builtin_cpu_supports("sse2");
+#endif
+    return strcmp(kernel -> name, "scalar") == 0;
+}
+
+/* Select kernel
+ * Input  : Kernel name, or NULL / "auto" for the best supported one
+ * Output : Makes the kernel active for lsb_embed() / lsb_extract()
+ * Return : e_success, or e_failure for an unknown or unsupported name
+ */
+Status lsb_select_kernel(const char *name)
+{
+    int automatic = (name == NULL || strcmp(name, "auto") == 0);
+
+    for(size_t i = 0; i < LSB_KERNEL_COUNT; i++)
+    {
+        if(automatic && lsb_kernel_supported(&lsb_kernels[i]))
+        {
+            lsb_active = &lsb_kernels[i];      // first supported is the widest
+            return e_success;
+        }
+        if(!automatic && strcmp(name, lsb_kernels[i].name) == 0)
+        {
+            if(!lsb_kernel_supported(&lsb_kernels[i]))
+            {
+                fprintf(stderr, "ERROR: LSB kernel %s is not supported on this CPU\n", name);
+                return e_failure;
+            }
+            lsb_active = &lsb_kernels[i];
+            return e_success;
+        }
+    }
+    fprintf(stderr, "ERROR: Unknown LSB kernel %s\n", automatic ? "auto" : name);
+    return e_failure;
+}
+
+/* Auto select (once)
+ * Output : Picks the best kernel unless one was selected explicitly
+ */
+static void lsb_auto_select(void)
+{
+    if(lsb_active == NULL)
+    {
+        lsb_select_kernel(NULL);
+    }
+}
+
+/* Get active kernel
+ * Output : Kernel table entry used by lsb_embed() / lsb_extract(),
+ *          thread safe (the first call picks the kernel exactly once)
+ */
+const LsbKernel *lsb_get_kernel(void)
+{
+    pthread_once(&lsb_once, lsb_auto_select);
+    return lsb_active;
+}
+
+/* Print kernels
+ * Output : Prints the active kernel and every kernel this CPU supports
+ */
+void lsb_print_kernels(void)
+{
+    printf("INFO: LSB kernel : %s\n", lsb_get_kernel() -> name);
+    printf("INFO: Supported  :");
+    for(size_t i = 0; i < LSB_KERNEL_COUNT; i++)
+    {
+        if(lsb_kernel_supported(&lsb_kernels[i]))
+        {
+            printf(" %s", lsb_kernels[i].name);
+        }
+    }
+    printf("\n");
+}
+
+/* List supported kernels
+ * Input  : Output array and its size
+ * Output : Kernels this CPU supports, widest first
+ * Return : Number of kernels stored
+ */
+size_t lsb_supported_kernels(const LsbKernel **kernels, size_t max)
+{
+    size_t count = 0;
+    for(size_t i = 0; i < LSB_KERNEL_COUNT && count < max; i++)
+    {
+        if(lsb_kernel_supported(&lsb_kernels[i]))
+        {
+            kernels[count++] = &lsb_kernels[i];
+        }
+    }
+    return count;
+}
+
+/* Embed payload bytes into carrier LSBs
+ * Input  : Source carrier bytes, destination, payload and payload size
+ * Output : 8 * n destination bytes, identical to calling
+ *          encode_byte_to_lsb() on each 8 byte group
+ */
+void lsb_embed(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n)
+{
+    lsb_get_kernel() -> embed(src, dest, data, n);
+}
+
+/* Extract payload bytes from carrier LSBs
+ * Input  : Carrier bytes, output buffer and payload size
+ * Output : n payload bytes, identical to calling decode_bytes_from_lsb()
+ *          on each 8 byte group
+ */
+void lsb_extract(const unsigned char *src, unsigned char *data, size_t n)
+{
+    lsb_get_kernel() -> extract(src, data, n);
+}
+
+/* Embed payload bytes at a bit depth
+ * Input  : Source carrier bytes, destination, payload, payload size and
+ *          bits per carrier byte (1, 2 or 4)
+ * Output : lsb_carrier_size(n, bits) destination bytes
+ */
+void lsb_embed_bits(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n, uint bits)
+{
+    const LsbKernel *kernel = lsb_get_kernel();
+
+    if(bits == 4)
+        kernel -> embed4(src, dest, data, n);
+    else if(bits == 2)
+        kernel -> embed2(src, dest, data, n);
+    else
+        kernel -> embed(src, dest, data, n);
+}
+
+/* Extract payload bytes at a bit depth
+ * Input  : Carrier bytes, output buffer, payload size and bits per
+ *          carrier byte (1, 2 or 4)
+ * Output : n payload bytes
+ */
+void lsb_extract_bits(const unsigned char *src, unsigned char *data, size_t n, uint bits)
+{
+    const LsbKernel *kernel = lsb_get_kernel();
+
+    if(bits == 4)
+        kernel -> extract4(src, data, n);
+    else if(bits == 2)
+        kernel -> extract2(src, data, n);
+    else
+        kernel -> extract(src, data, n);
+}
+
+/* Embed payload bytes and checksum them
+ * Input  : As lsb_embed_bits(), plus the running CRC32C of the payload
+ * Output : Carrier bytes as lsb_embed_bits(). Returns the CRC updated
+ *          over the n bytes, each chunk checksummed right after the
+ *          kernel read it, while it is still in L1
+ */
+uint32_t lsb_embed_bits_crc(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n, uint bits,
+                            uint32_t crc)
+{
+    for(size_t i = 0; i < n; i += LSB_CRC_CHUNK)
+    {
+        size_t count = n - i < LSB_CRC_CHUNK ? n - i : LSB_CRC_CHUNK;
+        size_t pos = lsb_carrier_size(i, bits);
+        lsb_embed_bits(src + pos, dest + pos, data + i, count, bits);
+        crc = crc32c_update(crc, data + i, count);
+    }
+    return crc;
+}
+
+/* Extract payload bytes and checksum them
+ * Input  : As lsb_extract_bits(), plus the running CRC32C of the payload
+ * Output : n payload bytes, returns the CRC updated over them
+ */
+uint32_t lsb_extract_bits_crc(const unsigned char *src, unsigned char *data, size_t n, uint bits, uint32_t crc)
+{
+    for(size_t i = 0; i < n; i += LSB_CRC_CHUNK)
+    {
+        size_t count = n - i < LSB_CRC_CHUNK ? n - i : LSB_CRC_CHUNK;
+        lsb_extract_bits(src + lsb_carrier_size(i, bits), data + i, count, bits);
+        crc = crc32c_update(crc, data + i, count);
+    }
+    return crc;
+}
+
+/* Carrier size
+ * Input  : Payload size and bits per carrier byte
+ * Output : Carrier bytes holding it
+ */
+uint64_t lsb_carrier_size(uint64_t n, uint bits)
+{
+    return n * 8 / bits;
+}
+
+/* Payload size
+ * Input  : Carrier size and bits per carrier byte
+ * Output : Whole payload bytes it holds (no overflow for any size)
+ */
+uint64_t lsb_payload_size(uint64_t len, uint bits)
+{
+    return len / 8 * bits + len % 8 * bits / 8;
+}
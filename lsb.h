@@ -0,0 +1,64 @@
+#ifndef LSB_H
+#define LSB_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+
+/*
+ * LSB kernels shared by encoding and decoding.
+ *
+ * Payload bytes are spread MSB first over 8 carrier bytes each, one bit
+ * in the LSB of every carrier byte (same layout as encode_byte_to_lsb()).
+ * At 2 or 4 bits per carrier byte (--bits) a payload byte takes 4 or 2
+ * carrier bytes, its bits again MSB first, in their low bits.
+ */
+
+
+/* One LSB kernel variant (scalar, sse2, avx2, bmi2 or avx512) */
+typedef struct _LsbKernel
+{
+    const char *name;
+    void (*embed)(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n);
+    void (*extract)(const unsigned char *src, unsigned char *data, size_t n);
+    void (*embed2)(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n);
+    void (*extract2)(const unsigned char *src, unsigned char *data, size_t n);
+    void (*embed4)(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n);
+    void (*extract4)(const unsigned char *src, unsigned char *data, size_t n);
+} LsbKernel;
+
+/* Embed n payload bytes into 8 * n carrier bytes, src and dest may be the same buffer */
+void lsb_embed(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n);
+
+/* Extract n payload bytes from the LSBs of 8 * n carrier bytes */
+void lsb_extract(const unsigned char *src, unsigned char *data, size_t n);
+
+/* Embed / extract at 1, 2 or 4 bits per carrier byte (8 / bits carrier bytes per payload byte) */
+void lsb_embed_bits(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n, uint bits);
+void lsb_extract_bits(const unsigned char *src, unsigned char *data, size_t n, uint bits);
+
+/* lsb_embed_bits() / lsb_extract_bits() fused with the CRC32C of the payload bytes,
+ * crc is the running value (0 to start), the updated one is returned */
+uint32_t lsb_embed_bits_crc(const unsigned char *src, unsigned char *dest, const unsigned char *data, size_t n, uint bits,
+                            uint32_t crc);
+uint32_t lsb_extract_bits_crc(const unsigned char *src, unsigned char *data, size_t n, uint bits, uint32_t crc);
+
+/* Carrier bytes holding n payload bytes at bits per carrier byte */
+uint64_t lsb_carrier_size(uint64_t n, uint bits);
+
+/* Payload bytes len carrier bytes hold at bits per carrier byte */
+uint64_t lsb_payload_size(uint64_t len, uint bits);
+
+/* Select the active kernel by name, NULL or "auto" picks the best one cpuid reports */
+Status lsb_select_kernel(const char *name);
+
+/* Active kernel (selected automatically on first use) */
+const LsbKernel *lsb_get_kernel(void);
+
+/* Store up to max kernels this CPU supports (widest first), returns how many */
+size_t lsb_supported_kernels(const LsbKernel **kernels, size_t max);
+
+/* Print the active kernel and the kernels this CPU supports */
+void lsb_print_kernels(void);
+
+#endif
@@ -0,0 +1,469 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : lz.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the payload compression used by --compress. The
+ * secrets are text (.txt / .c / .sh) and shrink several times, and every
+ * byte saved is 8 / bits carrier bytes neither read nor written.
+ *
+ * Compressor :
+ * ------------
+ * → Greedy LZ77 over one 64 KB block, a 4096 entry hash table of the
+ *   last position of every 4-byte sequence
+ * → Matches are extended forwards 8 bytes at a time and backwards over
+ *   pending literals
+ * → The search skips faster the longer it finds nothing, so data that
+ *   does not compress costs little and is stored as is
+ *
+ * Decoder :
+ * ---------
+ * Fed with pieces of any size (as the carrier is extracted), every field
+ * is bounds checked, so a corrupt stream is an error and never a write
+ * past a buffer.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "lz.h"
+
+/* Shortest match, bytes always left as literals at a block end, farthest offset */
+#define LZ_MIN_MATCH 4
+#define LZ_LAST_LITERALS 5
+#define LZ_MAX_OFFSET 65535
+
+/* Hash table size of the compressor (log2) */
+#define LZ_HASH_BITS 12
+
+/* Decoder stages */
+#define LZ_STAGE_STREAM 0
+#define LZ_STAGE_BLOCK 1
+#define LZ_STAGE_BODY 2
+
+static uint32_t lz_read32(const unsigned char *p)
+{
+    uint32_t value;
+    memcpy(&value, p, 4);
+    return value;
+}
+
+static uint64_t lz_read64(const unsigned char *p)
+{
+    uint64_t value;
+    memcpy(&value, p, 8);
+    return value;
+}
+
+/* Store / read integers MSB first */
+static void lz_put_u32(unsigned char *dest, uint32_t value)
+{
+    dest[0] = value >> 24;
+    dest[1] = value >> 16;
+    dest[2] = value >> 8;
+    dest[3] = value;
+}
+
+static uint32_t lz_get_u32(const unsigned char *src)
+{
+    return (uint32_t)src[0] << 24 | (uint32_t)src[1] << 16 | (uint32_t)src[2] << 8 | src[3];
+}
+
+static void lz_put_u64(unsigned char *dest, uint64_t value)
+{
+    lz_put_u32(dest, value >> 32);
+    lz_put_u32(dest + 4, value);
+}
+
+static uint64_t lz_get_u64(const unsigned char *src)
+{
+    return (uint64_t)lz_get_u32(src) << 32 | lz_get_u32(src + 4);
+}
+
+static uint32_t lz_hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Match length
+ * Input  : Block, earlier and current position, end of the match area
+ * Output : Bytes equal from both positions, 8 compared at a time
+ */
+static size_t lz_match_length(const unsigned char *src, size_t ref, size_t ip, size_t limit)
+{
+    size_t len = 0;
+
+    while(ip + len + 8 <= limit)
+    {
+        uint64_t diff = lz_read64(src + ref + len) ^ lz_read64(src + ip + len);
+        if(diff != 0)
+            return len + (__builtin_ctzll(diff) >> 3);
+        len += 8;
+    }
+    while(ip + len < limit && src[ref + len] == src[ip + len])
+        len++;
+    return len;
+}
+
+/* Write a length past its token nibble as 255 runs */
+static size_t lz_put_length(unsigned char *dest, size_t op, size_t len)
+{
+    for(; len >= 255; len -= 255)
+        dest[op++] = 255;
+    dest[op++] = len;
+    return op;
+}
+
+/* Write one sequence
+ * Input  : Output and its position, literals, offset and match length
+ *          (0 for the last sequence, literals only)
+ * Output : New output position
+ */
+static size_t lz_put_sequence(unsigned char *dest, size_t op, const unsigned char *literals, size_t lit_len,
+                              size_t offset, size_t match_len)
+{
+    size_t token = op++;
+
+    dest[token] = (lit_len < 15 ? lit_len : 15) << 4;
+    if(lit_len >= 15)
+        op = lz_put_length(dest, op, lit_len - 15);
+    memcpy(dest + op, literals, lit_len);
+    op += lit_len;
+    if(match_len == 0)
+        return op;
+
+    size_t len = match_len - LZ_MIN_MATCH;
+    dest[token] |= len < 15 ? len : 15;
+    dest[op++] = offset;
+    dest[op++] = offset >> 8;
+    if(len >= 15)
+        op = lz_put_length(dest, op, len - 15);
+    return op;
+}
+
+/* Compress block
+ * Input  : Raw bytes (n <= LZ_BLOCK_SIZE) and output of LZ_BLOCK_BOUND(n) bytes
+ * Output : Sequences, the last one literals only
+ * Return : Compressed size
+ */
+size_t lz_compress_block(const unsigned char *src, size_t n, unsigned char *dest)
+{
+    uint32_t table[1 << LZ_HASH_BITS];
+    size_t ip = 0, anchor = 0, op = 0;
+
+    memset(table, 0, sizeof(table));
+    if(n > LZ_MIN_MATCH + LZ_LAST_LITERALS)
+    {
+        size_t limit = n - LZ_LAST_LITERALS;
+        size_t misses = 0;
+
+        while(ip + LZ_MIN_MATCH <= limit)
+        {
+            uint32_t sequence = lz_read32(src + ip);
+            uint32_t *slot = &table[lz_hash(sequence)];
+            size_t ref = *slot;
+
+            *slot = ip;
+            if(ref >= ip || ip - ref > LZ_MAX_OFFSET || lz_read32(src + ref) != sequence)
+            {
+                ip += 1 + (misses++ >> 6);
+                continue;
+            }
+            misses = 0;
+
+            size_t len = LZ_MIN_MATCH + lz_match_length(src, ref + LZ_MIN_MATCH, ip + LZ_MIN_MATCH, limit);
+            while(ip > anchor && ref > 0 && src[ip - 1] == src[ref - 1])
+            {
+                ip--;
+                ref--;
+                len++;
+            }
+            op = lz_put_sequence(dest, op, src + anchor, ip - anchor, ip - ref, len);
+            ip += len;
+            anchor = ip;
+        }
+    }
+    return lz_put_sequence(dest, op, src + anchor, n - anchor, 0, 0);
+}
+
+/* Read a length continued as 255 runs
+ * Return : e_failure if the block ends inside it
+ */
+static Status lz_get_length(const unsigned char *src, size_t n, size_t *ip, size_t *len)
+{
+    unsigned char byte;
+
+    do
+    {
+        if(*ip >= n)
+            return e_failure;
+        byte = src[(*ip)++];
+        *len += byte;
+    } while(byte == 255);
+    return e_success;
+}
+
+/* Decompress block
+ * Input  : Compressed block, its size, output and the raw length
+ * Output : raw_len bytes
+ * Return : e_failure on any field out of range
+ */
+Status lz_decompress_block(const unsigned char *src, size_t n, unsigned char *dest, size_t raw_len)
+{
+    size_t ip = 0, op = 0;
+
+    while(ip < n)
+    {
+        unsigned token = src[ip++];
+        size_t lit_len = token >> 4;
+
+        if(lit_len == 15 && lz_get_length(src, n, &ip, &lit_len) != e_success)
+            return e_failure;
+        if(lit_len > n - ip || lit_len > raw_len - op)
+            return e_failure;
+        memcpy(dest + op, src + ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if(ip == n)
+            break;                      // last sequence
+
+        if(n - ip < 2)
+            return e_failure;
+        size_t offset = src[ip] | src[ip + 1] << 8;
+        size_t len = token & 15;
+        ip += 2;
+        if(len == 15 && lz_get_length(src, n, &ip, &len) != e_success)
+            return e_failure;
+        len += LZ_MIN_MATCH;
+        if(offset == 0 || offset > op || len > raw_len - op)
+            return e_failure;
+
+        if(offset >= len)
+        {
+            memcpy(dest + op, dest + op - offset, len);
+        }
+        else
+        {
+            for(size_t i = 0; i < len; i++)      // overlapping run
+                dest[op + i] = dest[op - offset + i];
+        }
+        op += len;
+    }
+    return op == raw_len ? e_success : e_failure;
+}
+
+/* Pack block
+ * Input  : Raw bytes and output of LZ_BLOCK_HEADER + LZ_BLOCK_BOUND(count) bytes
+ * Output : Block header and body, stored as is when it would not shrink
+ * Return : Block size
+ */
+static size_t lz_pack_block(const unsigned char *raw, size_t count, unsigned char *dest)
+{
+    size_t len = lz_compress_block(raw, count, dest + LZ_BLOCK_HEADER);
+    uint32_t stored = 0;
+
+    if(len >= count)
+    {
+        memcpy(dest + LZ_BLOCK_HEADER, raw, count);
+        len = count;
+        stored = LZ_STORED;
+    }
+    lz_put_u32(dest, count);
+    lz_put_u32(dest + 4, len | stored);
+    return LZ_BLOCK_HEADER + len;
+}
+
+/* Compress file
+ * Input  : Input file at its start, its size and the output file
+ * Output : Stream written to out, its size
+ * Return : e_failure on read / write / allocation failure
+ */
+Status lz_compress_file(FILE *in, uint64_t size, FILE *out, uint64_t *out_size)
+{
+    unsigned char *raw = malloc(LZ_BLOCK_SIZE);
+    unsigned char *packed = malloc(LZ_BLOCK_HEADER + LZ_BLOCK_BOUND(LZ_BLOCK_SIZE));
+    unsigned char header[LZ_STREAM_HEADER];
+    Status ret = e_failure;
+
+    lz_put_u64(header, size);
+    *out_size = LZ_STREAM_HEADER;
+    if(raw != NULL && packed != NULL && fwrite(header, 1, LZ_STREAM_HEADER, out) == LZ_STREAM_HEADER)
+    {
+        ret = e_success;
+        for(uint64_t remaining = size; ret == e_success && remaining > 0; )
+        {
+            size_t count = remaining < LZ_BLOCK_SIZE ? remaining : LZ_BLOCK_SIZE;
+
+            if(fread(raw, 1, count, in) != count)
+            {
+                ret = e_failure;
+                break;
+            }
+            size_t len = lz_pack_block(raw, count, packed);
+            if(fwrite(packed, 1, len, out) != len)
+                ret = e_failure;
+            *out_size += len;
+            remaining -= count;
+        }
+    }
+    free(raw);
+    free(packed);
+    return ret;
+}
+
+/* Stream bound
+ * Input  : Raw size
+ * Output : Largest stream lz_compress_buffer() writes for it
+ */
+uint64_t lz_stream_bound(uint64_t n)
+{
+    return LZ_STREAM_HEADER + n + n / 255 + (n / LZ_BLOCK_SIZE + 1) * (LZ_BLOCK_HEADER + 16);
+}
+
+/* Compress buffer
+ * Input  : Raw bytes and output of lz_stream_bound(n) bytes
+ * Output : Stream
+ * Return : Stream size
+ */
+size_t lz_compress_buffer(const unsigned char *src, size_t n, unsigned char *dest)
+{
+    size_t op = LZ_STREAM_HEADER;
+
+    lz_put_u64(dest, n);
+    for(size_t ip = 0; ip < n; ip += LZ_BLOCK_SIZE)
+    {
+        op += lz_pack_block(src + ip, n - ip < LZ_BLOCK_SIZE ? n - ip : LZ_BLOCK_SIZE, dest + op);
+    }
+    return op;
+}
+
+/* Read raw size
+ * Input  : Stream header and the stream size
+ * Output : Raw size the stream decodes to
+ * Return : e_failure if the stream is too short, or too small to ever
+ *          decode to that size (callers size their output from it)
+ */
+Status lz_read_raw_size(const unsigned char *header, uint64_t stream_size, uint64_t *raw_size)
+{
+    if(stream_size < LZ_STREAM_HEADER)
+        return e_failure;
+    *raw_size = lz_get_u64(header);
+    return *raw_size / LZ_MAX_RATIO <= stream_size ? e_success : e_failure;
+}
+
+/* Init stream decoder
+ * Input  : Decoder, sink and its context
+ * Output : Decoder waiting for the stream header, block buffers allocated
+ */
+Status lz_stream_init(LzStream *lz, LzSink sink, void *ctx)
+{
+    memset(lz, 0, sizeof(*lz));
+    lz -> sink = sink;
+    lz -> ctx = ctx;
+    lz -> stage = LZ_STAGE_STREAM;
+    lz -> packed = malloc(LZ_BLOCK_BOUND(LZ_BLOCK_SIZE));
+    lz -> raw = malloc(LZ_BLOCK_SIZE);
+    if(lz -> packed == NULL || lz -> raw == NULL)
+    {
+        lz_stream_free(lz);
+        return e_failure;
+    }
+    return e_success;
+}
+
+/* Check a block header
+ * Output : e_failure unless the block fits the stream and its buffers
+ */
+static Status lz_check_block(const LzStream *lz)
+{
+    if(lz -> block_raw == 0 || lz -> block_raw > LZ_BLOCK_SIZE || lz -> block_raw > lz -> raw_size - lz -> raw_done)
+        return e_failure;
+    if(lz -> block_len == 0 || lz -> block_len > LZ_BLOCK_BOUND(LZ_BLOCK_SIZE))
+        return e_failure;
+    return !lz -> stored || lz -> block_len == lz -> block_raw ? e_success : e_failure;
+}
+
+/* Feed stream decoder
+ * Input  : Decoder and the next len bytes of the stream
+ * Output : Every block completed by them decoded and passed to the sink
+ *          (stored blocks pass straight through)
+ * Return : e_failure on a corrupt stream or a sink failure
+ */
+Status lz_stream_feed(LzStream *lz, const unsigned char *data, size_t len)
+{
+    while(len > 0)
+    {
+        if(lz -> stage != LZ_STAGE_BODY)
+        {
+            // Stream header or block header, 8 bytes either way
+            size_t count = sizeof(lz -> field) - lz -> field_len < len ? sizeof(lz -> field) - lz -> field_len : len;
+            memcpy(lz -> field + lz -> field_len, data, count);
+            lz -> field_len += count;
+            data += count;
+            len -= count;
+            if(lz -> field_len < sizeof(lz -> field))
+                break;
+            lz -> field_len = 0;
+
+            if(lz -> stage == LZ_STAGE_STREAM)
+            {
+                lz -> raw_size = lz_get_u64(lz -> field);
+                lz -> stage = LZ_STAGE_BLOCK;
+                continue;
+            }
+            lz -> block_raw = lz_get_u32(lz -> field);
+            lz -> block_len = lz_get_u32(lz -> field + 4) & ~LZ_STORED;
+            lz -> stored = (lz_get_u32(lz -> field + 4) & LZ_STORED) != 0;
+            if(lz_check_block(lz) != e_success)
+                return e_failure;
+            lz -> packed_len = 0;
+            lz -> stage = LZ_STAGE_BODY;
+            continue;
+        }
+
+        size_t count = lz -> block_len - lz -> packed_len < len ? lz -> block_len - lz -> packed_len : len;
+        if(lz -> stored)
+        {
+            if(lz -> sink(lz -> ctx, data, count) != e_success)
+                return e_failure;
+        }
+        else
+        {
+            memcpy(lz -> packed + lz -> packed_len, data, count);
+        }
+        lz -> packed_len += count;
+        data += count;
+        len -= count;
+        if(lz -> packed_len < lz -> block_len)
+            break;
+
+        if(!lz -> stored)
+        {
+            if(lz_decompress_block(lz -> packed, lz -> block_len, lz -> raw, lz -> block_raw) != e_success
+               || lz -> sink(lz -> ctx, lz -> raw, lz -> block_raw) != e_success)
+                return e_failure;
+        }
+        lz -> raw_done += lz -> block_raw;
+        lz -> stage = LZ_STAGE_BLOCK;
+    }
+    return e_success;
+}
+
+/* End stream decoder
+ * Return : e_success only if the stream ended on a block boundary with
+ *          every raw byte decoded
+ */
+Status lz_stream_end(const LzStream *lz)
+{
+    return lz -> stage == LZ_STAGE_BLOCK && lz -> field_len == 0 && lz -> raw_done == lz -> raw_size ? e_success : e_failure;
+}
+
+/* Free stream decoder buffers */
+void lz_stream_free(LzStream *lz)
+{
+    free(lz -> packed);
+    free(lz -> raw);
+    lz -> packed = lz -> raw = NULL;
+}
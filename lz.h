@@ -0,0 +1,92 @@
+#ifndef LZ_H
+#define LZ_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+
+/*
+ * Payload compression (--compress), a small LZ4-class codec.
+ *
+ * Stream layout, integers MSB first like the stego header:
+ *
+ *      raw size (64-bit) | block | block | ...
+ *      block : raw length (32-bit) | stored length (32-bit) | stored bytes
+ *
+ * Every block holds up to LZ_BLOCK_SIZE raw bytes and is compressed on
+ * its own (matches never reach into an earlier block), so the decoder
+ * needs one block of memory whatever the payload size. A block that
+ * does not shrink is stored as is, LZ_STORED set in its stored length.
+ *
+ * A compressed block is a run of sequences:
+ *
+ *      token (literals << 4 | match length - 4) | literals - 15 as 255 runs
+ *      | literals | match offset (16-bit, LSB first) | match length - 19 as 255 runs
+ *
+ * the last sequence of a block holds literals only.
+ */
+
+/* Raw bytes per block */
+#define LZ_BLOCK_SIZE (1 << 16)
+
+/* Stored length flag of a block kept uncompressed */
+#define LZ_STORED 0x80000000u
+
+/* Stream header (raw size) and block header sizes */
+#define LZ_STREAM_HEADER 8
+#define LZ_BLOCK_HEADER 8
+
+/* Largest compressed form of n raw bytes */
+#define LZ_BLOCK_BOUND(n) ((n) + (n) / 255 + 16)
+
+/* Highest raw / stream size ratio a valid stream can reach */
+#define LZ_MAX_RATIO 256
+
+/* Receives the decoded bytes of a stream, in order */
+typedef Status (*LzSink)(void *ctx, const unsigned char *data, size_t len);
+
+/* Streaming decoder state */
+typedef struct _LzStream
+{
+    LzSink sink;
+    void *ctx;
+    uint stage;                 // Reading the stream header, a block header or a block body
+    unsigned char field[8];     // Header bytes gathered so far
+    uint field_len;
+    uint64_t raw_size;          // From the stream header
+    uint64_t raw_done;          // Raw bytes passed to the sink
+    uint32_t block_raw;         // Current block : raw length
+    uint32_t block_len;         //                 stored length
+    uint stored;                //                 kept uncompressed
+    uint32_t packed_len;        // Stored bytes of the block gathered so far
+    unsigned char *packed;      // LZ_BLOCK_BOUND(LZ_BLOCK_SIZE) bytes
+    unsigned char *raw;         // LZ_BLOCK_SIZE bytes
+} LzStream;
+
+/* Compress one block of n <= LZ_BLOCK_SIZE bytes into dest (LZ_BLOCK_BOUND(n) bytes), returns its size */
+size_t lz_compress_block(const unsigned char *src, size_t n, unsigned char *dest);
+
+/* Decompress one block, e_failure unless it decodes to exactly raw_len bytes */
+Status lz_decompress_block(const unsigned char *src, size_t n, unsigned char *dest, size_t raw_len);
+
+/* Compress size bytes of a file into a stream written to out */
+Status lz_compress_file(FILE *in, uint64_t size, FILE *out, uint64_t *out_size);
+
+/* Largest stream lz_compress_buffer() writes for n raw bytes */
+uint64_t lz_stream_bound(uint64_t n);
+
+/* Compress a buffer into a stream (dest holds lz_stream_bound(n) bytes), returns its size */
+size_t lz_compress_buffer(const unsigned char *src, size_t n, unsigned char *dest);
+
+/* Raw size from the first LZ_STREAM_HEADER bytes of a stream of stream_size bytes,
+ * e_failure if no valid stream of that size can decode to it */
+Status lz_read_raw_size(const unsigned char *header, uint64_t stream_size, uint64_t *raw_size);
+
+/* Streaming decoder : feed the stream in pieces of any size, decoded bytes go to sink */
+Status lz_stream_init(LzStream *lz, LzSink sink, void *ctx);
+Status lz_stream_feed(LzStream *lz, const unsigned char *data, size_t len);
+Status lz_stream_end(const LzStream *lz);
+void lz_stream_free(LzStream *lz);
+
+#endif
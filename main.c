@@ -19,17 +19,176 @@
  *
  * 2) Decoding  (-d)
  *    Extracts the previously hidden secret data from an encoded stego BMP file.
+ *
+ * 3) Batch     (-b)
+ *    Runs every encode / decode job listed in a manifest file on a
+ *    work-stealing pool of threads (-j N workers, one per CPU by default).
+ *
+ * 4) Scan      (--scan DIR)
+ *    Reports every BMP image under a directory that holds hidden data,
+ *    reading only its headers (-j N workers, one per CPU by default).
+ *
+ * 5) Shard     (-e / -d --shard)
+ *    Splits one secret over several carrier images and reassembles it
+ *    from them in any order, one image per worker (-j N).
+ *
+ * "-" in place of the source / stego image, the secret file or the output
+ * streams it through standard input / output in one forward pass, for use
+ * inside shell pipelines (a secret can also come from /dev/fd/N).
+ *
+ * Options (accepted anywhere on the command line) :
+ *    --mmap            Encode / decode through memory mapped files instead of stdio
+ *    --in-place        Encode into the source image itself (journaled, no output file)
+ *    --alpha           Also hide data in the alpha byte of 32 bpp images
+ *                      (give it when decoding such an image too)
+ *    --bits=N          Hide N (1, 2 or 4) secret bits per pixel byte, N times
+ *                      the capacity; decoding reads N from the stego header
+ *    --compress        Compress the secret before hiding it; decoding sees the
+ *                      header flag and decompresses on the fly
+ *    --verify          Decode without writing the output, only checking the
+ *                      header and payload checksums (-d)
+ *    --uring           Stream the payload stage through io_uring, reads, LSB
+ *                      work and writes overlapping (reader / writer threads if
+ *                      unavailable)
+ *    --block-size=N    Payload bytes per block of the streaming payload stage
+ *                      (4K to 1M, a multiple of 8, K / M suffix; 64K default)
+ *    -j N              Encode / decode on N threads (encoding uses the memory mapped path)
+ *    --kernel=NAME     Pin the LSB kernel (auto, avx512, avx2, bmi2, sse2, scalar)
+ *    --print-kernel    Print the LSB kernel in use, the supported ones and the
+ *                      CRC32C implementation
+ *    --quiet           No INFO: progress lines (ERROR: lines still go to stderr)
+ *    --stats=json      Print per-stage times, I/O counters and the kernel used
+ *                      as one line of JSON on stderr (-e / -d)
+ *    --serve PATH      Run as a daemon on Unix socket PATH (-j N workers)
+ *    --client PATH     Send the -e / -d job to the daemon on PATH
+ *    --scan DIR        Scan DIR for stego images (-j N workers)
+ *    --shard           Split the secret over several carriers (-e), or
+ *                      reassemble it from their stego images (-d)
  */
 
 
+#include <errno.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include "batch.h"
+#include "common.h"
+#include "crc32c.h"
 #include "encode.h"
 #include "decode.h"
+#include "lsb.h"
+#include "scan.h"
+#include "serve.h"
+#include "shard.h"
+#include "stats.h"
+#include "stego.h"
+#include "stream.h"
 #include "types.h"
+#include "uring.h"
+
+/* Command-line options, stripped from argv before argument validation */
+typedef struct _Options
+{
+    uint use_mmap;      // --mmap
+    uint in_place;      // --in-place
+    uint use_alpha;     // --alpha
+    uint bits;          // --bits=N (1, 2 or 4)
+    uint compress;      // --compress
+    uint verify;        // --verify
+    uint uring;         // --uring
+    uint block_size;    // --block-size=N[K|M]
+    uint threads;       // -j N
+    const char *kernel; // --kernel=NAME
+    uint print_kernel;  // --print-kernel
+    const char *serve;  // --serve PATH
+    const char *client; // --client PATH
+    const char *scan;   // --scan DIR
+    uint shard;         // --shard
+    uint quiet;         // --quiet
+    uint stats;         // --stats=json
+} Options;
+
+static int strip_options(int argc, char *argv[], Options *opts);
+static Uring *open_ring(Uring *ring, uint block_size);
 
 int main(int argc, char* argv[])
 {
+    Options opts = {0};
+    argc = strip_options(argc, argv, &opts);
+    quiet_mode = opts.quiet;
+    uint flags = STEGO_FLAG_BITS(opts.bits) | (opts.compress ? STEGO_FLAG_COMPRESSED : 0);
+
+    /* Pick the LSB kernel once, before any encoding or decoding */
+    if(lsb_select_kernel(opts.kernel) != e_success)
+    {
+        return e_failure;
+    }
+    if(opts.print_kernel)
+    {
+        lsb_print_kernels();
+        printf("INFO: CRC32C     : %s\n", crc32c_impl());
+        if(argc == 1)
+        {
+            return e_success;     // diagnostic only
+        }
+    }
+
+    /* Daemon mode, runs until SIGINT / SIGTERM */
+    if(opts.serve != NULL)
+    {
+        if(argc == 1 && run_server(opts.serve, opts.threads) == e_success)
+        {
+            return e_success;
+        }
+        printf("Usage : %s --serve < Socket path > [-j N]\n", argv[0]);
+        return e_failure;
+    }
+
+    /* Scan mode, headers only, no output files */
+    if(opts.scan != NULL)
+    {
+        if(argc == 1 && run_scan(opts.scan, opts.threads) == e_success)
+        {
+            return e_success;
+        }
+        printf("Usage : %s --scan < Directory > [-j N]\n", argv[0]);
+        return e_failure;
+    }
+
+    /* Shard mode, one secret over several carriers */
+    if(opts.shard)
+    {
+        OperationType type = argc > 1 ? check_operation_type(argv) : e_unsupported;
+        if(type == e_encode && argc >= 5 && !opts.compress)
+        {
+            if(run_shard_encode(argv[2], argv[3], argv + 4, argc - 4, opts.threads, opts.use_alpha, flags) == e_success)
+            {
+                PRINT_INFO("INFO: ## Encoding Done Succesfully ##\n");
+                return e_success;
+            }
+            printf("INFO: ## Encoding Failed ##\n");
+            return e_failure;
+        }
+        if(type == e_decode && argc >= 4)
+        {
+            if(run_shard_decode(argv[2], argv + 3, argc - 3, opts.threads, opts.use_alpha) == e_success)
+            {
+                PRINT_INFO("INFO: ## Decoding Done Successfully ##\n");
+                return e_success;
+            }
+            printf("INFO: ## Decoding failed ##\n");
+            return e_failure;
+        }
+        if(opts.compress)
+        {
+            printf("INFO: ## Error: --compress can not be combined with --shard ##\n");
+        }
+        printf("Usage : %s -e --shard [-j N] [--alpha] [--bits=1|2|4] < Secret_message file > < Output prefix > < Carrier.bmp >...\n", argv[0]);
+        printf("        %s -d --shard [-j N] [--alpha] < Output file > < Shard.bmp >...\n", argv[0]);
+        return e_failure;
+    }
+
     /* Check for basic argument count and unsupported operations */
     if(argc < 3 || argc > 5 || check_operation_type(argv) == e_unsupported) 
     {
@@ -37,20 +196,100 @@ int main(int argc, char* argv[])
         printf("Usage : \n");
         printf("\tEncode : %s -e < Source.bmp file > < Secret_message file > < Output file (optional) >\n", argv[0]);
         printf("\tDecode : %s -d < Encoded.bmp file > < Output file (optional) >\n", argv[0]);
+        printf("\tStream : %s -e - < Secret_message file > - < in.bmp > out.bmp, %s -d - - < in.bmp (\"-\" : stdin / stdout)\n", argv[0], argv[0]);
+        printf("\tBatch  : %s -b < Manifest file > [-j N] [--mmap | --uring] [--block-size=N]\n", argv[0]);
+        printf("\tDaemon : %s --serve < Socket path > [-j N]\n", argv[0]);
+        printf("\tScan   : %s --scan < Directory > [-j N]\n", argv[0]);
+        printf("\tShard  : %s -e --shard < Secret_message file > < Output prefix > < Carrier.bmp >..., %s -d --shard < Output file > < Shard.bmp >...\n", argv[0], argv[0]);
+        return e_failure; 
+    }
+
+    /* Thin client, the daemon does the encoding / decoding */
+    else if(opts.client != NULL)
+    {
+        OperationType type = check_operation_type(argv);
+        EncodeInfo encInfo = {0};
+        DecodeInfo decInfo = {0};
+        encInfo.flags = flags;
+        encInfo.use_alpha = opts.use_alpha;
+
+        /* Usage only for argument errors, a failed request already printed its reason */
+        if(!((type == e_encode && argc >= 4 && read_and_validate_encode_args(argv, &encInfo) == e_success)
+             || (type == e_decode && argc >= 3 && read_and_validate_decode_args(argv, &decInfo) == e_success)))
+        {
+            printf("INFO: ## ERROR: Invalid Client Arguments ##\n");
+            printf("Usage : %s --client < Socket path > -e|-d < arguments as above >\n", argv[0]);
+            return e_failure;
+        }
+        if(run_client(opts.client, type, &encInfo, &decInfo) == e_success)
+        {
+            return e_success;
+        }
+        printf("INFO: ## Request Failed ##\n");
         return e_failure; 
     }
 
+    /* Batch Operation */
+    else if(check_operation_type(argv) == e_batch)
+    {
+        // Manifest lines name their own output, and the stats counters are per process
+        if(opts.in_place || opts.stats)
+        {
+            printf("INFO: ## Error: --in-place and --stats=json can not be combined with -b ##\n");
+            printf("Usage : %s -b < Manifest file > [-j N] [--mmap | --uring] [--block-size=N] [--alpha] [--bits=1|2|4] [--compress] [--verify]\n", argv[0]);
+            return e_failure;
+        }
+        if(argc == 3 && run_batch(argv[2], opts.threads, opts.use_mmap, opts.uring, opts.block_size, flags,
+                                  opts.use_alpha, opts.verify) == e_success)
+        {
+            return e_success;
+        }
+        printf("INFO: ## Batch Failed ##\n");
+        return e_failure;
+    }
+
     /* Encoding Operation */
     else if(check_operation_type(argv) == e_encode) // checking operation type
     {
-        EncodeInfo encInfo; // Sturcture variable for encoding
+        EncodeInfo encInfo = {0}; // Sturcture variable for encoding
+        encInfo.use_mmap = opts.use_mmap || opts.threads > 1;   // threads share the mapped images
+        encInfo.in_place = opts.in_place;
+        encInfo.use_alpha = opts.use_alpha;
+        encInfo.flags = flags;
+        encInfo.threads = opts.threads;
+        encInfo.block_size = opts.block_size;
+
+        /* Stego image to standard output : claim it before anything is printed */
+        if(argc == 5 && stream_is_std(argv[4]) && stream_stdout() == NULL)
+        {
+            return e_failure;
+        }
 
         /* Validate argument count and encoding arguments */
         if((argc == 4 || argc == 5) && read_and_validate_encode_args(argv, &encInfo) == e_success) // validating arguments
         {
-            if(do_encoding(&encInfo) == e_success)
+            Status ret;
+            Uring ring;
+            if(opts.uring && !encInfo.stream && !encInfo.in_place && !encInfo.use_mmap)
+                encInfo.ring = open_ring(&ring, opts.block_size);
+            const char *path = encInfo.stream ? "stream" : encInfo.in_place ? "in-place" : encInfo.use_mmap ? "mmap" : encInfo.ring ? "uring" : "stdio";
+            if(opts.stats)
+                stats_begin();
+            if(encInfo.stream)
+                ret = do_encoding_stream(&encInfo);
+            else if(encInfo.in_place)
+                ret = do_encoding_in_place(&encInfo);
+            else if(encInfo.use_mmap)
+                ret = do_encoding_mmap(&encInfo);
+            else
+                ret = do_encoding(&encInfo);
+            if(opts.stats)
+                stats_report(stderr, "encode", path, ret);
+            if(encInfo.ring != NULL)
+                uring_free(encInfo.ring);
+            if(ret == e_success)
             {
-                printf("INFO: ## Encoding Done Succesfully ##\n");
+                PRINT_INFO("INFO: ## Encoding Done Succesfully ##\n");
                 return e_success;
             }
             else
@@ -62,7 +301,8 @@ int main(int argc, char* argv[])
         else
         {
             printf("INFO: ## ERROR: Invalid Encode Arguments ##\n");
-            printf("Usage: %s -e <src.bmp> <secret_file> <output(optional)>\n", argv[0]);
+            printf("Usage: %s -e [--mmap | --uring] [--block-size=N] [-j N] [--alpha] [--bits=1|2|4] [--compress] <src.bmp> <secret_file> <output(optional)>\n", argv[0]);
+            printf("       %s -e --in-place [--bits=1|2|4] [--compress] <src.bmp> <secret_file>\n", argv[0]);
             return e_failure;
         }
     }
@@ -70,14 +310,40 @@ int main(int argc, char* argv[])
     /* Decoding Operation */
     else if(check_operation_type(argv) == e_decode)
     {
-        DecodeInfo decInfo; // Strucuture variable for decoding
+        DecodeInfo decInfo = {0}; // Strucuture variable for decoding
+        decInfo.use_mmap = opts.use_mmap;
+        decInfo.use_alpha = opts.use_alpha;
+        decInfo.threads = opts.threads;
+        decInfo.verify = opts.verify;
+        decInfo.block_size = opts.block_size;
+
+        /* Secret to standard output : claim it before anything is printed */
+        if(argc == 4 && stream_is_std(argv[3]) && stream_stdout() == NULL)
+        {
+            return e_failure;
+        }
 
         /* Validate argument count and decoding arguments */
         if((argc == 3 || argc == 4) && read_and_validate_decode_args(argv, &decInfo) == e_success)
         {
-            if(do_decoding(&decInfo) == e_success)
+            Uring ring;
+            if(opts.uring && !decInfo.stream && !decInfo.use_mmap)
+                decInfo.ring = open_ring(&ring, opts.block_size);
+            if(opts.stats)
+                stats_begin();
+            Status ret = decInfo.stream ? do_decoding_stream(&decInfo) : decInfo.use_mmap ? do_decoding_mmap(&decInfo) : do_decoding(&decInfo);
+            if(opts.stats)
+                stats_report(stderr, "decode", decInfo.stream ? "stream" : decInfo.use_mmap ? "mmap" : decInfo.ring ? "uring" : "stdio", ret);
+            if(decInfo.ring != NULL)
+                uring_free(decInfo.ring);
+            if(ret == e_success && decInfo.verify)
             {
-                printf("INFO: ## Decoding Done Successfully ##\n");
+                PRINT_INFO("INFO: ## Verified : header and payload checksums match ##\n");
+                return e_success;
+            }
+            else if(ret == e_success)
+            {
+                PRINT_INFO("INFO: ## Decoding Done Successfully ##\n");
                 return e_success;
             }
             else
@@ -89,7 +355,7 @@ int main(int argc, char* argv[])
         else
         {
             printf("INFO: ## ERROR: Invalid Decode Arguments ##\n");
-            printf("Usage: %s -d <Encoded.bmp> <Output(optional)>\n", argv[0]);
+            printf("Usage: %s -d [--mmap | --uring] [--block-size=N] [-j N] [--alpha] [--verify] <Encoded.bmp> <Output(optional)>\n", argv[0]);
             return e_failure;
         }
     }
@@ -98,8 +364,9 @@ int main(int argc, char* argv[])
 
 /* Check operation type
  * Input  : Command-line arguments
- * Output : Returns e_encode, e_decode or e_unsupported
- * Description : Checks if user requested encoding (-e) or decoding (-d)
+ * Output : Returns e_encode, e_decode, e_batch or e_unsupported
+ * Description : Checks if user requested encoding (-e), decoding (-d)
+ * or a batch of them (-b)
  */
 OperationType check_operation_type(char *argv[])
 {
@@ -111,8 +378,148 @@ OperationType check_operation_type(char *argv[])
     {
         return e_decode;          // Decoding operation 
     }
+    else if(strcmp(argv[1], "-b") == 0)
+    {
+        return e_batch;           // Batch of operations from a manifest
+    }
     else
     {
         return e_unsupported;      // Invalid argument
     }
-}
\ No newline at end of file
+}
+
+/* Open io_uring
+ * Input  : Ring to set up, --block-size (0 : default)
+ * Output : The ring, or NULL (with a note) where io_uring is not
+ *          available, the job then runs on the threaded pipeline
+ */
+static Uring *open_ring(Uring *ring, uint block_size)
+{
+    if(uring_init(ring, block_size != 0 ? block_size : PIPE_BLOCK_SIZE) == e_success)
+    {
+        return ring;
+    }
+    PRINT_INFO("INFO: io_uring is not available, using the threaded pipeline\n");
+    return NULL;
+}
+
+/* Strip options from command line
+ * Input  : argc, argv and Options structure
+ * Output : Recognised "--" options are stored in opts and removed from
+ *          argv, so the positional arguments keep their usual indexes
+ * Return : New argument count (an unknown option or a bad -j value
+ *          makes it 0, which is reported as unsupported)
+ */
+static int strip_options(int argc, char *argv[], Options *opts)
+{
+    int count = 1;     // program name stays
+
+    for(int i = 1; i < argc; i++)
+    {
+        if(strcmp(argv[i], "-j") == 0)
+        {
+            char *end = NULL;
+            unsigned long threads = 0;
+            if(i + 1 < argc)
+            {
+                errno = 0;
+                threads = strtoul(argv[i + 1], &end, 10);
+            }
+            if(i + 1 >= argc || end == argv[i + 1] || *end != '\0' || errno == ERANGE
+               || argv[i + 1][0] == '-' || threads == 0 || threads > UINT_MAX)
+            {
+                printf("## ERROR : -j needs a positive number of threads, got %s ##\n", i + 1 < argc ? argv[i + 1] : "nothing");
+                return 0;
+            }
+            opts -> threads = threads;
+            i++;
+        }
+        else if(strncmp(argv[i], "--", 2) != 0)
+        {
+            argv[count++] = argv[i];     // positional argument
+        }
+        else if(strcmp(argv[i], "--mmap") == 0)
+        {
+            opts -> use_mmap = 1;
+        }
+        else if(strcmp(argv[i], "--in-place") == 0)
+        {
+            opts -> in_place = 1;
+        }
+        else if(strcmp(argv[i], "--alpha") == 0)
+        {
+            opts -> use_alpha = 1;
+        }
+        else if(strcmp(argv[i], "--bits=1") == 0 || strcmp(argv[i], "--bits=2") == 0 || strcmp(argv[i], "--bits=4") == 0)
+        {
+            opts -> bits = argv[i][7] - '0';
+        }
+        else if(strcmp(argv[i], "--compress") == 0)
+        {
+            opts -> compress = 1;
+        }
+        else if(strcmp(argv[i], "--uring") == 0)
+        {
+            opts -> uring = 1;
+        }
+        else if(strncmp(argv[i], "--block-size=", 13) == 0 && pipe_parse_block_size(argv[i] + 13) != 0)
+        {
+            opts -> block_size = pipe_parse_block_size(argv[i] + 13);
+        }
+        else if(strcmp(argv[i], "--verify") == 0)
+        {
+            opts -> verify = 1;
+        }
+        else if(strncmp(argv[i], "--kernel=", 9) == 0)
+        {
+            opts -> kernel = argv[i] + 9;
+        }
+        else if(strcmp(argv[i], "--print-kernel") == 0)
+        {
+            opts -> print_kernel = 1;
+        }
+        else if(strcmp(argv[i], "--quiet") == 0)
+        {
+            opts -> quiet = 1;
+        }
+        else if(strcmp(argv[i], "--stats=json") == 0)
+        {
+            opts -> stats = 1;
+        }
+        else if(strncmp(argv[i], "--serve=", 8) == 0)
+        {
+            opts -> serve = argv[i] + 8;
+        }
+        else if(strcmp(argv[i], "--serve") == 0 && i + 1 < argc)
+        {
+            opts -> serve = argv[++i];
+        }
+        else if(strncmp(argv[i], "--client=", 9) == 0)
+        {
+            opts -> client = argv[i] + 9;
+        }
+        else if(strcmp(argv[i], "--client") == 0 && i + 1 < argc)
+        {
+            opts -> client = argv[++i];
+        }
+        else if(strncmp(argv[i], "--scan=", 7) == 0)
+        {
+            opts -> scan = argv[i] + 7;
+        }
+        else if(strcmp(argv[i], "--scan") == 0 && i + 1 < argc)
+        {
+            opts -> scan = argv[++i];
+        }
+        else if(strcmp(argv[i], "--shard") == 0)
+        {
+            opts -> shard = 1;
+        }
+        else
+        {
+            printf("## ERROR : Unknown option %s ##\n", argv[i]);
+            return 0;
+        }
+    }
+    argv[count] = NULL;
+    return count;
+}
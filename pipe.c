@@ -0,0 +1,332 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : pipe.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the threaded block pipeline of the streaming
+ * payload stages, so one long job keeps the disk busy while the LSB
+ * kernels run instead of alternating with them:
+ *
+ *      reader thread ──filled──▶ transform (caller) ──done──▶ writer thread
+ *            ▲                                                     │
+ *            └─────────────────────────free────────────────────────┘
+ *
+ * Each arrow is a bounded lock-free SPSC ring of slot indexes (one
+ * producer, one consumer, so a release store of the tail / head is the
+ * only synchronisation). A stage that finds its ring empty / full spins
+ * PIPE_SPIN times, then parks on a futex of the index it waits for; the
+ * other side only makes the wake syscall when a waiter flag is set, so
+ * a stage blocked on the disk costs no CPU and a busy ring no syscalls.
+ * Every stage handles every block in order; after a failure the later
+ * blocks are passed along without any I/O, so no stage is left waiting.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "pipe.h"
+#include "stats.h"
+
+/* Polls of an empty / full ring before the stage parks on the futex */
+#define PIPE_SPIN 1024
+
+/* Bounded SPSC ring of slot indexes, head and tail on their own cache lines
+ * next to the waiter flag their owner sets */
+typedef struct _PipeQueue
+{
+    unsigned head __attribute__((aligned(64)));   // Next index to pop, written by the consumer
+    unsigned tail_waiter;                         // Consumer parked on tail (ring empty)
+    unsigned tail __attribute__((aligned(64)));   // Next index to push, written by the producer
+    unsigned head_waiter;                         // Producer parked on head (ring full)
+    uint items[PIPE_SLOTS] __attribute__((aligned(64)));
+} PipeQueue;
+
+/* Shared state of one pass */
+typedef struct _PipeState
+{
+    const PipeJob *job;
+    unsigned char *buffers;       // PIPE_SLOTS carrier buffers
+    PipeIo io[PIPE_SLOTS][PIPE_MAX_OPS];
+    uint count[PIPE_SLOTS];       // Requests filled for the slot's current stage
+    PipeQueue free, filled, done;
+    int failed;                   // Set by the first failing stage, read by all
+    double read_sec, write_sec;   // Busy time of the reader / writer
+} PipeState;
+
+/* Sleep while *word is still value / wake the thread sleeping on word */
+static void pipe_futex_wait(unsigned *word, unsigned value)
+{
+    syscall(__NR_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+}
+
+static void pipe_futex_wake(unsigned *word)
+{
+    syscall(__NR_futex, word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+/* Wait for an index
+ * Input  : Index word of the other side, the value it must move away
+ *          from and the waiter flag that side checks after each store
+ * Output : Returns once *word != value; spins PIPE_SPIN polls, then
+ *          raises the flag and sleeps on the futex. The flag store and
+ *          the re-read of word, like the other side's index store and
+ *          read of the flag, are sequentially consistent, so either the
+ *          wait sees the new index or the other side sees the flag
+ */
+static void pipe_wait(unsigned *word, unsigned value, unsigned *waiter)
+{
+    for(uint spin = 0; spin < PIPE_SPIN; spin++)
+    {
+        if(__atomic_load_n(word, __ATOMIC_ACQUIRE) != value)
+            return;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#endif
+    }
+    for(;;)
+    {
+        __atomic_store_n(waiter, 1, __ATOMIC_SEQ_CST);
+        if(__atomic_load_n(word, __ATOMIC_SEQ_CST) != value)
+            break;
+        pipe_futex_wait(word, value);
+        if(__atomic_load_n(word, __ATOMIC_ACQUIRE) != value)
+            break;
+    }
+    __atomic_store_n(waiter, 0, __ATOMIC_RELAXED);
+}
+
+/* Publish an index, waking the other side if it parked on it */
+static void pipe_publish(unsigned *word, unsigned value, unsigned *waiter)
+{
+    __atomic_store_n(word, value, __ATOMIC_SEQ_CST);
+    if(__atomic_load_n(waiter, __ATOMIC_SEQ_CST))
+        pipe_futex_wake(word);
+}
+
+/* Push a slot (producer side), waits while the ring is full */
+static void pipe_push(PipeQueue *queue, uint slot)
+{
+    unsigned tail = queue -> tail;
+
+    if(tail - __atomic_load_n(&queue -> head, __ATOMIC_ACQUIRE) == PIPE_SLOTS)
+        pipe_wait(&queue -> head, tail - PIPE_SLOTS, &queue -> head_waiter);
+    queue -> items[tail % PIPE_SLOTS] = slot;
+    pipe_publish(&queue -> tail, tail + 1, &queue -> tail_waiter);
+}
+
+/* Pop a slot (consumer side), waits while the ring is empty */
+static uint pipe_pop(PipeQueue *queue)
+{
+    unsigned head = queue -> head;
+
+    if(__atomic_load_n(&queue -> tail, __ATOMIC_ACQUIRE) == head)
+        pipe_wait(&queue -> tail, head, &queue -> tail_waiter);
+    uint slot = queue -> items[head % PIPE_SLOTS];
+    pipe_publish(&queue -> head, head + 1, &queue -> head_waiter);
+    return slot;
+}
+
+static int pipe_failed(PipeState *state)
+{
+    return __atomic_load_n(&state -> failed, __ATOMIC_ACQUIRE);
+}
+
+static void pipe_fail(PipeState *state)
+{
+    __atomic_store_n(&state -> failed, 1, __ATOMIC_RELEASE);
+}
+
+/* Transfer all of a request
+ * Input  : Request, and whether it is a write
+ * Return : e_success, or e_failure on an error / end of file
+ */
+static Status pipe_transfer(const PipeIo *io, int write)
+{
+    unsigned char *buf = io -> buf;
+    uint32_t len = io -> len;
+    off_t off = io -> off;
+
+    while(len > 0)
+    {
+        ssize_t count = write ? pwrite(io -> fd, buf, len, off) : pread(io -> fd, buf, len, off);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count <= 0)
+        {
+            fprintf(stderr, "ERROR: pipeline %s : %s\n", write ? "write" : "read",
+                    count < 0 ? strerror(errno) : "unexpected end of file");
+            return e_failure;
+        }
+        buf += count;
+        len -= count;
+        off += count;
+    }
+    return e_success;
+}
+
+/* Reader thread
+ * Input  : PipeState
+ * Output : Every block read into a free slot, in order, then passed on
+ */
+static void *pipe_reader(void *arg)
+{
+    PipeState *state = arg;
+    const PipeJob *job = state -> job;
+
+    for(uint64_t block = 0; block < job -> blocks; block++)
+    {
+        uint slot = pipe_pop(&state -> free);
+        double start = stats_now();
+
+        state -> count[slot] = 0;
+        if(!pipe_failed(state))
+        {
+            unsigned char *buffer = state -> buffers + slot * PIPE_BUFFER_SIZE(job -> block_size);
+            state -> count[slot] = job -> reads(job -> ctx, block, slot, buffer, state -> io[slot]);
+            for(uint i = 0; i < state -> count[slot]; i++)
+            {
+                if(pipe_transfer(&state -> io[slot][i], 0) != e_success)
+                {
+                    pipe_fail(state);
+                    break;
+                }
+            }
+        }
+        state -> read_sec += stats_now() - start;
+        pipe_push(&state -> filled, slot);
+    }
+    return NULL;
+}
+
+/* Writer thread
+ * Input  : PipeState
+ * Output : Writes of every transformed block, the slot then freed
+ */
+static void *pipe_writer(void *arg)
+{
+    PipeState *state = arg;
+
+    for(uint64_t block = 0; block < state -> job -> blocks; block++)
+    {
+        uint slot = pipe_pop(&state -> done);
+        double start = stats_now();
+
+        for(uint i = 0; i < state -> count[slot] && !pipe_failed(state); i++)
+        {
+            if(pipe_transfer(&state -> io[slot][i], 1) != e_success)
+                pipe_fail(state);
+        }
+        state -> write_sec += stats_now() - start;
+        pipe_push(&state -> free, slot);
+    }
+    return NULL;
+}
+
+/* Run pass
+ * Input  : Job
+ * Output : Every block read on the reader thread, transformed here in
+ *          block order and written on the writer thread, PIPE_SLOTS
+ *          blocks in flight; stage busy times go to the statistics
+ * Return : e_success, or e_failure after an I/O or transform error
+ */
+Status pipe_run(const PipeJob *job)
+{
+    PipeState *state = calloc(1, sizeof(PipeState));
+    pthread_t reader, writer;
+    double transform_sec = 0;
+
+    if(state == NULL || posix_memalign((void **)&state -> buffers, 4096, PIPE_SLOTS * PIPE_BUFFER_SIZE(job -> block_size)) != 0)
+    {
+        free(state);
+        return e_failure;
+    }
+    state -> job = job;
+    for(uint slot = 0; slot < PIPE_SLOTS; slot++)
+        pipe_push(&state -> free, slot);
+
+    if(pthread_create(&reader, NULL, pipe_reader, state) != 0)
+    {
+        free(state -> buffers);
+        free(state);
+        return e_failure;
+    }
+    if(pthread_create(&writer, NULL, pipe_writer, state) != 0)
+    {
+        // No writer : drain the reader, then give up
+        pipe_fail(state);
+        for(uint64_t block = 0; block < job -> blocks; block++)
+            pipe_push(&state -> free, pipe_pop(&state -> filled));
+        pthread_join(reader, NULL);
+        free(state -> buffers);
+        free(state);
+        return e_failure;
+    }
+
+    for(uint64_t block = 0; block < job -> blocks; block++)
+    {
+        uint slot = pipe_pop(&state -> filled);
+        double start = stats_now();
+        uint writes = 0;
+
+        if(!pipe_failed(state))
+        {
+            unsigned char *buffer = state -> buffers + slot * PIPE_BUFFER_SIZE(job -> block_size);
+            if(job -> transform(job -> ctx, block, slot, buffer, state -> io[slot], &writes) != e_success)
+            {
+                pipe_fail(state);
+                writes = 0;
+            }
+        }
+        state -> count[slot] = writes;
+        transform_sec += stats_now() - start;
+        pipe_push(&state -> done, slot);
+    }
+    pthread_join(reader, NULL);
+    pthread_join(writer, NULL);
+
+    Status ret = state -> failed ? e_failure : e_success;
+    stats_pipeline(state -> read_sec, transform_sec, state -> write_sec);
+    free(state -> buffers);
+    free(state);
+    return ret;
+}
+
+/* Parse block size
+ * Input  : Text of --block-size=, bytes with an optional K or M suffix
+ * Output : Block size, or 0 unless it is a multiple of 8 within
+ *          [PIPE_BLOCK_MIN, PIPE_BLOCK_MAX]
+ */
+uint pipe_parse_block_size(const char *text)
+{
+    char *end;
+    uint shift = 0;
+
+    errno = 0;
+    unsigned long size = strtoul(text, &end, 10);
+    if(end == text || errno == ERANGE)
+        return 0;
+    if(*end == 'K' || *end == 'k')
+    {
+        shift = 10;
+        end++;
+    }
+    else if(*end == 'M' || *end == 'm')
+    {
+        shift = 20;
+        end++;
+    }
+    if(*end != '\0' || size > (unsigned long)(PIPE_BLOCK_MAX >> shift))   // checked before shifting, so it cannot wrap
+        return 0;
+    size <<= shift;
+    if(size < PIPE_BLOCK_MIN || size % 8 != 0)
+        return 0;
+    return size;
+}
@@ -0,0 +1,69 @@
+#ifndef PIPE_H
+#define PIPE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "types.h"
+
+/*
+ * Block pipeline of the streaming payload stages.
+ *
+ * A pass over the payload is described once (PipeJob) and run by either
+ *
+ *      → pipe_run()  : a reader thread, the transform on the calling
+ *                      thread and a writer thread, connected by bounded
+ *                      lock-free single producer / single consumer rings
+ *                      of slot indexes
+ *      → uring_run() : io_uring (uring.h, --uring)
+ *
+ * Both keep up to PIPE_SLOTS blocks in flight; block k + n is read and
+ * block k - n written while block k is transformed, transforms run
+ * strictly in block order. Every slot owns one carrier buffer of
+ * 8 * block_size bytes.
+ */
+
+/* Default payload bytes per block (--block-size), and the accepted range (multiples of 8) */
+#define PIPE_BLOCK_SIZE (1 << 16)
+#define PIPE_BLOCK_MIN 4096
+#define PIPE_BLOCK_MAX (1 << 20)
+
+/* Blocks in flight (a power of 2) */
+#define PIPE_SLOTS 8
+
+/* Reads or writes of one block */
+#define PIPE_MAX_OPS 2
+
+/* Carrier buffer of a slot : the carrier bytes of one block at 1 bit per byte */
+#define PIPE_BUFFER_SIZE(block_size) ((size_t)(block_size) * 8)
+
+/* One read or write of a block */
+typedef struct _PipeIo
+{
+    int fd;
+    unsigned char *buf;
+    uint32_t len;
+    uint64_t off;
+    int fixed;                    // buf lies in the slot's carrier buffer (registered with io_uring)
+} PipeIo;
+
+/* One pass : blocks are read, transformed in order, then written */
+typedef struct _PipeJob
+{
+    uint64_t blocks;
+    uint block_size;              // Payload bytes per block
+    void *ctx;
+
+    /* Fill the reads of a block into its slot (buffer : the slot's carrier buffer), return their count */
+    uint (*reads)(void *ctx, uint64_t block, uint slot, unsigned char *buffer, PipeIo *io);
+
+    /* Transform a block once its reads are done and fill its writes, count in *writes */
+    Status (*transform)(void *ctx, uint64_t block, uint slot, unsigned char *buffer, PipeIo *io, uint *writes);
+} PipeJob;
+
+/* Run a pass on reader / transform / writer threads, e_failure on an I/O or transform error */
+Status pipe_run(const PipeJob *job);
+
+/* Block size from --block-size=N[K|M], 0 if invalid */
+uint pipe_parse_block_size(const char *text);
+
+#endif
@@ -0,0 +1,507 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : scan.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the stego scanner, which audits a directory tree
+ * for images holding hidden data without decoding any of them.
+ *
+ * Scheduling :
+ * ------------
+ * 1) Work items (a directory to list, or a batch of up to
+ *    SCAN_BATCH_FILES of its files) sit on one shared stack, taken
+ *    depth first so it stays short on deep trees
+ * 2) A worker listing a directory pushes its subdirectories and its
+ *    files in batches, so other workers start on them while it lists
+ * 3) Per file : one pread of SCAN_READ_SIZE bytes for the BMP header
+ *    and the stego header carrier bytes (a second small pread only when
+ *    bfOffBits is far into the file), then the header is parsed in
+ *    memory with stego_parse_header()
+ * 4) A report line is printed per hit, a summary at the end
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "bmp.h"
+#include "common.h"
+#include "lsb.h"
+#include "scan.h"
+#include "shard.h"
+
+/* Shared state of one scan */
+typedef struct _ScanPool
+{
+    pthread_mutex_t lock;
+    pthread_cond_t more;      // Items pushed, or the last busy worker is done
+    ScanItem *items;          // Stack of pending items
+    uint item_count;
+    uint item_cap;
+    uint busy;                // Workers holding an item
+} ScanPool;
+
+/* One worker thread, its counters and buffers */
+typedef struct _ScanWorker
+{
+    ScanPool *pool;
+    ScanCounts counts;
+    unsigned char head[SCAN_READ_SIZE];       // First bytes of the file
+    unsigned char carrier[SCAN_CARRIER_SIZE]; // Gathered stego header carrier bytes
+    unsigned char *far;                       // Pixel bytes past head, rarely needed
+    size_t far_cap;
+} ScanWorker;
+
+/* Push a work item
+ * Input  : Pool and item (the pool owns its strings from now on)
+ * Return : e_success, or e_failure (item freed) when out of memory
+ */
+static Status scan_push(ScanPool *pool, ScanItem item)
+{
+    Status ret = e_success;
+
+    pthread_mutex_lock(&pool -> lock);
+    if(pool -> item_count == pool -> item_cap)
+    {
+        uint cap = pool -> item_cap ? pool -> item_cap * 2 : 256;
+        ScanItem *grown = realloc(pool -> items, cap * sizeof(ScanItem));
+        if(grown == NULL)
+            ret = e_failure;
+        else
+        {
+            pool -> items = grown;
+            pool -> item_cap = cap;
+        }
+    }
+    if(ret == e_success)
+    {
+        pool -> items[pool -> item_count++] = item;
+        pthread_cond_signal(&pool -> more);
+    }
+    pthread_mutex_unlock(&pool -> lock);
+
+    if(ret != e_success)
+    {
+        free(item.dir);
+        free(item.names);
+    }
+    return ret;
+}
+
+/* Take a work item
+ * Input  : Pool
+ * Output : Next item; waits while the stack is empty but a busy worker
+ *          may still push more
+ * Return : 1 if an item was taken, 0 when the scan is complete
+ */
+static int scan_take(ScanPool *pool, ScanItem *item)
+{
+    int found = 0;
+
+    pthread_mutex_lock(&pool -> lock);
+    while(pool -> item_count == 0 && pool -> busy > 0)
+        pthread_cond_wait(&pool -> more, &pool -> lock);
+    if(pool -> item_count > 0)
+    {
+        *item = pool -> items[--pool -> item_count];
+        pool -> busy++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&pool -> lock);
+    return found;
+}
+
+/* Finish a work item
+ * Input  : Pool
+ * Output : Waiting workers woken up once nothing is left to do
+ */
+static void scan_done(ScanPool *pool)
+{
+    pthread_mutex_lock(&pool -> lock);
+    if(--pool -> busy == 0 && pool -> item_count == 0)
+        pthread_cond_broadcast(&pool -> more);
+    pthread_mutex_unlock(&pool -> lock);
+}
+
+/* Join path
+ * Input  : Directory ("" for none), name and a PATH_MAX buffer
+ * Return : e_success, or e_failure when the path is too long
+ */
+static Status scan_join(const char *dir, const char *name, char *path)
+{
+    int n = dir[0] == '\0' ? snprintf(path, PATH_MAX, "%s", name)
+                           : snprintf(path, PATH_MAX, "%s/%s", dir, name);
+    return n >= 0 && n < PATH_MAX ? e_success : e_failure;
+}
+
+/* List directory
+ * Input  : Pool, directory and the worker's counters
+ * Output : Subdirectories pushed as items to list, regular files pushed
+ *          in batches of SCAN_BATCH_FILES. Symbolic links are not
+ *          followed, so a tree is scanned once whatever links into it
+ */
+static void scan_list_dir(ScanPool *pool, const char *dir, ScanCounts *counts)
+{
+    DIR *dp = opendir(dir);
+    if(dp == NULL)
+    {
+        fprintf(stderr, "ERROR: Unable to open directory %s : %s\n", dir, strerror(errno));
+        counts -> errors++;
+        return;
+    }
+
+    char *names = NULL;
+    size_t used = 0, cap = 0;
+    uint count = 0;
+    struct dirent *entry;
+
+    while((entry = readdir(dp)) != NULL)
+    {
+        const char *name = entry -> d_name;
+        if(strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue;
+
+        unsigned char type = entry -> d_type;
+        if(type == DT_UNKNOWN)
+        {
+            // Filesystems without d_type : one fstatat, no path building
+            struct stat st;
+            if(fstatat(dirfd(dp), name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+            type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_UNKNOWN;
+        }
+
+        if(type == DT_DIR)
+        {
+            char path[PATH_MAX];
+            ScanItem item = { NULL, NULL, 0 };
+            if(scan_join(dir, name, path) != e_success || (item.dir = strdup(path)) == NULL
+               || scan_push(pool, item) != e_success)
+                counts -> errors++;
+        }
+        else if(type == DT_REG)
+        {
+            size_t len = strlen(name) + 1;
+            if(used + len > cap)
+            {
+                size_t grown_cap = cap ? cap * 2 : 64 * 32;
+                while(grown_cap < used + len)
+                    grown_cap *= 2;
+                char *grown = realloc(names, grown_cap);
+                if(grown == NULL)
+                {
+                    counts -> errors++;
+                    continue;
+                }
+                names = grown;
+                cap = grown_cap;
+            }
+            memcpy(names + used, name, len);
+            used += len;
+
+            if(++count == SCAN_BATCH_FILES)
+            {
+                ScanItem item = { strdup(dir), names, count };
+                if(item.dir == NULL || scan_push(pool, item) != e_success)
+                    counts -> errors += count;
+                names = NULL;
+                used = cap = 0;
+                count = 0;
+            }
+        }
+    }
+    closedir(dp);
+
+    if(count > 0)
+    {
+        ScanItem item = { strdup(dir), names, count };
+        if(item.dir == NULL || scan_push(pool, item) != e_success)
+            counts -> errors += count;
+    }
+    else
+        free(names);
+}
+
+/* Probe one layout
+ * Input  : Worker, open image, bytes read from its start and a layout
+ * Output : Parsed stego header and the payload size (decompressed), for
+ *          a shard its descriptor and slice size. Only the carrier bytes
+ *          of the stego header are looked at, read again only if they
+ *          lie past the first SCAN_READ_SIZE bytes
+ * Return : StegoStatus, or -1 on I/O error
+ */
+static int scan_probe(ScanWorker *worker, int fd, size_t head_len, const BmpLayout *layout,
+                      StegoHeader *header, size_t *data_len, ShardDesc *desc)
+{
+    uint64_t carrier_size = bmp_carrier_size(layout);
+    size_t len = carrier_size < SCAN_CARRIER_SIZE ? carrier_size : SCAN_CARRIER_SIZE;
+    uint64_t end = bmp_carrier_end(layout, len);
+    const unsigned char *pixels;
+
+    if(end <= head_len)
+        pixels = worker -> head + layout -> offset;
+    else
+    {
+        size_t span = end - layout -> offset;
+        if(span > worker -> far_cap)
+        {
+            unsigned char *grown = realloc(worker -> far, span);
+            if(grown == NULL)
+                return -1;
+            worker -> far = grown;
+            worker -> far_cap = span;
+        }
+        if(pread(fd, worker -> far, span, layout -> offset) != (ssize_t)span)
+            return -1;
+        worker -> counts.bytes += span;
+        pixels = worker -> far;
+    }
+    if(!layout -> contiguous)
+    {
+        bmp_gather(layout, pixels, 0, worker -> carrier, len);
+        pixels = worker -> carrier;
+    }
+
+    // Both calls touch the header (and a stream size) only, so the whole carrier size is passed
+    int status = stego_parse_header(pixels, carrier_size, header);
+    if(status == e_stego_ok)
+        status = stego_peek(pixels, carrier_size, data_len, header -> extn);
+    if(status == e_stego_shard && header -> payload_len < STEGO_SHARD_SIZE)
+        status = e_stego_corrupt;
+    if(status == e_stego_shard)
+    {
+        uint8_t field[STEGO_SHARD_SIZE];
+        lsb_extract_bits(pixels + header -> size * 8, field, sizeof(field), STEGO_BITS(header -> flags));
+        shard_get_desc(field, desc);
+        *data_len = header -> payload_len - STEGO_SHARD_SIZE;
+    }
+    return status;
+}
+
+/* Scan one file
+ * Input  : Worker, directory and file name
+ * Output : Counters updated, a report line printed for a hit
+ */
+static void scan_file(ScanWorker *worker, const char *dir, const char *name)
+{
+    ScanCounts *counts = &worker -> counts;
+    char path[PATH_MAX];
+    struct stat st;
+
+    if(scan_join(dir, name, path) != e_success)
+    {
+        counts -> errors++;
+        return;
+    }
+    int fd = open(path, O_RDONLY | O_NOFOLLOW | O_CLOEXEC);
+    if(fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    {
+        if(fd < 0 && errno != ELOOP)
+        {
+            fprintf(stderr, "ERROR: Unable to open file %s : %s\n", path, strerror(errno));
+            counts -> errors++;
+        }
+        if(fd >= 0)
+            close(fd);
+        return;
+    }
+    counts -> files++;
+
+    ssize_t head_len = pread(fd, worker -> head, SCAN_READ_SIZE, 0);
+    BmpLayout layout;
+    if(head_len < 0)
+    {
+        fprintf(stderr, "ERROR: Unable to read file %s : %s\n", path, strerror(errno));
+        counts -> errors++;
+        close(fd);
+        return;
+    }
+    counts -> bytes += head_len;
+    if(bmp_parse(worker -> head, head_len, st.st_size, 0, &layout) != e_success)
+    {
+        close(fd);              // not a supported BMP image
+        return;
+    }
+    counts -> images++;
+
+    StegoHeader header;
+    ShardDesc desc;
+    size_t data_len = 0;
+    uint alpha = 0;
+    int status = scan_probe(worker, fd, head_len, &layout, &header, &data_len, &desc);
+
+    // Same fallbacks as decoding : alpha carrying 32 bpp images, then version 1 images in the flat layout
+    if(status == e_stego_not_stego && layout.bpp == 32
+       && bmp_parse(worker -> head, head_len, st.st_size, 1, &layout) == e_success)
+    {
+        alpha = 1;
+        status = scan_probe(worker, fd, head_len, &layout, &header, &data_len, &desc);
+    }
+    if((status == e_stego_not_stego || (status == e_stego_ok && header.version == 1)) && !bmp_is_flat(&layout))
+    {
+        alpha = 0;
+        bmp_flat_layout(st.st_size, &layout);
+        status = scan_probe(worker, fd, head_len, &layout, &header, &data_len, &desc);
+    }
+    close(fd);
+
+    if(status == e_stego_ok)
+    {
+        counts -> hits++;
+        if(header.flags & STEGO_FLAG_COMPRESSED)
+            printf("SCAN: HIT size=%zu extn=%s version=%u bits=%u compressed=%llu%s path=%s\n", data_len, header.extn,
+                   header.version, STEGO_BITS(header.flags), (unsigned long long)header.payload_len,
+                   alpha ? " alpha" : "", path);
+        else
+            printf("SCAN: HIT size=%zu extn=%s version=%u bits=%u%s path=%s\n", data_len, header.extn,
+                   header.version, STEGO_BITS(header.flags), alpha ? " alpha" : "", path);
+    }
+    else if(status == e_stego_shard)
+    {
+        counts -> hits++;
+        printf("SCAN: HIT shard=%u/%u size=%zu total=%llu extn=%s version=%u bits=%u%s path=%s\n", desc.index, desc.count,
+               data_len, (unsigned long long)desc.total, header.extn, header.version, STEGO_BITS(header.flags),
+               alpha ? " alpha" : "", path);
+    }
+    else if(status == e_stego_version)
+    {
+        // Marker of a newer stego header : hidden data this build cannot read
+        counts -> hits++;
+        printf("SCAN: HIT unsupported version=%u path=%s\n", header.version, path);
+    }
+    else if(status < 0)
+    {
+        fprintf(stderr, "ERROR: Unable to read file %s\n", path);
+        counts -> errors++;
+    }
+}
+
+/* Worker thread
+ * Input  : ScanWorker
+ * Output : Lists directories and scans files until the scan is complete
+ */
+static void *scan_worker(void *arg)
+{
+    ScanWorker *worker = arg;
+    ScanPool *pool = worker -> pool;
+    ScanItem item;
+
+    while(scan_take(pool, &item))
+    {
+        if(item.names == NULL)
+            scan_list_dir(pool, item.dir, &worker -> counts);
+        else
+        {
+            const char *name = item.names;
+            for(uint i = 0; i < item.count; i++, name += strlen(name) + 1)
+                scan_file(worker, item.dir, name);
+        }
+        free(item.dir);
+        free(item.names);
+        scan_done(pool);
+    }
+    return NULL;
+}
+
+/* Run scan
+ * Input  : Root directory (or a single file) and worker count (0 : one
+ *          per online CPU)
+ * Output : One report line per image holding a stego header, and a
+ *          summary of files, images, hits, errors and throughput
+ * Return : e_success, or e_failure if the root cannot be scanned
+ */
+Status run_scan(const char *root, uint workers)
+{
+    ScanPool pool = { 0 };
+    ScanItem item = { NULL, NULL, 0 };
+    struct stat st;
+
+    if(stat(root, &st) != 0)
+    {
+        fprintf(stderr, "ERROR: Unable to scan %s : %s\n", root, strerror(errno));
+        return e_failure;
+    }
+    if(S_ISDIR(st.st_mode))
+    {
+        item.dir = strdup(root);
+        // "dir/" and "dir" give the same report paths
+        for(size_t len = item.dir ? strlen(item.dir) : 0; len > 1 && item.dir[len - 1] == '/'; len--)
+            item.dir[len - 1] = '\0';
+    }
+    else
+    {
+        item.dir = strdup("");
+        item.names = strdup(root);
+        item.count = 1;
+    }
+    if(item.dir == NULL || (item.count > 0 && item.names == NULL))
+    {
+        free(item.dir);
+        free(item.names);
+        return e_failure;
+    }
+
+    workers = resolve_workers(workers);
+
+    ScanWorker *args = calloc(workers, sizeof(ScanWorker));
+    pthread_t *tids = calloc(workers, sizeof(pthread_t));
+    int *started = calloc(workers, sizeof(int));
+    if(args == NULL || tids == NULL || started == NULL)
+    {
+        free(args);
+        free(tids);
+        free(started);
+        free(item.dir);
+        free(item.names);
+        return e_failure;
+    }
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.more, NULL);
+    scan_push(&pool, item);
+
+    double start = now_msec();
+    for(uint w = 0; w < workers; w++)
+    {
+        args[w].pool = &pool;
+        started[w] = pthread_create(&tids[w], NULL, scan_worker, &args[w]) == 0;
+    }
+    for(uint w = 0; w < workers; w++)
+    {
+        if(started[w])
+            pthread_join(tids[w], NULL);
+    }
+    // No worker could start : scan on this thread
+    scan_worker(&args[0]);
+    double total = now_msec() - start;
+
+    ScanCounts sum = { 0 };
+    for(uint w = 0; w < workers; w++)
+    {
+        sum.files += args[w].counts.files;
+        sum.images += args[w].counts.images;
+        sum.hits += args[w].counts.hits;
+        sum.errors += args[w].counts.errors;
+        sum.bytes += args[w].counts.bytes;
+        free(args[w].far);
+    }
+    free(args);
+    free(tids);
+    free(started);
+    free(pool.items);
+    pthread_cond_destroy(&pool.more);
+    pthread_mutex_destroy(&pool.lock);
+
+    printf("SCAN: %llu files, %llu BMP images, %llu hits, %llu errors, %llu bytes read, %u workers, %.3f ms (%.0f files/s)\n",
+           (unsigned long long)sum.files, (unsigned long long)sum.images, (unsigned long long)sum.hits,
+           (unsigned long long)sum.errors, (unsigned long long)sum.bytes, workers, total,
+           total > 0 ? sum.files * 1e3 / total : 0.0);
+    return e_success;
+}
@@ -0,0 +1,56 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "lz.h"
+#include "stego.h"
+#include "types.h"
+
+/*
+ * Stego scanner (--scan DIR).
+ *
+ * Walks a directory tree on a pool of workers and reports every BMP
+ * image that holds a stego header. Only the BMP header and the carrier
+ * bytes of the stego header are read, one pread of SCAN_READ_SIZE bytes
+ * per file for any usual pixel offset, and nothing is written.
+ *
+ * Report lines, the path last so it may hold spaces:
+ *      SCAN: HIT size=<bytes> extn=<extn> version=<v> bits=<n> [compressed=<stored bytes>] [alpha] path=<file>
+ *      SCAN: HIT shard=<index>/<count> size=<slice bytes> total=<secret bytes> extn=<extn> version=<v> bits=<n> [alpha] path=<file>
+ *      SCAN: HIT unsupported version=<v> path=<file>
+ * followed by a summary line.
+ */
+
+/* Bytes read from the start of every file : BMP header, palette and the stego header carrier bytes */
+#define SCAN_READ_SIZE 4096
+
+/* Carrier bytes of the largest stego header plus the raw size of a compressed payload
+ * or a shard descriptor, whichever is longer (at 1 bit per byte) */
+#define SCAN_CARRIER_SIZE ((STEGO_HEADER_MAX + (STEGO_SHARD_SIZE > LZ_STREAM_HEADER ? STEGO_SHARD_SIZE : LZ_STREAM_HEADER)) * 8)
+
+/* File names handed out per work item, so one huge directory still spreads over the workers */
+#define SCAN_BATCH_FILES 64
+
+/* One unit of work : a directory to list, or a batch of files in it */
+typedef struct _ScanItem
+{
+    char *dir;                // Directory path ("" for a single file given as the root)
+    char *names;              // count NUL terminated file names, NULL : list the directory
+    uint count;
+} ScanItem;
+
+/* Files, images, hits and errors seen by one worker */
+typedef struct _ScanCounts
+{
+    uint64_t files;           // Regular files opened
+    uint64_t images;          // ... that parse as a supported BMP
+    uint64_t hits;            // ... holding a stego header
+    uint64_t errors;          // Unreadable files and directories
+    uint64_t bytes;           // Bytes read
+} ScanCounts;
+
+/* Scan every file under root (a directory, or one file) on workers threads (0 : one per online CPU) */
+Status run_scan(const char *root, uint workers);
+
+#endif
@@ -0,0 +1,666 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : serve.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the long running daemon (--serve) and its thin
+ * client (--client). For small payloads the per-invocation cost of
+ * the one-shot tool (exec, dynamic linking, opening three files) is far
+ * larger than the LSB work itself; the daemon pays it once.
+ *
+ * Server :
+ * --------
+ * 1) Listens on a Unix stream socket
+ * 2) A bounded pool of worker threads accept() connections directly
+ * 3) The client passes open file descriptors, the server reads the
+ *    part it needs with pread into buffers every worker keeps warm,
+ *    growing them only when a larger request arrives
+ * 4) Requests are served in memory through libstego (stego.c); on
+ *    encode the untouched rest of the image is copied fd to fd inside
+ *    the kernel (copy_fd_range), a --compress payload is compressed
+ *    into another warm buffer first
+ *
+ * Client :
+ * --------
+ * Validates arguments exactly like -e / -d, opens the files, passes
+ * their descriptors and (decode) writes the returned secret data.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "bmp.h"
+#include "common.h"
+#include "decode.h"
+#include "encode.h"
+#include "lsb.h"
+#include "lz.h"
+#include "serve.h"
+#include "stego.h"
+
+/* Buffers a worker reuses across requests */
+typedef struct _ServeBuffers
+{
+    uint8_t *image;
+    size_t image_cap;
+    uint8_t *payload;
+    size_t payload_cap;
+    uint8_t *packed;          // Compressed payload (--compress)
+    size_t packed_cap;
+    uint8_t *output;
+    size_t output_cap;
+    uint8_t *carrier;         // Gathered carrier bytes of padded images
+    size_t carrier_cap;
+} ServeBuffers;
+
+/* Shared state of the worker pool */
+typedef struct _ServePool
+{
+    int listen_fd;
+    pthread_mutex_t lock;     // Guards stopping and conns
+    int stopping;             // Set once SIGINT / SIGTERM arrived
+    int conns[MAX_WORKERS];   // Connection each worker is serving, -1 : none
+} ServePool;
+
+/* Arguments of one worker thread */
+typedef struct _ServeWorker
+{
+    ServePool *pool;
+    uint id;
+} ServeWorker;
+
+/* Read exactly len bytes
+ * Return : 1 when read, 0 on EOF before the first byte, -1 on error / short read
+ */
+static int serve_read_all(int fd, void *buf, size_t len)
+{
+    size_t done = 0;
+    while(done < len)
+    {
+        ssize_t count = read(fd, (char *)buf + done, len - done);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count <= 0)
+            return (count == 0 && done == 0) ? 0 : -1;
+        done += count;
+    }
+    return 1;
+}
+
+/* Write exactly len bytes (no SIGPIPE when the peer is gone)
+ * Return : e_success or e_failure
+ */
+static Status serve_write_all(int fd, const void *buf, size_t len)
+{
+    size_t done = 0;
+    while(done < len)
+    {
+        ssize_t count = send(fd, (const char *)buf + done, len - done, MSG_NOSIGNAL);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count <= 0)
+            return e_failure;
+        done += count;
+    }
+    return e_success;
+}
+
+/* Grow a buffer
+ * Input  : Buffer, its capacity and the size needed
+ * Return : e_success, or e_failure when out of memory
+ */
+static Status serve_reserve(uint8_t **buf, size_t *cap, size_t need)
+{
+    if(need <= *cap)
+        return e_success;
+
+    uint8_t *grown = realloc(*buf, need);
+    if(grown == NULL)
+        return e_failure;
+    *buf = grown;
+    *cap = need;
+    return e_success;
+}
+
+/* Receive request
+ * Input  : Connected socket, request, fd array of SERVE_MAX_FDS and fd count
+ * Output : Request header and the descriptors passed with it
+ * Return : 1 when received, 0 on EOF, -1 on error
+ */
+static int serve_recv_request(int fd, ServeRequest *req, int *fds, uint *nfds)
+{
+    char control[CMSG_SPACE(SERVE_MAX_FDS * sizeof(int))];
+    struct iovec iov = { req, sizeof(*req) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control, .msg_controllen = sizeof(control) };
+    ssize_t count;
+
+    *nfds = 0;
+    do
+    {
+        count = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+    } while(count < 0 && errno == EINTR);
+    if(count <= 0)
+        return count == 0 ? 0 : -1;
+
+    for(struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if(cmsg -> cmsg_level == SOL_SOCKET && cmsg -> cmsg_type == SCM_RIGHTS)
+        {
+            *nfds = (cmsg -> cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(cmsg), *nfds * sizeof(int));
+        }
+    }
+    if(msg.msg_flags & MSG_CTRUNC)
+        return -1;
+
+    // The descriptors come with the first byte, the rest is plain data
+    if((size_t)count < sizeof(*req) && serve_read_all(fd, (char *)req + count, sizeof(*req) - count) != 1)
+        return -1;
+    return 1;
+}
+
+/* Read a whole passed file into a warm buffer
+ * Input  : File descriptor, buffer, its capacity and the size pointer
+ * Output : File contents and size
+ */
+static Status serve_load_fd(int fd, uint8_t **buf, size_t *cap, size_t *len)
+{
+    struct stat st;
+
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (uint64_t)st.st_size > SERVE_MAX_IMAGE
+       || serve_reserve(buf, cap, st.st_size > 0 ? st.st_size : 1) != e_success)
+        return e_failure;
+
+    size_t done = 0;
+    while(done < (size_t)st.st_size)
+    {
+        ssize_t count = pread(fd, *buf + done, st.st_size - done, done);
+        if(count < 0 && errno == EINTR)
+            continue;
+        if(count <= 0)
+            return e_failure;
+        done += count;
+    }
+    *len = done;
+    return e_success;
+}
+
+/* Parse the layout of a passed image
+ * Input  : Image fd, its size and whether 32 bpp alpha bytes carry data
+ * Output : Pixel layout from the BMP header
+ */
+static Status serve_layout(int fd, uint64_t file_size, uint use_alpha, BmpLayout *layout)
+{
+    unsigned char header[BMP_HEADER_SIZE];
+
+    if(pread(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header))
+        return e_failure;
+    return bmp_parse(header, sizeof(header), file_size, use_alpha, layout);
+}
+
+/* Read carrier bytes
+ * Input  : Image fd, layout, carrier length and warm buffers
+ * Output : The image up to the end of carrier bytes [0, len) in the image
+ *          buffer; *carrier points at those bytes, in the image buffer
+ *          itself or gathered into the carrier buffer for padded rows
+ */
+static Status serve_read_carrier(int fd, const BmpLayout *layout, size_t len, ServeBuffers *bufs, uint8_t **carrier)
+{
+    size_t region = bmp_region_end(layout, len);
+
+    if(serve_reserve(&bufs -> image, &bufs -> image_cap, region) != e_success
+       || pread(fd, bufs -> image, region, 0) != (ssize_t)region)
+        return e_failure;
+
+    if(layout -> contiguous)
+    {
+        *carrier = bufs -> image + layout -> offset;
+        return e_success;
+    }
+    if(serve_reserve(&bufs -> carrier, &bufs -> carrier_cap, len ? len : 1) != e_success)
+        return e_failure;
+    bmp_gather(layout, bufs -> image + layout -> offset, 0, bufs -> carrier, len);
+    *carrier = bufs -> carrier;
+    return e_success;
+}
+
+/* Serve encode request
+ * Input  : Request, passed fds { image, secret, output } and warm buffers
+ * Output : Stego image written to the output fd. Only the BMP header and
+ *          the rows of the payload region pass through the buffer, the
+ *          rest of the image is copied inside the kernel
+ * Return : StegoStatus, or -1 on I/O error
+ */
+static int serve_encode(const ServeRequest *req, const int *fds, ServeBuffers *bufs)
+{
+    BmpLayout layout;
+    size_t payload_len;
+    struct stat st;
+    uint8_t *pixels;
+
+    if(serve_load_fd(fds[1], &bufs -> payload, &bufs -> payload_cap, &payload_len) != e_success
+       || fstat(fds[0], &st) != 0 || !S_ISREG(st.st_mode))
+        return -1;
+    if(serve_layout(fds[0], st.st_size, req -> flags & STEGO_FLAG_ALPHA, &layout) != e_success)
+        return e_stego_bad_args;
+    // STEGO_FLAG_ALPHA asks for the alpha bytes, recorded only where there are some
+    uint32_t flags = (req -> flags & ~STEGO_FLAG_ALPHA) | (bmp_uses_alpha(&layout) ? STEGO_FLAG_ALPHA : 0);
+    const uint8_t *payload = bufs -> payload;
+    if(req -> flags & STEGO_FLAG_COMPRESSED)
+    {
+        if(serve_reserve(&bufs -> packed, &bufs -> packed_cap, lz_stream_bound(payload_len)) != e_success)
+            return -1;
+        payload_len = lz_compress_buffer(bufs -> payload, payload_len, bufs -> packed);
+        payload = bufs -> packed;
+    }
+    uint bits = STEGO_BITS(req -> flags);
+    if(payload_len > stego_capacity_bits(bmp_carrier_size(&layout), strlen(req -> extn), bits))
+        return e_stego_no_capacity;
+
+    // Stego region is encoded in place in the warm buffers
+    size_t used = stego_header_size(strlen(req -> extn)) * 8 + lsb_carrier_size(payload_len + STEGO_CRC_SIZE, bits);
+    if(serve_read_carrier(fds[0], &layout, used, bufs, &pixels) != e_success)
+        return -1;
+    int status = stego_embed(pixels, used, payload, payload_len, req -> extn, flags, pixels);
+    if(status != e_stego_ok)
+        return status;
+    if(!layout.contiguous)
+    {
+        bmp_scatter(&layout, pixels, bufs -> image + layout.offset, 0, used);
+    }
+
+    size_t region = bmp_region_end(&layout, used);
+    if(pwrite(fds[2], bufs -> image, region, 0) != (ssize_t)region
+       || copy_fd_range(fds[0], region, fds[2], region, st.st_size - region) != e_success
+       || ftruncate(fds[2], st.st_size) != 0)
+        return -1;
+    return e_stego_ok;
+}
+
+/* Peek stego header of a passed image
+ * Input  : Image fd, layout and warm buffers
+ * Output : Parsed stego header, only the header bytes are read
+ * Return : StegoStatus, or -1 on I/O error
+ */
+static int serve_peek(int fd, const BmpLayout *layout, ServeBuffers *bufs, StegoHeader *header)
+{
+    uint64_t carrier_size = bmp_carrier_size(layout);
+    size_t len = carrier_size < STEGO_HEADER_MAX * 8 ? carrier_size : STEGO_HEADER_MAX * 8;
+    uint8_t *pixels;
+
+    if(serve_read_carrier(fd, layout, len, bufs, &pixels) != e_success)
+        return -1;
+
+    // stego_parse_header() touches at most STEGO_HEADER_MAX encoded bytes, so it
+    // can check the sizes against the whole carrier while only the header is read
+    return stego_parse_header(pixels, carrier_size, header);
+}
+
+/* Serve decode request
+ * Input  : Passed image fd and warm buffers
+ * Output : Secret data in the output buffer, its size and extension.
+ *          Only the stego header and the payload region are read
+ * Return : StegoStatus, or -1 on I/O error
+ */
+static int serve_decode(int fd, ServeBuffers *bufs, char *extn, uint64_t *data_len)
+{
+    BmpLayout layout;
+    StegoHeader header;
+    size_t payload_len;
+    struct stat st;
+    uint8_t *pixels;
+
+    if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return -1;
+    if(serve_layout(fd, st.st_size, 0, &layout) != e_success)
+        return e_stego_bad_args;
+
+    int status = serve_peek(fd, &layout, bufs, &header);
+    if(status == e_stego_not_stego && layout.bpp == 32)
+    {
+        // Written with --alpha : the header records it (STEGO_FLAG_ALPHA) in the alpha carrier
+        bmp_set_alpha(&layout, 1);
+        status = serve_peek(fd, &layout, bufs, &header);
+        if(status == e_stego_ok && !STEGO_ALPHA_CONFIRMED(header))
+            status = e_stego_not_stego;
+    }
+    if((status == e_stego_not_stego || (status == e_stego_ok && header.version == 1)) && !bmp_is_flat(&layout))
+    {
+        // Version 1 images (before the BMP parser) hid their data right after the 54 byte header
+        bmp_flat_layout(st.st_size, &layout);
+        status = serve_peek(fd, &layout, bufs, &header);
+    }
+    if(status == e_stego_ok && (header.flags & STEGO_FLAG_SHARD))
+        status = e_stego_shard;
+    if(status != e_stego_ok)
+        return status;
+
+    // Decoded secrets are held in memory, so the same bound as for encode
+    if(header.payload_len > SERVE_MAX_IMAGE)
+        return e_stego_buffer_small;
+    payload_len = header.payload_len;
+    size_t used = header.size * 8 + lsb_carrier_size(payload_len + STEGO_TRAILER_SIZE(header.version), STEGO_BITS(header.flags));
+    if(serve_reserve(&bufs -> output, &bufs -> output_cap, payload_len ? payload_len : 1) != e_success
+       || serve_read_carrier(fd, &layout, used, bufs, &pixels) != e_success)
+        return -1;
+
+    // A compressed payload reports its decompressed size when it does not fit
+    status = stego_decode(pixels, used, bufs -> output, bufs -> output_cap, &payload_len, extn);
+    if(status == e_stego_buffer_small && (header.flags & STEGO_FLAG_COMPRESSED) && payload_len <= SERVE_MAX_IMAGE)
+    {
+        if(serve_reserve(&bufs -> output, &bufs -> output_cap, payload_len) != e_success)
+            return -1;
+        status = stego_decode(pixels, used, bufs -> output, bufs -> output_cap, &payload_len, extn);
+    }
+    *data_len = status == e_stego_ok ? payload_len : 0;
+    return status;
+}
+
+/* Serve one connection
+ * Input  : Connected socket and the worker's buffers
+ * Output : Answers requests until the client closes the connection
+ */
+static void serve_connection(int fd, ServeBuffers *bufs)
+{
+    ServeRequest req;
+    int fds[SERVE_MAX_FDS];
+    uint nfds;
+    int got;
+
+    while((got = serve_recv_request(fd, &req, fds, &nfds)) != 0)
+    {
+        ServeResponse resp = { SERVE_MAGIC, -1, "", 0 };
+        int valid = got == 1 && req.magic == SERVE_MAGIC
+                    && ((req.op == e_encode && nfds == 3) || (req.op == e_decode && nfds == 1))
+                    && memchr(req.extn, '\0', sizeof(req.extn)) != NULL
+                    && (req.flags & ~(STEGO_FLAGS_KNOWN & ~STEGO_FLAG_SHARD)) == 0 && STEGO_BITS(req.flags) <= 4;
+
+        if(valid && req.op == e_encode)
+        {
+            resp.status = serve_encode(&req, fds, bufs);
+        }
+        else if(valid)
+        {
+            resp.status = serve_decode(fds[0], bufs, resp.extn, &resp.data_len);
+        }
+
+        for(uint i = 0; i < nfds; i++)
+            close(fds[i]);
+
+        if(serve_write_all(fd, &resp, sizeof(resp)) != e_success
+           || (resp.data_len > 0 && serve_write_all(fd, bufs -> output, resp.data_len) != e_success)
+           || got != 1)
+        {
+            return;                   // peer gone or stream out of sync
+        }
+    }
+}
+
+/* Worker thread
+ * Input  : ServeWorker
+ * Output : Accepts and serves connections until the socket is shut
+ *          down. Any other accept error (out of descriptors or memory)
+ *          is reported once and retried after SERVE_ACCEPT_BACKOFF_MS,
+ *          so the pool keeps its size through a transient shortage.
+ *          The connection being served is published in the pool, so
+ *          run_server() can end it once its current request is done
+ */
+static void *serve_worker(void *arg)
+{
+    ServeWorker *worker = arg;
+    ServePool *pool = worker -> pool;
+    ServeBuffers bufs = { 0 };
+    int failing = 0;
+
+    for(;;)
+    {
+        int fd = accept(pool -> listen_fd, NULL, NULL);
+        if(fd < 0)
+        {
+            if(errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if(errno == EINVAL || errno == EBADF || errno == ENOTSOCK)
+                break;                // socket shut down by run_server()
+            if(!failing)
+                fprintf(stderr, "ERROR: accept : %s, retrying\n", strerror(errno));
+            failing = 1;
+            struct timespec pause = { 0, SERVE_ACCEPT_BACKOFF_MS * 1000000L };
+            nanosleep(&pause, NULL);
+            continue;
+        }
+        failing = 0;
+
+        pthread_mutex_lock(&pool -> lock);
+        int stopping = pool -> stopping;
+        if(!stopping)
+            pool -> conns[worker -> id] = fd;
+        pthread_mutex_unlock(&pool -> lock);
+        if(!stopping)
+            serve_connection(fd, &bufs);
+
+        pthread_mutex_lock(&pool -> lock);
+        pool -> conns[worker -> id] = -1;
+        pthread_mutex_unlock(&pool -> lock);
+        close(fd);
+    }
+    free(bufs.image);
+    free(bufs.payload);
+    free(bufs.packed);
+    free(bufs.output);
+    free(bufs.carrier);
+    return NULL;
+}
+
+/* Run server
+ * Input  : Socket path and worker count (0 : one per online CPU)
+ * Output : Serves requests until SIGINT / SIGTERM. Then no connection is
+ *          accepted any more, the read side of every open connection is
+ *          shut down (an idle client sees the end, a request in flight
+ *          still completes and gets its response), the workers are
+ *          joined and the socket is removed
+ * Return : e_success, or e_failure if the socket could not be set up
+ */
+Status run_server(const char *socket_path, uint workers)
+{
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    pthread_t tids[MAX_WORKERS];
+    ServeWorker args[MAX_WORKERS];
+    ServePool pool = { .listen_fd = -1, .lock = PTHREAD_MUTEX_INITIALIZER };
+    struct stat st;
+
+    if(strlen(socket_path) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "ERROR: Socket path %s is too long\n", socket_path);
+        return e_failure;
+    }
+    strcpy(addr.sun_path, socket_path);
+
+    // A stale socket of a previous run is replaced, any other file is not
+    if(stat(socket_path, &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(socket_path);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, SERVE_BACKLOG) != 0)
+    {
+        perror("socket");
+        fprintf(stderr, "ERROR: Unable to listen on %s\n", socket_path);
+        if(listen_fd >= 0)
+            close(listen_fd);
+        return e_failure;
+    }
+
+    workers = resolve_workers(workers);
+
+    // Only this thread takes SIGINT / SIGTERM, workers inherit the mask
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, NULL);
+
+    pool.listen_fd = listen_fd;
+    for(uint w = 0; w < MAX_WORKERS; w++)
+        pool.conns[w] = -1;
+
+    uint started = 0;
+    for(uint w = 0; w < workers; w++)
+    {
+        args[started] = (ServeWorker) { &pool, started };
+        if(pthread_create(&tids[started], NULL, serve_worker, &args[started]) == 0)
+            started++;
+    }
+    if(started == 0)
+    {
+        close(listen_fd);
+        unlink(socket_path);
+        return e_failure;
+    }
+    PRINT_INFO("INFO: Serving on %s with %u workers\n", socket_path, started);
+
+    int sig;
+    sigwait(&stop, &sig);
+    PRINT_INFO("INFO: Stopping server\n");
+
+    // Workers blocked in accept() return, the others after their current request
+    shutdown(listen_fd, SHUT_RDWR);
+    pthread_mutex_lock(&pool.lock);
+    pool.stopping = 1;
+    for(uint w = 0; w < started; w++)
+    {
+        if(pool.conns[w] >= 0)
+            shutdown(pool.conns[w], SHUT_RD);
+    }
+    pthread_mutex_unlock(&pool.lock);
+    for(uint w = 0; w < started; w++)
+        pthread_join(tids[w], NULL);
+
+    close(listen_fd);
+    unlink(socket_path);
+    return e_success;
+}
+
+/* Run client
+ * Input  : Socket path, e_encode / e_decode and the validated arguments
+ *          of that operation (encInfo -> flags : --bits, --compress,
+ *          encInfo -> use_alpha : --alpha)
+ * Output : Passes the files to the daemon; on decode writes the secret
+ *          data it returns
+ * Return : e_success or e_failure
+ */
+Status run_client(const char *socket_path, OperationType type, EncodeInfo *encInfo, DecodeInfo *decInfo)
+{
+    ServeRequest req = { .magic = SERVE_MAGIC, .op = type, .extn = "", .flags = 0 };
+    ServeResponse resp;
+    int fds[SERVE_MAX_FDS] = { -1, -1, -1 };
+    uint nfds = type == e_encode ? 3 : 1;
+    uint8_t *data = NULL;
+    Status ret = e_failure;
+    int sock = -1;
+
+    if(type == e_encode)
+    {
+        req.flags = encInfo -> flags | (encInfo -> use_alpha ? STEGO_FLAG_ALPHA : 0);
+        strcpy(req.extn, encInfo -> extn_secret_file);
+        fds[0] = open(encInfo -> src_image_fname, O_RDONLY);
+        fds[1] = open(encInfo -> secret_fname, O_RDONLY);
+        fds[2] = open(encInfo -> stego_image_fname, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    }
+    else
+    {
+        fds[0] = open(decInfo -> stego_image_fname, O_RDONLY);
+    }
+    for(uint i = 0; i < nfds; i++)
+    {
+        if(fds[i] < 0)
+        {
+            perror("open");
+            fprintf(stderr, "ERROR: Unable to open the files of the request\n");
+            goto done;
+        }
+    }
+
+    struct sockaddr_un addr = { .sun_family = AF_UNIX };
+    snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", socket_path);
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if(sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        perror("connect");
+        fprintf(stderr, "ERROR: Unable to connect to %s\n", socket_path);
+        goto done;
+    }
+
+    char control[CMSG_SPACE(SERVE_MAX_FDS * sizeof(int))] = {0};
+    struct iovec iov = { &req, sizeof(req) };
+    struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1, .msg_control = control,
+                          .msg_controllen = CMSG_SPACE(nfds * sizeof(int)) };
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg -> cmsg_level = SOL_SOCKET;
+    cmsg -> cmsg_type = SCM_RIGHTS;
+    cmsg -> cmsg_len = CMSG_LEN(nfds * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, nfds * sizeof(int));
+
+    PRINT_INFO("INFO: Sending %s request to %s\n", type == e_encode ? "encode" : "decode", socket_path);
+    if(sendmsg(sock, &msg, MSG_NOSIGNAL) != sizeof(req)
+       || serve_read_all(sock, &resp, sizeof(resp)) != 1 || resp.magic != SERVE_MAGIC)
+    {
+        fprintf(stderr, "ERROR: Request to %s failed\n", socket_path);
+        goto done;
+    }
+    if(resp.status != e_stego_ok)
+    {
+        fprintf(stderr, "ERROR: Server: %s\n", resp.status < 0 ? "unable to read / write the files" : stego_strerror(resp.status));
+        goto done;
+    }
+
+    if(type == e_encode)
+    {
+        ret = e_success;          // the server wrote the stego image
+    }
+    else
+    {
+        if(resp.data_len > SERVE_MAX_IMAGE || (data = malloc(resp.data_len ? resp.data_len : 1)) == NULL
+           || (resp.data_len > 0 && serve_read_all(sock, data, resp.data_len) != 1))
+        {
+            fprintf(stderr, "ERROR: Truncated response from %s\n", socket_path);
+            goto done;
+        }
+        resp.extn[sizeof(resp.extn) - 1] = '\0';
+        strcat(decInfo -> secret_output_fname, resp.extn);
+
+        FILE *fptr = fopen(decInfo -> secret_output_fname, "w");
+        if(fptr == NULL)
+        {
+            perror("fopen");
+            fprintf(stderr, "ERROR: Unable to open file %s\n", decInfo -> secret_output_fname);
+            goto done;
+        }
+        ret = fwrite(data, 1, resp.data_len, fptr) == resp.data_len ? e_success : e_failure;
+        if(fclose(fptr) != 0)
+            ret = e_failure;
+    }
+    PRINT_INFO("INFO: Done\n");
+
+done:
+    if(sock >= 0)
+        close(sock);
+    for(uint i = 0; i < nfds; i++)
+    {
+        if(fds[i] >= 0)
+            close(fds[i]);
+    }
+    free(data);
+    return ret;
+}
@@ -0,0 +1,62 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include <stdint.h>
+#include "decode.h"
+#include "encode.h"
+#include "types.h"
+
+/*
+ * Daemon mode (--serve /path.sock) and its thin client (--client /path.sock).
+ *
+ * One request / response pair per round trip over a Unix stream socket,
+ * any number of round trips per connection. The client opens the files
+ * and passes the descriptors (SCM_RIGHTS), so image bytes never cross
+ * the socket:
+ *
+ *      encode : ServeRequest + fds { image, secret, output } → ServeResponse
+ *      decode : ServeRequest + fds { image }                 → ServeResponse | secret data
+ *
+ * All integers are in host byte order (both ends are on the same host).
+ */
+
+/* "STGS" */
+#define SERVE_MAGIC 0x53475453u
+
+/* Largest image / secret accepted by the server */
+#define SERVE_MAX_IMAGE ((uint64_t)1 << 32)
+
+/* Pending connections queued by listen() */
+#define SERVE_BACKLOG 128
+
+/* Pause before accepting again after a transient accept error (EMFILE, ENFILE, ENOBUFS, ...) */
+#define SERVE_ACCEPT_BACKOFF_MS 100
+
+/* Descriptors passed with an encode request */
+#define SERVE_MAX_FDS 3
+
+/* Request header */
+typedef struct _ServeRequest
+{
+    uint32_t magic;           // SERVE_MAGIC
+    uint32_t op;              // e_encode or e_decode
+    char extn[8];             // Secret file extension (encode)
+    uint32_t flags;           // Stego header flags, STEGO_FLAG_BITS, STEGO_FLAG_COMPRESSED and STEGO_FLAG_ALPHA (encode)
+} ServeRequest;
+
+/* Response header */
+typedef struct _ServeResponse
+{
+    uint32_t magic;           // SERVE_MAGIC
+    int32_t status;           // StegoStatus, or -1 for a malformed request / I/O error
+    char extn[8];             // Secret file extension (decode)
+    uint64_t data_len;        // Secret bytes that follow (decode)
+} ServeResponse;
+
+/* Run the daemon on a Unix socket with a bounded pool of workers */
+Status run_server(const char *socket_path, uint workers);
+
+/* Send one validated encode / decode job to a running daemon (encInfo for e_encode, decInfo for e_decode) */
+Status run_client(const char *socket_path, OperationType type, EncodeInfo *encInfo, DecodeInfo *decInfo);
+
+#endif
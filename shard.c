@@ -0,0 +1,760 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : shard.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the sharding mode, which spreads one secret too
+ * large for any single carrier over several of them (format in shard.h).
+ *
+ * Encoding :
+ * ----------
+ * 1) Every carrier is mapped and parsed, its capacity less the shard
+ *    descriptor is what its slice may take
+ * 2) Slices are sized in proportion to the capacities, contiguous and in
+ *    carrier order, so the secret is read once with no copy
+ * 3) The crc of every slice is taken in parallel and joined into the
+ *    crc of the whole secret (crc32c_combine()), which every descriptor
+ *    carries
+ * 4) Every carrier is copied to its output (in the kernel, see
+ *    copy_fd_range()) and the header, descriptor, slice and payload crc
+ *    are embedded into the mapped copy, one image per worker
+ *
+ * Decoding :
+ * ----------
+ * 1) Every image is mapped and its stego header and descriptor read
+ * 2) The descriptors must form one complete set : same secret, every
+ *    index once, slices tiling the whole secret
+ * 3) The output is created with its final size and mapped, every worker
+ *    extracts its slice straight to its offset and checks the payload
+ *    crc; the slice crcs are then joined, in index order, into the crc
+ *    of the whole secret and checked against the descriptors
+ *
+ * Work items are handed out with an atomic counter, the calling thread
+ * is one of the workers.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "common.h"
+#include "crc32c.h"
+#include "encode.h"
+#include "lsb.h"
+#include "shard.h"
+
+/* One step run over every part */
+typedef void (*ShardTask)(void *ctx, ShardPart *part);
+
+/* Shared state of one step */
+typedef struct _ShardPool
+{
+    ShardPart *parts;
+    uint count;
+    uint next;                // Next part to take, claimed with an atomic add
+    ShardTask task;
+    void *ctx;
+} ShardPool;
+
+/* Secret side of an encode run */
+typedef struct _ShardSecret
+{
+    const unsigned char *data;    // Mapped secret (NULL when empty)
+    const char *extn;
+    uint32_t flags;               // Stego header flags, STEGO_FLAG_SHARD included
+    uint use_alpha;               // --alpha
+} ShardSecret;
+
+static void shard_put_u32(uint8_t *dest, uint32_t value)
+{
+    for(int i = 0; i < 4; i++)
+        dest[i] = value >> (24 - 8 * i);
+}
+
+static uint32_t shard_get_u32(const uint8_t *src)
+{
+    return (uint32_t)src[0] << 24 | (uint32_t)src[1] << 16 | (uint32_t)src[2] << 8 | src[3];
+}
+
+static void shard_put_u64(uint8_t *dest, uint64_t value)
+{
+    shard_put_u32(dest, value >> 32);
+    shard_put_u32(dest + 4, value);
+}
+
+static uint64_t shard_get_u64(const uint8_t *src)
+{
+    return (uint64_t)shard_get_u32(src) << 32 | shard_get_u32(src + 4);
+}
+
+/* Serialise shard descriptor
+ * Input  : Descriptor and a STEGO_SHARD_SIZE byte field
+ * Output : Fields MSB first, in the order of shard.h
+ */
+void shard_put_desc(uint8_t *field, const ShardDesc *desc)
+{
+    shard_put_u32(field, desc -> index);
+    shard_put_u32(field + 4, desc -> count);
+    shard_put_u64(field + 8, desc -> offset);
+    shard_put_u64(field + 16, desc -> total);
+    shard_put_u32(field + 24, desc -> secret_crc);
+}
+
+/* Parse shard descriptor
+ * Input  : STEGO_SHARD_SIZE byte field
+ * Output : Descriptor (not checked)
+ */
+void shard_get_desc(const uint8_t *field, ShardDesc *desc)
+{
+    desc -> index = shard_get_u32(field);
+    desc -> count = shard_get_u32(field + 4);
+    desc -> offset = shard_get_u64(field + 8);
+    desc -> total = shard_get_u64(field + 16);
+    desc -> secret_crc = shard_get_u32(field + 24);
+}
+
+/* Worker thread
+ * Input  : ShardPool
+ * Output : Runs the step on parts until none is left, timing each
+ */
+static void *shard_worker(void *arg)
+{
+    ShardPool *pool = arg;
+    uint i;
+
+    while((i = __atomic_fetch_add(&pool -> next, 1, __ATOMIC_RELAXED)) < pool -> count)
+    {
+        double start = now_msec();
+        pool -> task(pool -> ctx, &pool -> parts[i]);
+        pool -> parts[i].msec += now_msec() - start;
+    }
+    return NULL;
+}
+
+/* Run step
+ * Input  : Parts, their count, worker count, step and its context
+ * Output : The step run once on every part, on up to workers threads
+ *          (this one included); returns when all parts are done
+ */
+static void shard_run(ShardPart *parts, uint count, uint workers, ShardTask task, void *ctx)
+{
+    ShardPool pool = { parts, count, 0, task, ctx };
+    pthread_t tids[MAX_WORKERS];
+    uint started = 0;
+
+    for(uint w = 1; w < workers && w < count; w++)
+    {
+        if(pthread_create(&tids[started], NULL, shard_worker, &pool) == 0)
+            started++;
+    }
+    shard_worker(&pool);
+    for(uint w = 0; w < started; w++)
+        pthread_join(tids[w], NULL);
+}
+
+/* Map image
+ * Input  : Part with its image file name, --alpha setting
+ * Output : Image opened read only, mapped and its BMP layout parsed
+ * Return : e_success, or e_failure (reported)
+ */
+static Status shard_map_image(ShardPart *part, uint use_alpha)
+{
+    struct stat st;
+
+    part -> fd = open(part -> image_fname, O_RDONLY | O_CLOEXEC);
+    if(part -> fd < 0 || fstat(part -> fd, &st) != 0)
+    {
+        fprintf(stderr, "ERROR: Unable to open file %s : %s\n", part -> image_fname, strerror(errno));
+        return e_failure;
+    }
+    part -> image_size = st.st_size;
+    if(part -> image_size > 0)
+        part -> image = mmap(NULL, part -> image_size, PROT_READ, MAP_PRIVATE, part -> fd, 0);
+    if(part -> image == NULL || part -> image == MAP_FAILED)
+    {
+        part -> image = NULL;
+        fprintf(stderr, "ERROR: Unable to map %s\n", part -> image_fname);
+        return e_failure;
+    }
+    if(bmp_parse(part -> image, part -> image_size, part -> image_size, use_alpha, &part -> layout) != e_success)
+    {
+        fprintf(stderr, "ERROR: %s is not a supported BMP image\n", part -> image_fname);
+        return e_failure;
+    }
+    return e_success;
+}
+
+/* Release parts
+ * Input  : Parts and their count
+ * Output : Every mapping, descriptor and name freed, then the array
+ */
+static void shard_free(ShardPart *parts, uint count)
+{
+    for(uint i = 0; i < count; i++)
+    {
+        if(parts[i].image != NULL)
+            munmap(parts[i].image, parts[i].image_size);
+        if(parts[i].fd >= 0)
+            close(parts[i].fd);
+        free(parts[i].output_fname);
+    }
+    free(parts);
+}
+
+/* Allocate parts
+ * Input  : Image file names and their count
+ * Return : Parts with no file open, or NULL when out of memory
+ */
+static ShardPart *shard_alloc(char *images[], uint count)
+{
+    ShardPart *parts = calloc(count, sizeof(ShardPart));
+
+    for(uint i = 0; parts != NULL && i < count; i++)
+    {
+        parts[i].image_fname = images[i];
+        parts[i].fd = -1;
+    }
+    return parts;
+}
+
+
+/* Open carrier (encode step 1)
+ * Input  : ShardSecret and the part
+ * Output : Carrier mapped, the largest slice it takes in capacity
+ */
+static void shard_open_carrier(void *ctx, ShardPart *part)
+{
+    const ShardSecret *secret = ctx;
+
+    part -> status = shard_map_image(part, secret -> use_alpha);
+    if(part -> status != e_success)
+        return;
+
+    size_t room = stego_capacity_bits(bmp_carrier_size(&part -> layout), strlen(secret -> extn), STEGO_BITS(secret -> flags));
+    if(room < STEGO_SHARD_SIZE)
+    {
+        fprintf(stderr, "ERROR: %s is too small to carry a shard\n", part -> image_fname);
+        part -> status = e_failure;
+        return;
+    }
+    part -> capacity = room - STEGO_SHARD_SIZE;
+}
+
+/* Plan slices
+ * Input  : Parts with their capacity, their count and the secret size
+ * Output : Contiguous slices in part order, each in proportion to the
+ *          part's capacity (rounded down, the rest then given out in
+ *          order where room is left), and the total capacity in room
+ * Return : e_success, or e_failure when the carriers hold less than size
+ */
+static Status shard_plan(ShardPart *parts, uint count, uint64_t size, uint64_t *room)
+{
+    uint64_t used = 0, offset = 0;
+
+    *room = 0;
+    for(uint i = 0; i < count; i++)
+        *room += parts[i].capacity;
+    if(*room < size)
+        return e_failure;
+
+    for(uint i = 0; i < count; i++)
+    {
+        parts[i].len = (uint64_t)((unsigned __int128)size * parts[i].capacity / *room);
+        used += parts[i].len;
+    }
+    for(uint i = 0; i < count && used < size; i++)
+    {
+        uint64_t more = parts[i].capacity - parts[i].len;
+        if(more > size - used)
+            more = size - used;
+        parts[i].len += more;
+        used += more;
+    }
+    for(uint i = 0; i < count; i++)
+    {
+        parts[i].desc.offset = offset;
+        offset += parts[i].len;
+    }
+    return e_success;
+}
+
+/* Checksum slice (encode step 2)
+ * Input  : ShardSecret and the part
+ * Output : CRC32C of the part's slice of the secret
+ */
+static void shard_crc_slice(void *ctx, ShardPart *part)
+{
+    const ShardSecret *secret = ctx;
+
+    if(part -> len > 0)
+        part -> slice_crc = crc32c_update(0, secret -> data + part -> desc.offset, part -> len);
+}
+
+/* Write shard image (encode step 3)
+ * Input  : ShardSecret and the part, its descriptor filled in
+ * Output : Carrier copied to the output file, then the stego header, the
+ *          descriptor, the slice and the payload crc embedded into the
+ *          mapped copy (the crc joined from the descriptor's and the
+ *          slice's, the slice is not read twice)
+ */
+static void shard_write_image(void *ctx, ShardPart *part)
+{
+    const ShardSecret *secret = ctx;
+    const BmpLayout *layout = &part -> layout;
+    uint bits = STEGO_BITS(secret -> flags);
+    uint8_t header[STEGO_HEADER_MAX];
+    uint8_t field[STEGO_SHARD_SIZE];
+    uint8_t trailer[STEGO_CRC_SIZE];
+    struct stat src, st;
+
+    part -> status = e_failure;
+    int fd = open(part -> output_fname, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(fd < 0 || fstat(fd, &st) != 0 || fstat(part -> fd, &src) != 0)
+    {
+        fprintf(stderr, "ERROR: Unable to open file %s : %s\n", part -> output_fname, strerror(errno));
+        if(fd >= 0)
+            close(fd);
+        return;
+    }
+    // Truncating a carrier before copying it would lose it
+    if(st.st_dev == src.st_dev && st.st_ino == src.st_ino)
+    {
+        fprintf(stderr, "ERROR: %s is also a carrier\n", part -> output_fname);
+        close(fd);
+        return;
+    }
+    part -> created = 1;
+
+    unsigned char *image = MAP_FAILED;
+    if(ftruncate(fd, 0) == 0 && copy_fd_range(part -> fd, 0, fd, 0, part -> image_size) == e_success)
+        image = mmap(NULL, part -> image_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if(image == MAP_FAILED)
+    {
+        fprintf(stderr, "ERROR: Unable to write %s\n", part -> output_fname);
+        close(fd);
+        return;
+    }
+
+    const unsigned char *src_pixels = part -> image + layout -> offset;
+    unsigned char *pixels = image + layout -> offset;
+    uint32_t flags = secret -> flags | (bmp_uses_alpha(layout) ? STEGO_FLAG_ALPHA : 0);
+    uint64_t header_len = stego_build_header(secret -> extn, STEGO_SHARD_SIZE + part -> len, flags, header);
+    uint64_t pos = header_len * 8;
+
+    bmp_embed(layout, src_pixels, pixels, 0, header, header_len, 1, NULL);
+    shard_put_desc(field, &part -> desc);
+    part -> desc_crc = crc32c_update(0, field, sizeof(field));
+    bmp_embed(layout, src_pixels, pixels, pos, field, sizeof(field), bits, NULL);
+    pos += lsb_carrier_size(sizeof(field), bits);
+    if(part -> len > 0)
+        bmp_embed(layout, src_pixels, pixels, pos, secret -> data + part -> desc.offset, part -> len, bits, NULL);
+    pos += lsb_carrier_size(part -> len, bits);
+    shard_put_u32(trailer, crc32c_combine(part -> desc_crc, part -> slice_crc, part -> len));
+    bmp_embed(layout, src_pixels, pixels, pos, trailer, sizeof(trailer), bits, NULL);
+
+    if(munmap(image, part -> image_size) != 0 || close(fd) != 0)
+    {
+        fprintf(stderr, "ERROR: Unable to write %s : %s\n", part -> output_fname, strerror(errno));
+        return;
+    }
+    part -> status = e_success;
+}
+
+/* Check carrier names
+ * Input  : Secret file name and the carrier names
+ * Return : e_success, or e_failure (reported) for a secret that is not
+ *          .txt / .c / .sh, a carrier that is not .bmp or a bad count
+ */
+static Status shard_check_args(const char *secret_fname, char *carriers[], uint count)
+{
+    const char *extn = strrchr(secret_fname, '.');
+
+    if(extn == NULL || (strcmp(extn, ".txt") != 0 && strcmp(extn, ".c") != 0 && strcmp(extn, ".sh") != 0))
+    {
+        fprintf(stderr, "ERROR: Secret file is not a .txt/.c/.sh file\n");
+        return e_failure;
+    }
+    if(count == 0 || count > SHARD_MAX_COUNT)
+    {
+        fprintf(stderr, "ERROR: --shard takes 1 to %d carriers\n", SHARD_MAX_COUNT);
+        return e_failure;
+    }
+    for(uint i = 0; i < count; i++)
+    {
+        size_t len = strlen(carriers[i]);
+        if(len < 4 || strcmp(carriers[i] + len - 4, ".bmp") != 0)
+        {
+            fprintf(stderr, "ERROR: %s is not a .bmp file\n", carriers[i]);
+            return e_failure;
+        }
+    }
+    return e_success;
+}
+
+/* Run sharded encode
+ * Input  : Secret file, output prefix, carriers and their count, worker
+ *          count (0 : one per online CPU), --alpha and the stego header
+ *          flags (--bits)
+ * Output : <prefix>.<index>.bmp per carrier, one status line each and a
+ *          summary; on failure no output is left behind
+ * Return : e_success or e_failure
+ */
+Status run_shard_encode(const char *secret_fname, const char *prefix, char *carriers[], uint count,
+                        uint workers, uint use_alpha, uint flags)
+{
+    if(shard_check_args(secret_fname, carriers, count) != e_success)
+        return e_failure;
+
+    double start = now_msec();
+    ShardSecret secret = { NULL, strrchr(secret_fname, '.'), flags | STEGO_FLAG_SHARD, use_alpha };
+    ShardPart *parts = shard_alloc(carriers, count);
+    uint64_t size = 0, room = 0;
+    struct stat st;
+    Status ret = parts != NULL ? e_success : e_failure;
+
+    workers = resolve_workers(workers);
+    for(uint i = 0; ret == e_success && i < count; i++)
+    {
+        size_t len = strlen(prefix) + sizeof(".4294967295.bmp");
+        if((parts[i].output_fname = malloc(len)) == NULL)
+            ret = e_failure;
+        else
+            snprintf(parts[i].output_fname, len, "%s.%u.bmp", prefix, i);
+    }
+
+    PRINT_INFO("INFO: Opening %s\n", secret_fname);
+    int fd = ret == e_success ? open(secret_fname, O_RDONLY | O_CLOEXEC) : -1;
+    if(ret == e_success && (fd < 0 || fstat(fd, &st) != 0))
+    {
+        fprintf(stderr, "ERROR: Unable to open file %s : %s\n", secret_fname, strerror(errno));
+        ret = e_failure;
+    }
+    if(ret == e_success && (size = st.st_size) > 0)
+    {
+        secret.data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(secret.data == MAP_FAILED)
+        {
+            fprintf(stderr, "ERROR: Unable to map %s\n", secret_fname);
+            secret.data = NULL;
+            ret = e_failure;
+        }
+    }
+
+    if(ret == e_success)
+    {
+        PRINT_INFO("INFO: Opening %u carriers\n", count);
+        shard_run(parts, count, workers, shard_open_carrier, &secret);
+        for(uint i = 0; i < count; i++)
+        {
+            if(parts[i].status != e_success)
+                ret = e_failure;
+        }
+    }
+    if(ret == e_success && shard_plan(parts, count, size, &room) != e_success)
+    {
+        fprintf(stderr, "ERROR: %s needs %llu bytes, the carriers hold %llu\n", secret_fname,
+                (unsigned long long)size, (unsigned long long)room);
+        ret = e_failure;
+    }
+
+    if(ret == e_success)
+    {
+        PRINT_INFO("INFO: Checksumming %s\n", secret_fname);
+        shard_run(parts, count, workers, shard_crc_slice, &secret);
+        uint32_t crc = 0;
+        for(uint i = 0; i < count; i++)
+            crc = crc32c_combine(crc, parts[i].slice_crc, parts[i].len);
+        for(uint i = 0; i < count; i++)
+        {
+            parts[i].desc.index = i;
+            parts[i].desc.count = count;
+            parts[i].desc.total = size;
+            parts[i].desc.secret_crc = crc;
+        }
+
+        PRINT_INFO("INFO: Encoding %u shards\n", count);
+        shard_run(parts, count, workers, shard_write_image, &secret);
+        for(uint i = 0; i < count; i++)
+        {
+            printf("SHARD: %-4s %s %s index=%u/%u offset=%llu size=%llu (%.3f ms)\n",
+                   parts[i].status == e_success ? "OK" : "FAIL", parts[i].image_fname, parts[i].output_fname,
+                   i, count, (unsigned long long)parts[i].desc.offset, (unsigned long long)parts[i].len, parts[i].msec);
+            if(parts[i].status != e_success)
+                ret = e_failure;
+        }
+    }
+
+    if(ret != e_success)
+    {
+        for(uint i = 0; parts != NULL && i < count; i++)
+        {
+            if(parts[i].created)
+                unlink(parts[i].output_fname);
+        }
+    }
+    else
+        printf("SHARD: %u shards, %llu bytes, %u workers, %.3f ms\n", count, (unsigned long long)size,
+               workers < count ? workers : count, now_msec() - start);
+
+    if(secret.data != NULL)
+        munmap((void *)secret.data, size);
+    if(fd >= 0)
+        close(fd);
+    if(parts != NULL)
+        shard_free(parts, count);
+    return ret;
+}
+
+/* Read shard descriptor (decode step 1)
+ * Input  : --alpha setting and the part
+ * Output : Image mapped, its stego header and shard descriptor read (the
+ *          descriptor's crc kept for the payload crc check)
+ */
+static void shard_read_desc(void *ctx, ShardPart *part)
+{
+    const uint *use_alpha = ctx;
+    uint8_t header[STEGO_HEADER_MAX * 8];
+    uint8_t field[STEGO_SHARD_SIZE];
+
+    part -> status = shard_map_image(part, *use_alpha);
+    if(part -> status != e_success)
+        return;
+    part -> status = e_failure;
+
+    BmpLayout *layout = &part -> layout;
+    const unsigned char *pixels = part -> image + layout -> offset;
+    uint64_t carrier = bmp_carrier_size(layout);
+
+    bmp_gather(layout, pixels, 0, header, carrier < sizeof(header) ? carrier : sizeof(header));
+    StegoStatus status = stego_parse_header(header, carrier, &part -> header);
+    if(status == e_stego_not_stego && layout -> bpp == 32)
+    {
+        // Written with the other --alpha setting, the header records it (STEGO_FLAG_ALPHA)
+        bmp_set_alpha(layout, !*use_alpha);
+        carrier = bmp_carrier_size(layout);
+        bmp_gather(layout, pixels, 0, header, carrier < sizeof(header) ? carrier : sizeof(header));
+        status = stego_parse_header(header, carrier, &part -> header);
+        if(status == e_stego_ok && bmp_uses_alpha(layout) && !STEGO_ALPHA_CONFIRMED(part -> header))
+            status = e_stego_not_stego;
+    }
+    if(status == e_stego_ok && !(part -> header.flags & STEGO_FLAG_SHARD))
+    {
+        fprintf(stderr, "ERROR: %s is not a shard (decode it with -d)\n", part -> image_fname);
+        return;
+    }
+    if(status == e_stego_ok && (part -> header.version < STEGO_VERSION || (part -> header.flags & STEGO_FLAG_COMPRESSED)
+                                || part -> header.payload_len < STEGO_SHARD_SIZE))
+        status = e_stego_corrupt;
+    if(status != e_stego_ok)
+    {
+        fprintf(stderr, "ERROR: %s : %s\n", part -> image_fname, stego_strerror(status));
+        return;
+    }
+
+    bmp_extract(layout, pixels, part -> header.size * 8, field, sizeof(field), STEGO_BITS(part -> header.flags), &part -> desc_crc);
+    shard_get_desc(field, &part -> desc);
+    part -> len = part -> header.payload_len - STEGO_SHARD_SIZE;
+    if(part -> desc.count == 0 || part -> desc.count > SHARD_MAX_COUNT || part -> desc.index >= part -> desc.count
+       || part -> desc.offset > part -> desc.total || part -> len > part -> desc.total - part -> desc.offset)
+    {
+        fprintf(stderr, "ERROR: %s has a corrupt shard descriptor\n", part -> image_fname);
+        return;
+    }
+    part -> status = e_success;
+}
+
+/* Check shard set
+ * Input  : Parts with their descriptors read, their count, and order
+ *          with room for the descriptors' shard count
+ * Output : order[index] : the part holding shard index
+ * Return : e_success, or e_failure (reported) unless the parts are every
+ *          shard of one secret once, their slices tiling all of it
+ */
+static Status shard_check_set(ShardPart *parts, uint count, ShardPart **order)
+{
+    const ShardPart *first = &parts[0];
+    uint64_t offset = 0;
+    Status ret = e_success;
+
+    for(uint i = 0; i < count; i++)
+    {
+        const ShardDesc *desc = &parts[i].desc;
+        if(desc -> count != first -> desc.count || desc -> total != first -> desc.total
+           || desc -> secret_crc != first -> desc.secret_crc || strcmp(parts[i].header.extn, first -> header.extn) != 0)
+        {
+            fprintf(stderr, "ERROR: %s and %s are shards of different secrets\n", first -> image_fname, parts[i].image_fname);
+            ret = e_failure;
+        }
+        else if(order[desc -> index] != NULL)
+        {
+            fprintf(stderr, "ERROR: %s and %s are both shard %u\n", order[desc -> index] -> image_fname, parts[i].image_fname, desc -> index);
+            ret = e_failure;
+        }
+        else
+            order[desc -> index] = &parts[i];
+    }
+    for(uint i = 0; ret == e_success && i < first -> desc.count; i++)
+    {
+        if(order[i] == NULL)
+        {
+            fprintf(stderr, "ERROR: Shard %u of %u is missing\n", i, first -> desc.count);
+            ret = e_failure;
+        }
+        else if(order[i] -> desc.offset != offset)
+        {
+            fprintf(stderr, "ERROR: %s does not continue shard %u\n", order[i] -> image_fname, i - 1);
+            ret = e_failure;
+        }
+        else
+            offset += order[i] -> len;
+    }
+    if(ret == e_success && offset != first -> desc.total)
+    {
+        fprintf(stderr, "ERROR: The shards hold %llu of %llu secret bytes\n", (unsigned long long)offset,
+                (unsigned long long)first -> desc.total);
+        ret = e_failure;
+    }
+    return ret;
+}
+
+/* Read slice (decode step 2)
+ * Input  : Mapped output and the part
+ * Output : Slice extracted straight to its offset in the output, its crc
+ *          taken on the way and joined with the descriptor's for the
+ *          payload crc check
+ */
+static void shard_read_slice(void *ctx, ShardPart *part)
+{
+    unsigned char *output = ctx;
+    const BmpLayout *layout = &part -> layout;
+    const unsigned char *pixels = part -> image + layout -> offset;
+    uint bits = STEGO_BITS(part -> header.flags);
+    uint64_t pos = part -> header.size * 8 + lsb_carrier_size(STEGO_SHARD_SIZE, bits);
+    uint8_t trailer[STEGO_CRC_SIZE];
+
+    if(part -> len > 0)
+        bmp_extract(layout, pixels, pos, output + part -> desc.offset, part -> len, bits, &part -> slice_crc);
+    pos += lsb_carrier_size(part -> len, bits);
+    bmp_extract(layout, pixels, pos, trailer, sizeof(trailer), bits, NULL);
+    if(shard_get_u32(trailer) != crc32c_combine(part -> desc_crc, part -> slice_crc, part -> len))
+    {
+        fprintf(stderr, "ERROR: %s : %s\n", part -> image_fname, stego_strerror(e_stego_checksum));
+        part -> status = e_failure;
+    }
+}
+
+/* Run sharded decode
+ * Input  : Output file name (the extension is appended), shard images
+ *          in any order, their count, worker count (0 : one per online
+ *          CPU) and --alpha
+ * Output : The secret reassembled into the output, one status line per
+ *          shard and a summary; on failure no output is left behind
+ * Return : e_success or e_failure
+ */
+Status run_shard_decode(const char *output_fname, char *images[], uint count, uint workers, uint use_alpha)
+{
+    if(count == 0 || count > SHARD_MAX_COUNT)
+    {
+        fprintf(stderr, "ERROR: --shard takes 1 to %d images\n", SHARD_MAX_COUNT);
+        return e_failure;
+    }
+
+    double start = now_msec();
+    ShardPart *parts = shard_alloc(images, count);
+    ShardPart **order = NULL;
+    char *fname = NULL;
+    unsigned char *output = NULL;
+    uint64_t total = 0;
+    int fd = -1;
+    Status ret = parts != NULL ? e_success : e_failure;
+
+    workers = resolve_workers(workers);
+    if(ret == e_success)
+    {
+        PRINT_INFO("INFO: Decoding %u shard headers\n", count);
+        shard_run(parts, count, workers, shard_read_desc, &use_alpha);
+        for(uint i = 0; i < count; i++)
+        {
+            if(parts[i].status != e_success)
+                ret = e_failure;
+        }
+    }
+    if(ret == e_success)
+    {
+        order = calloc(parts[0].desc.count, sizeof(ShardPart *));
+        ret = order != NULL ? shard_check_set(parts, count, order) : e_failure;
+    }
+
+    // Output is created with its final size and mapped shared
+    if(ret == e_success)
+    {
+        total = parts[0].desc.total;
+        fname = malloc(strlen(output_fname) + STEGO_EXTN_MAX + 1);
+        if(fname == NULL)
+            ret = e_failure;
+        else
+        {
+            strcpy(fname, output_fname);
+            strcat(fname, parts[0].header.extn);
+            PRINT_INFO("INFO: Opening %s\n", fname);
+            fd = open(fname, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if(fd < 0)
+            {
+                fprintf(stderr, "ERROR: Unable to open file %s : %s\n", fname, strerror(errno));
+                ret = e_failure;
+            }
+            else if(total > 0 && (ftruncate(fd, total) != 0
+                    || (output = mmap(NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED))
+            {
+                fprintf(stderr, "ERROR: Unable to map %s\n", fname);
+                output = NULL;
+                ret = e_failure;
+            }
+        }
+    }
+
+    if(ret == e_success)
+    {
+        PRINT_INFO("INFO: Decoding %u shards of %llu bytes\n", count, (unsigned long long)total);
+        shard_run(parts, count, workers, shard_read_slice, output);
+        uint32_t crc = 0;
+        for(uint i = 0; i < count; i++)
+        {
+            const ShardPart *part = order[i];
+            printf("SHARD: %-4s %s index=%u/%u offset=%llu size=%llu (%.3f ms)\n", part -> status == e_success ? "OK" : "FAIL",
+                   part -> image_fname, i, count, (unsigned long long)part -> desc.offset, (unsigned long long)part -> len, part -> msec);
+            if(part -> status != e_success)
+                ret = e_failure;
+            crc = crc32c_combine(crc, part -> slice_crc, part -> len);
+        }
+        if(ret == e_success && crc != parts[0].desc.secret_crc)
+        {
+            fprintf(stderr, "ERROR: %s does not match the checksum of the secret\n", fname);
+            ret = e_failure;
+        }
+    }
+
+    if(output != NULL && munmap(output, total) != 0)
+        ret = e_failure;
+    if(fd >= 0 && close(fd) != 0)
+        ret = e_failure;
+    if(ret == e_success)
+        printf("SHARD: %u shards, %llu bytes, %u workers, %.3f ms\n", count, (unsigned long long)total,
+               workers < count ? workers : count, now_msec() - start);
+    else if(fd >= 0)
+        unlink(fname);
+
+    free(fname);
+    free(order);
+    if(parts != NULL)
+        shard_free(parts, count);
+    return ret;
+}
@@ -0,0 +1,74 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <stdint.h>
+#include "bmp.h"
+#include "stego.h"
+#include "types.h"
+
+/*
+ * Sharding (--shard) : one secret split over several carrier images.
+ *
+ *      ./a.out -e --shard <secret_file> <output_prefix> <carrier.bmp>...
+ *      ./a.out -d --shard <output_file> <stego.bmp>...
+ *
+ * Encoding gives every carrier one contiguous slice of the secret, sized
+ * in proportion to the carrier's capacity, and writes it to
+ * <output_prefix>.<index>.bmp. Each image holds a regular version 3 stego
+ * header with STEGO_FLAG_SHARD, then (at the payload depth) the shard
+ * descriptor and the slice, then the payload crc of both:
+ *
+ *      index | count | offset | secret size | secret crc | slice
+ *
+ * The secret crc (CRC32C of the whole secret) also ties the shards of one
+ * secret together. Decoding takes the images in any order, checks that
+ * they form one complete set and extracts every slice straight into the
+ * pre-sized output at its offset. Every image is handled on a pool of
+ * workers (-j N, one per online CPU by default), in both directions.
+ */
+
+/* Upper bound for the number of carriers of one secret */
+#define SHARD_MAX_COUNT 4096
+
+/* Parsed shard descriptor */
+typedef struct _ShardDesc
+{
+    uint32_t index;           // 0 .. count - 1
+    uint32_t count;           // Shards of the secret
+    uint64_t offset;          // First secret byte of this shard's slice
+    uint64_t total;           // Whole secret size
+    uint32_t secret_crc;      // CRC32C of the whole secret
+} ShardDesc;
+
+/* One carrier / stego image of a sharded secret */
+typedef struct _ShardPart
+{
+    const char *image_fname;  // Carrier (encode) or stego image (decode)
+    char *output_fname;       // Stego image written (encode)
+    int fd;
+    unsigned char *image;     // Mapped image
+    uint64_t image_size;
+    BmpLayout layout;
+    StegoHeader header;
+    ShardDesc desc;
+    uint64_t len;             // Slice bytes
+    uint64_t capacity;        // Largest slice the carrier takes (encode)
+    uint32_t desc_crc;        // CRC32C of the serialised descriptor
+    uint32_t slice_crc;       // CRC32C of the slice
+    uint created;             // Output file created (removed again on failure)
+    Status status;
+    double msec;
+} ShardPart;
+
+/* Serialise / parse a STEGO_SHARD_SIZE byte descriptor */
+void shard_put_desc(uint8_t *field, const ShardDesc *desc);
+void shard_get_desc(const uint8_t *field, ShardDesc *desc);
+
+/* Split secret_fname over the count carriers, writing <prefix>.<index>.bmp for each (flags : --bits) */
+Status run_shard_encode(const char *secret_fname, const char *prefix, char *carriers[], uint count,
+                        uint workers, uint use_alpha, uint flags);
+
+/* Reassemble the secret of the count shard images (any order) into output_fname + extension */
+Status run_shard_decode(const char *output_fname, char *images[], uint count, uint workers, uint use_alpha);
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : stats.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the --stats=json instrumentation: per-stage wall
+ * times, bytes read / written and read / write syscall counts, the LSB
+ * kernel in use and the peak RSS, printed as one JSON object so a job
+ * scheduler can ingest it.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "lsb.h"
+#include "stats.h"
+
+/* Counters of /proc/self/io */
+typedef struct _StatsIo
+{
+    unsigned long long rchar;     // bytes read (read, pread, sendfile, ...)
+    unsigned long long wchar;     // bytes written
+    unsigned long long syscr;     // read syscalls
+    unsigned long long syscw;     // write syscalls
+} StatsIo;
+
+typedef struct _StatsStage
+{
+    const char *name;
+    double sec;
+} StatsStage;
+
+int stats_enabled = 0;
+
+static StatsStage stats_stages[STATS_MAX_STAGES];
+static uint stats_stage_count;
+static StatsIo stats_io_start;
+static double stats_start;
+static uint stats_block;                       // Payload block size, 0 : not recorded
+static double stats_pipe[3];                   // Busy seconds of the pipeline reader, transform, writer
+static int stats_piped;
+
+/* Read I/O counters
+ * Output : Counters of this process, all zero where /proc is missing
+ */
+static void stats_read_io(StatsIo *io)
+{
+    char key[32];
+    unsigned long long value;
+    FILE *fptr = fopen("/proc/self/io", "r");
+
+    memset(io, 0, sizeof(*io));
+    if(fptr == NULL)
+        return;
+    while(fscanf(fptr, "%31[^:]: %llu\n", key, &value) == 2)
+    {
+        if(strcmp(key, "rchar") == 0)
+            io -> rchar = value;
+        else if(strcmp(key, "wchar") == 0)
+            io -> wchar = value;
+        else if(strcmp(key, "syscr") == 0)
+            io -> syscr = value;
+        else if(strcmp(key, "syscw") == 0)
+            io -> syscw = value;
+    }
+    fclose(fptr);
+}
+
+/* Begin statistics
+ * Output : Enables stage timing, records the start time and I/O counters
+ */
+void stats_begin(void)
+{
+    stats_enabled = 1;
+    stats_stage_count = 0;
+    stats_block = 0;
+    stats_piped = 0;
+    memset(stats_pipe, 0, sizeof(stats_pipe));
+    stats_read_io(&stats_io_start);
+    stats_start = stats_now();
+}
+
+/* Current time
+ * Output : Monotonic seconds, or 0 without a clock read when disabled
+ */
+double stats_now(void)
+{
+    struct timespec ts;
+
+    if(!stats_enabled)
+        return 0;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* End of a stage
+ * Input  : Stage name (a string literal) and its start time
+ * Output : Time added to the stage, stages keep their first-seen order
+ */
+void stats_stage_end(const char *name, double start)
+{
+    if(!stats_enabled)
+        return;
+
+    double sec = stats_now() - start;
+    for(uint i = 0; i < stats_stage_count; i++)
+    {
+        if(strcmp(stats_stages[i].name, name) == 0)
+        {
+            stats_stages[i].sec += sec;
+            return;
+        }
+    }
+    if(stats_stage_count < STATS_MAX_STAGES)
+    {
+        stats_stages[stats_stage_count].name = name;
+        stats_stages[stats_stage_count++].sec = sec;
+    }
+}
+
+/* Payload block size
+ * Input  : Payload bytes per block of the streaming payload stage
+ */
+void stats_block_size(uint block_size)
+{
+    if(stats_enabled)
+        stats_block = block_size;
+}
+
+/* Pipeline stage times
+ * Input  : Busy seconds of the reader, transform and writer stages of
+ *          one pipelined pass (added to the run's totals)
+ */
+void stats_pipeline(double read_sec, double transform_sec, double write_sec)
+{
+    if(!stats_enabled)
+        return;
+    stats_pipe[0] += read_sec;
+    stats_pipe[1] += transform_sec;
+    stats_pipe[2] += write_sec;
+    stats_piped = 1;
+}
+
+/* Report statistics
+ * Input  : Output stream, operation, I/O path (stdio, mmap, in-place) and result
+ * Output : One line of JSON
+ */
+void stats_report(FILE *fptr, const char *op, const char *path, Status status)
+{
+    StatsIo io;
+    struct rusage usage;
+    double wall = stats_now() - stats_start;
+
+    stats_read_io(&io);
+    getrusage(RUSAGE_SELF, &usage);
+
+    fprintf(fptr, "{\"op\": \"%s\", \"path\": \"%s\", \"status\": \"%s\", \"kernel\": \"%s\", \"wall_sec\": %.6f, \"stages_sec\": {",
+            op, path, status == e_success ? "ok" : "failed", lsb_get_kernel() -> name, wall);
+    for(uint i = 0; i < stats_stage_count; i++)
+    {
+        fprintf(fptr, "%s\"%s\": %.6f", i ? ", " : "", stats_stages[i].name, stats_stages[i].sec);
+    }
+    fprintf(fptr, "}");
+    if(stats_block != 0)
+        fprintf(fptr, ", \"block_size\": %u", stats_block);
+    if(stats_piped)
+        fprintf(fptr, ", \"pipeline_sec\": {\"read\": %.6f, \"transform\": %.6f, \"write\": %.6f}",
+                stats_pipe[0], stats_pipe[1], stats_pipe[2]);
+    fprintf(fptr, ", \"bytes_read\": %llu, \"bytes_written\": %llu, \"read_syscalls\": %llu, \"write_syscalls\": %llu, \"peak_rss_kb\": %ld}\n",
+            io.rchar - stats_io_start.rchar, io.wchar - stats_io_start.wchar,
+            io.syscr - stats_io_start.syscr, io.syscw - stats_io_start.syscw, usage.ru_maxrss);
+}
@@ -0,0 +1,44 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include "types.h"
+
+/*
+ * Run statistics (--stats=json).
+ *
+ * Stage wall times are accumulated by name while the stages run; the
+ * I/O counters (bytes and read / write syscalls) are the difference of
+ * /proc/self/io between stats_begin() and stats_report(). Nothing is
+ * measured unless stats_begin() was called.
+ */
+
+/* Distinct stage names recorded in one run */
+#define STATS_MAX_STAGES 16
+
+/* Set by stats_begin() */
+extern int stats_enabled;
+
+/* Enable statistics and take the starting I/O counters */
+void stats_begin(void);
+
+/* Current time in seconds (0 when statistics are disabled) */
+double stats_now(void);
+
+/* Add the time since start to the named stage */
+void stats_stage_end(const char *name, double start);
+
+/* Record the payload block size of the streaming payload stage */
+void stats_block_size(uint block_size);
+
+/* Add the busy time of each stage of a pipelined pass (pipe.h) */
+void stats_pipeline(double read_sec, double transform_sec, double write_sec);
+
+/* Print the run as one JSON object */
+void stats_report(FILE *fptr, const char *op, const char *path, Status status);
+
+/* Evaluate a stage call, timing it under name */
+#define STATS_STAGE(name, call) \
+    ({ double stats_start_ = stats_now(); Status stats_ret_ = (call); stats_stage_end(name, stats_start_); stats_ret_; })
+
+#endif
@@ -0,0 +1,419 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : stego.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains libstego, the in-memory form of encoding and
+ * decoding. It works on caller provided buffers only, so a service that
+ * already holds images in memory can hide / extract data without temp
+ * files. It is also where the stego header layout is defined for the
+ * command line tool.
+ *
+ * Build as a library :
+ * --------------------
+ *      gcc -O2 -fPIC -c stego.c lsb.c lz.c crc32c.c
+ *      ar rcs libstego.a stego.o lsb.o lz.o crc32c.o
+ *      gcc -shared -o libstego.so stego.o lsb.o lz.o crc32c.o -pthread
+ */
+
+#include <string.h>
+#include "common.h"
+#include "crc32c.h"
+#include "lsb.h"
+#include "lz.h"
+#include "stego.h"
+
+/* Store a 32-bit value MSB first */
+static void stego_put_u32(uint8_t *dest, uint32_t value)
+{
+    dest[0] = value >> 24;
+    dest[1] = value >> 16;
+    dest[2] = value >> 8;
+    dest[3] = value;
+}
+
+/* Read a 32-bit value stored MSB first */
+static uint32_t stego_get_u32(const uint8_t *src)
+{
+    return (uint32_t)src[0] << 24 | (uint32_t)src[1] << 16 | (uint32_t)src[2] << 8 | src[3];
+}
+
+/* Store a 64-bit value MSB first */
+static void stego_put_u64(uint8_t *dest, uint64_t value)
+{
+    stego_put_u32(dest, value >> 32);
+    stego_put_u32(dest + 4, value);
+}
+
+/* Read a 64-bit value stored MSB first */
+static uint64_t stego_get_u64(const uint8_t *src)
+{
+    return (uint64_t)stego_get_u32(src) << 32 | stego_get_u32(src + 4);
+}
+
+/* Build stego header
+ * Input  : Extension (e.g. ".txt"), payload size, flags and a buffer of
+ *          STEGO_HEADER_MAX bytes
+ * Output : Magic string, marker, flags, extension size, extension,
+ *          64-bit payload size and the CRC32C of all of them
+ * Return : Header size in bytes
+ */
+size_t stego_build_header(const char *extn, uint64_t payload_len, uint32_t flags, uint8_t *header)
+{
+    size_t magic_len = strlen(MAGIC_STRING);
+    size_t extn_len = strlen(extn);
+    size_t size = 0;
+
+    memcpy(header, MAGIC_STRING, magic_len);
+    size += magic_len;
+    stego_put_u32(header + size, STEGO_MARKER | STEGO_VERSION);
+    size += 4;
+    stego_put_u32(header + size, flags);
+    size += 4;
+    stego_put_u32(header + size, extn_len);
+    size += 4;
+    memcpy(header + size, extn, extn_len);
+    size += extn_len;
+    stego_put_u64(header + size, payload_len);
+    size += 8;
+    stego_put_u32(header + size, crc32c_update(0, header, size));
+    size += 4;
+    return size;
+}
+
+/* Get header size
+ * Input  : Extension length
+ * Output : Bytes stego_build_header() writes for it
+ */
+size_t stego_header_size(size_t extn_len)
+{
+    return strlen(MAGIC_STRING) + 4 + 4 + 4 + extn_len + 8 + STEGO_CRC_SIZE;
+}
+
+/* Get capacity
+ * Input  : Carrier size and extension length
+ * Output : Largest payload in bytes (0 if not even the header fits)
+ */
+size_t stego_capacity(size_t len, size_t extn_len)
+{
+    return stego_capacity_bits(len, extn_len, 1);
+}
+
+/* Get capacity at a bit depth
+ * Input  : Carrier size, extension length and payload bits per carrier byte
+ * Output : Largest payload in bytes, the payload crc still fitting after
+ *          it (0 if not even the header and crc fit)
+ */
+size_t stego_capacity_bits(size_t len, size_t extn_len, unsigned int bits)
+{
+    size_t header = stego_header_size(extn_len);
+
+    if(len / 8 <= header)
+        return 0;
+    uint64_t room = lsb_payload_size(len - header * 8, bits);
+    return room > STEGO_CRC_SIZE ? room - STEGO_CRC_SIZE : 0;
+}
+
+/* Encode into memory
+ * Input  : Carrier bytes, payload, extension and output buffer of len bytes
+ * Output : out holds the carrier with header and payload in its LSBs,
+ *          carrier bytes past the payload are copied unchanged
+ * Return : e_stego_ok or the reason nothing was written
+ */
+StegoStatus stego_encode(const uint8_t *pixels, size_t len, const uint8_t *payload, size_t payload_len,
+                         const char *extn, uint8_t *out)
+{
+    return stego_encode_bits(pixels, len, payload, payload_len, extn, 1, out);
+}
+
+/* Encode into memory at a bit depth
+ * Input  : As stego_encode(), plus payload bits per carrier byte (1, 2 or 4)
+ * Output : out holds the carrier with header and payload, the depth is
+ *          recorded in the header flags
+ * Return : e_stego_ok or the reason nothing was written
+ */
+StegoStatus stego_encode_bits(const uint8_t *pixels, size_t len, const uint8_t *payload, size_t payload_len,
+                              const char *extn, unsigned int bits, uint8_t *out)
+{
+    if(bits != 1 && bits != 2 && bits != 4)
+        return e_stego_bad_args;
+    return stego_embed(pixels, len, payload, payload_len, extn, STEGO_FLAG_BITS(bits), out);
+}
+
+/* Embed into memory
+ * Input  : As stego_encode(), plus the header flags (depth, and whether
+ *          the payload is an lz stream; it is embedded as is either way)
+ * Output : out holds the carrier with header, payload and payload crc,
+ *          the crc taken in the embedding pass
+ * Return : e_stego_ok or the reason nothing was written
+ */
+StegoStatus stego_embed(const uint8_t *pixels, size_t len, const uint8_t *payload, size_t payload_len,
+                        const char *extn, uint32_t flags, uint8_t *out)
+{
+    uint8_t header[STEGO_HEADER_MAX];
+    uint8_t trailer[STEGO_CRC_SIZE];
+    uint bits = STEGO_BITS(flags);
+
+    if(pixels == NULL || out == NULL || extn == NULL || (payload == NULL && payload_len > 0))
+        return e_stego_bad_args;
+    if(strlen(extn) > STEGO_EXTN_MAX || (flags & ~STEGO_FLAGS_KNOWN) || bits > 4)
+        return e_stego_bad_args;
+    if(payload_len > stego_capacity_bits(len, strlen(extn), bits))
+        return e_stego_no_capacity;
+
+    size_t header_len = stego_build_header(extn, payload_len, flags, header);
+    size_t pos = header_len * 8 + lsb_carrier_size(payload_len, bits);
+    size_t used = pos + lsb_carrier_size(STEGO_CRC_SIZE, bits);
+
+    lsb_embed(pixels, out, header, header_len);
+    stego_put_u32(trailer, lsb_embed_bits_crc(pixels + header_len * 8, out + header_len * 8, payload, payload_len, bits, 0));
+    lsb_embed_bits(pixels + pos, out + pos, trailer, STEGO_CRC_SIZE, bits);
+    if(out != pixels)
+        memcpy(out + used, pixels + used, len - used);
+    return e_stego_ok;
+}
+
+/* Parse stego header
+ * Input  : Carrier bytes and the whole carrier size
+ * Output : Version, flags, extension, payload size and header size.
+ *          The header crc and the payload size (at the depth the flags
+ *          give) are checked. A version 1 header has the extension size
+ *          right after the magic string and a 32-bit payload size, a
+ *          version 2 header has no crc
+ * Return : e_stego_ok, e_stego_not_stego, e_stego_corrupt or e_stego_version
+ */
+StegoStatus stego_parse_header(const uint8_t *pixels, size_t len, StegoHeader *header)
+{
+    size_t magic_len = strlen(MAGIC_STRING);
+    uint8_t field[8];
+    uint8_t rebuilt[STEGO_HEADER_MAX];
+    char magic[8];
+
+    if(pixels == NULL || header == NULL)
+        return e_stego_bad_args;
+    if(len / 8 < magic_len + 4)
+        return e_stego_not_stego;
+
+    lsb_extract(pixels, (uint8_t *)magic, magic_len);
+    if(memcmp(magic, MAGIC_STRING, magic_len) != 0)
+        return e_stego_not_stego;
+    size_t size = magic_len;
+
+    lsb_extract(pixels + size * 8, field, 4);
+    uint32_t word = stego_get_u32(field);
+    size += 4;
+    header -> version = 1;
+    header -> flags = 0;
+    if(word > STEGO_EXTN_MAX)
+    {
+        if(word != (STEGO_MARKER | STEGO_VERSION) && word != (STEGO_MARKER | 2))
+            return (word & 0xFFFF0000u) == STEGO_MARKER ? e_stego_version : e_stego_corrupt;
+        if(len / 8 < size + 8)
+            return e_stego_corrupt;
+        header -> version = word & 0xFFFFu;
+        lsb_extract(pixels + size * 8, field, 4);
+        header -> flags = stego_get_u32(field);
+        size += 4;
+        if((header -> flags & ~STEGO_FLAGS_KNOWN) || STEGO_BITS(header -> flags) > 4)
+            return e_stego_version;
+        lsb_extract(pixels + size * 8, field, 4);
+        word = stego_get_u32(field);
+        size += 4;
+    }
+
+    size_t extn_len = word;
+    size_t len_size = header -> version == 1 ? 4 : 8;
+    size_t crc_size = header -> version >= 3 ? STEGO_CRC_SIZE : 0;
+    if(extn_len > STEGO_EXTN_MAX || len / 8 < size + extn_len + len_size + crc_size)
+        return e_stego_corrupt;
+    lsb_extract(pixels + size * 8, (uint8_t *)header -> extn, extn_len);
+    header -> extn[extn_len] = '\0';
+    size += extn_len;
+
+    lsb_extract(pixels + size * 8, field, len_size);
+    header -> payload_len = len_size == 4 ? stego_get_u32(field) : stego_get_u64(field);
+    size += len_size;
+
+    // The fields read so far determine the header bytes, its crc is theirs
+    if(crc_size > 0)
+    {
+        lsb_extract(pixels + size * 8, field, crc_size);
+        size += crc_size;
+        stego_build_header(header -> extn, header -> payload_len, header -> flags, rebuilt);
+        if(memcmp(field, rebuilt + size - crc_size, crc_size) != 0)
+            return e_stego_corrupt;
+    }
+    header -> size = size;
+
+    // Overflow safe : len / 8 >= size was checked above
+    uint64_t room = lsb_payload_size(len - size * 8, STEGO_BITS(header -> flags));
+    if(header -> payload_len > room || room - header -> payload_len < STEGO_TRAILER_SIZE(header -> version))
+        return e_stego_corrupt;
+    return e_stego_ok;
+}
+
+/* Extracted payload bytes per stego_decode() step of a compressed payload */
+#define STEGO_CHUNK_SIZE 4096
+
+/* Output buffer a compressed payload is decoded into */
+typedef struct _StegoSink
+{
+    uint8_t *data;
+    size_t len;
+} StegoSink;
+
+/* Append decoded bytes (the stream never produces more than its raw size) */
+static Status stego_sink(void *ctx, const unsigned char *data, size_t len)
+{
+    StegoSink *sink = ctx;
+
+    memcpy(sink -> data + sink -> len, data, len);
+    sink -> len += len;
+    return e_success;
+}
+
+/* Get data size
+ * Input  : Carrier bytes and the parsed header
+ * Output : Payload size, read from the stream header when it is compressed
+ * Return : e_stego_ok, e_stego_shard for a shard of a split secret, or
+ *          e_stego_corrupt for an impossible stream
+ */
+static StegoStatus stego_data_size(const uint8_t *pixels, const StegoHeader *header, size_t *size)
+{
+    uint8_t field[LZ_STREAM_HEADER];
+    uint64_t raw_size;
+
+    *size = header -> payload_len;
+    if(header -> flags & STEGO_FLAG_SHARD)
+        return e_stego_shard;
+    if(!(header -> flags & STEGO_FLAG_COMPRESSED))
+        return e_stego_ok;
+    if(header -> payload_len < LZ_STREAM_HEADER)
+        return e_stego_corrupt;
+    lsb_extract_bits(pixels + header -> size * 8, field, LZ_STREAM_HEADER, STEGO_BITS(header -> flags));
+    if(lz_read_raw_size(field, header -> payload_len, &raw_size) != e_success || raw_size > SIZE_MAX)
+        return e_stego_corrupt;
+    *size = raw_size;
+    return e_stego_ok;
+}
+
+/* Peek stego header
+ * Input  : Carrier bytes and size
+ * Output : Payload size (decompressed) and NUL terminated extension
+ * Return : e_stego_ok, e_stego_not_stego, e_stego_corrupt, e_stego_version
+ *          or e_stego_shard
+ */
+StegoStatus stego_peek(const uint8_t *pixels, size_t len, size_t *payload_len, char *extn)
+{
+    StegoHeader header;
+
+    if(pixels == NULL || payload_len == NULL || extn == NULL)
+        return e_stego_bad_args;
+
+    StegoStatus status = stego_parse_header(pixels, len, &header);
+    if(status == e_stego_ok)
+        status = stego_data_size(pixels, &header, payload_len);
+    if(status != e_stego_ok)
+        return status;
+    strcpy(extn, header.extn);
+    return e_stego_ok;
+}
+
+/* Check payload crc
+ * Input  : Carrier bytes, parsed header and the CRC32C of the extracted payload
+ * Output : e_stego_ok, or e_stego_checksum when the stored crc differs
+ *          (images before version 3 have none to check)
+ */
+static StegoStatus stego_check_crc(const uint8_t *pixels, const StegoHeader *header, uint32_t crc)
+{
+    uint8_t field[STEGO_CRC_SIZE];
+    uint bits = STEGO_BITS(header -> flags);
+
+    if(STEGO_TRAILER_SIZE(header -> version) == 0)
+        return e_stego_ok;
+    lsb_extract_bits(pixels + header -> size * 8 + lsb_carrier_size(header -> payload_len, bits), field, STEGO_CRC_SIZE, bits);
+    return stego_get_u32(field) == crc ? e_stego_ok : e_stego_checksum;
+}
+
+/* Decode from memory
+ * Input  : Carrier bytes, output buffer and its capacity
+ * Output : Payload, its size and the extension. A compressed payload is
+ *          extracted chunk by chunk and decompressed on the way; the
+ *          payload crc is taken in the same pass
+ * Return : e_stego_ok, or why nothing (or nothing valid) was extracted
+ *          (e_stego_buffer_small with the size needed in payload_len,
+ *          e_stego_no_memory when the decompression buffers could not
+ *          be allocated)
+ */
+StegoStatus stego_decode(const uint8_t *pixels, size_t len, uint8_t *payload, size_t payload_cap,
+                         size_t *payload_len, char *extn)
+{
+    StegoHeader header;
+
+    if(pixels == NULL || payload_len == NULL || extn == NULL)
+        return e_stego_bad_args;
+
+    StegoStatus status = stego_parse_header(pixels, len, &header);
+    if(status == e_stego_ok)
+        status = stego_data_size(pixels, &header, payload_len);
+    if(status != e_stego_ok)
+        return status;
+    strcpy(extn, header.extn);
+    if(*payload_len > payload_cap || (payload == NULL && *payload_len > 0))
+        return e_stego_buffer_small;
+
+    uint bits = STEGO_BITS(header.flags);
+    if(!(header.flags & STEGO_FLAG_COMPRESSED))
+    {
+        uint32_t crc = lsb_extract_bits_crc(pixels + header.size * 8, payload, *payload_len, bits, 0);
+        return stego_check_crc(pixels, &header, crc);
+    }
+
+    StegoSink sink = { payload, 0 };
+    LzStream lz;
+    uint8_t chunk[STEGO_CHUNK_SIZE];
+    const uint8_t *pos = pixels + header.size * 8;
+    uint32_t crc = 0;
+
+    if(lz_stream_init(&lz, stego_sink, &sink) != e_success)
+        return e_stego_no_memory;
+    for(uint64_t done = 0; status == e_stego_ok && done < header.payload_len; done += sizeof(chunk))
+    {
+        size_t count = header.payload_len - done < sizeof(chunk) ? header.payload_len - done : sizeof(chunk);
+        crc = lsb_extract_bits_crc(pos, chunk, count, bits, crc);
+        pos += lsb_carrier_size(count, bits);
+        if(lz_stream_feed(&lz, chunk, count) != e_success)
+            status = e_stego_corrupt;
+    }
+    if(status == e_stego_ok && lz_stream_end(&lz) != e_success)
+        status = e_stego_corrupt;
+    lz_stream_free(&lz);
+    if(status == e_stego_ok)
+        status = stego_check_crc(pixels, &header, crc);
+    return status;
+}
+
+/* Status text
+ * Input  : StegoStatus
+ * Output : Short description
+ */
+const char *stego_strerror(StegoStatus status)
+{
+    switch(status)
+    {
+        case e_stego_ok:           return "success";
+        case e_stego_bad_args:     return "invalid arguments";
+        case e_stego_no_capacity:  return "payload does not fit the carrier";
+        case e_stego_not_stego:    return "no hidden data (magic string missing)";
+        case e_stego_corrupt:      return "corrupt stego header or compressed payload";
+        case e_stego_buffer_small: return "output buffer too small";
+        case e_stego_version:      return "unsupported stego header version or flags";
+        case e_stego_checksum:     return "payload checksum mismatch";
+        case e_stego_shard:        return "one shard of a split secret (decode with -d --shard)";
+        case e_stego_no_memory:    return "out of memory";
+    }
+    return "unknown error";
+}
@@ -0,0 +1,150 @@
+#ifndef STEGO_H
+#define STEGO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * libstego : in-memory encoding / decoding over caller owned buffers.
+ *
+ * "pixels" is the carrier byte array the data is hidden in, i.e. the
+ * BMP pixel array starting at bfOffBits (row padding and skipped
+ * alpha bytes removed, see bmp.h). The layout is the same as the
+ * command line tool produces:
+ *
+ *      magic "#*" | marker (32-bit) | flags (32-bit) | extn size (32-bit) | extn
+ *      | payload size (64-bit) | header crc (32-bit) | payload | payload crc (32-bit)
+ *
+ * every byte spread MSB first over the LSBs of 8 carrier bytes, integers
+ * MSB first. The marker holds STEGO_MARKER | STEGO_VERSION; images written
+ * before it (version 1) have the extension size there and a 32-bit payload
+ * size, they are still read, as are version 2 images (no crc fields).
+ *
+ * The header always takes 1 bit per carrier byte. The payload may take
+ * 1, 2 or 4 (flags STEGO_FLAG_BITS), a payload byte then spans 8, 4 or 2
+ * carrier bytes, its bits MSB first in their low bits.
+ *
+ * Both crc fields are CRC32C (crc32c.h). The header crc covers every header
+ * byte before it, so a carrier that only happens to start with "#*" is
+ * rejected from its first few hundred bytes. The payload crc covers the
+ * payload as embedded and follows it at the payload depth.
+ *
+ * With STEGO_FLAG_COMPRESSED the payload is an lz stream (lz.h) and the
+ * payload size is the stream size; stego_peek() / stego_decode() report
+ * and return the decompressed data.
+ *
+ * With STEGO_FLAG_SHARD the image holds one shard of a secret split over
+ * several carriers (--shard, shard.h): the payload starts with a
+ * STEGO_SHARD_SIZE byte descriptor and the payload crc covers both.
+ * Such an image only decodes together with its sibling shards,
+ * stego_peek() / stego_decode() return e_stego_shard for it.
+ *
+ * All functions are reentrant, print nothing and never touch the
+ * filesystem; the only shared state is the LSB kernel chosen once
+ * from cpuid.
+ */
+
+/* Longest extension stored in the header (".txt") */
+#define STEGO_EXTN_MAX 4
+
+/* Marker word of a versioned header, version in the low 16 bits ("ST" above).
+ * A version 1 header has its extension size there, never above STEGO_EXTN_MAX */
+#define STEGO_MARKER 0x53540000u
+#define STEGO_VERSION 3
+
+/* Size of each crc field, and the payload crc bytes following a payload of a given header version */
+#define STEGO_CRC_SIZE 4
+#define STEGO_TRAILER_SIZE(version) ((version) >= 3 ? STEGO_CRC_SIZE : 0)
+
+/* Flags bits 0-1 : log2 of the payload bits per carrier byte (1, 2 or 4; 3 is invalid) */
+#define STEGO_FLAG_BITS_MASK 0x3u
+#define STEGO_FLAG_BITS(bits) ((bits) == 4 ? 2u : (bits) == 2 ? 1u : 0u)
+#define STEGO_BITS(flags) (1u << ((flags) & STEGO_FLAG_BITS_MASK))
+
+/* Flags bit 2 : payload is an lz stream (--compress) */
+#define STEGO_FLAG_COMPRESSED 0x4u
+
+/* Flags bit 3 : payload is one shard of a split secret (--shard), led by its descriptor */
+#define STEGO_FLAG_SHARD 0x8u
+
+/* Flags bit 4 : the carrier takes the alpha bytes of a 32 bpp image (--alpha). The header
+ * itself lies in those bytes, so readers find it by trying both 32 bpp carriers; a header
+ * read from the alpha one is only taken when it records the flag (version 1 has no flags) */
+#define STEGO_FLAG_ALPHA 0x10u
+#define STEGO_ALPHA_CONFIRMED(header) ((header).version == 1 || ((header).flags & STEGO_FLAG_ALPHA))
+
+/* Shard descriptor : index (32-bit) | count (32-bit) | offset (64-bit) | secret size (64-bit)
+ * | secret crc (32-bit), integers MSB first, at the payload depth */
+#define STEGO_SHARD_SIZE 28
+
+/* Flag bits this build understands, headers with others are rejected */
+#define STEGO_FLAGS_KNOWN (STEGO_FLAG_BITS_MASK | STEGO_FLAG_COMPRESSED | STEGO_FLAG_SHARD | STEGO_FLAG_ALPHA)
+
+/* Largest serialised stego header (magic + marker + flags + extn size + extn + size + crc) */
+#define STEGO_HEADER_MAX 30
+
+/* Result of a libstego call */
+typedef enum
+{
+    e_stego_ok,
+    e_stego_bad_args,          // NULL buffer or extension too long
+    e_stego_no_capacity,       // payload does not fit the carrier
+    e_stego_not_stego,         // magic string missing
+    e_stego_corrupt,           // header fields out of range, or a corrupt compressed payload
+    e_stego_buffer_small,      // output buffer smaller than the payload
+    e_stego_version,           // header version or flags this build cannot read
+    e_stego_checksum,          // payload does not match its crc
+    e_stego_shard,             // one shard of a split secret, decoded with its siblings only
+    e_stego_no_memory          // working memory could not be allocated (decompression buffers)
+} StegoStatus;
+
+/* Parsed stego header */
+typedef struct _StegoHeader
+{
+    uint32_t version;             // 1 (32-bit sizes, no flags), 2 (no crc fields) or STEGO_VERSION
+    uint32_t flags;               // Feature bits, 0 for version 1
+    uint64_t payload_len;         // Payload bytes
+    char extn[STEGO_EXTN_MAX + 1];
+    size_t size;                  // Serialised header bytes, the payload starts after them
+} StegoHeader;
+
+/* Serialise the stego header (header crc included), returns its size in bytes */
+size_t stego_build_header(const char *extn, uint64_t payload_len, uint32_t flags, uint8_t *header);
+
+/* Serialised header size for an extension of extn_len characters */
+size_t stego_header_size(size_t extn_len);
+
+/* Parse the header of any version; reads STEGO_HEADER_MAX * 8 carrier bytes at most,
+ * len is the whole carrier so the payload size can be checked against it */
+StegoStatus stego_parse_header(const uint8_t *pixels, size_t len, StegoHeader *header);
+
+/* Largest payload that fits len carrier bytes with an extension of extn_len characters */
+size_t stego_capacity(size_t len, size_t extn_len);
+
+/* stego_capacity() with the payload at bits (1, 2 or 4) per carrier byte */
+size_t stego_capacity_bits(size_t len, size_t extn_len, unsigned int bits);
+
+/* Hide payload in pixels, writing the len modified bytes to out (out may equal pixels) */
+StegoStatus stego_encode(const uint8_t *pixels, size_t len, const uint8_t *payload, size_t payload_len,
+                         const char *extn, uint8_t *out);
+
+/* stego_encode() with the payload at bits (1, 2 or 4) per carrier byte */
+StegoStatus stego_encode_bits(const uint8_t *pixels, size_t len, const uint8_t *payload, size_t payload_len,
+                              const char *extn, unsigned int bits, uint8_t *out);
+
+/* Embed payload as is under a header with the given flags (STEGO_FLAG_BITS, and
+ * STEGO_FLAG_COMPRESSED when the payload already is an lz stream) */
+StegoStatus stego_embed(const uint8_t *pixels, size_t len, const uint8_t *payload, size_t payload_len,
+                        const char *extn, uint32_t flags, uint8_t *out);
+
+/* Read the header only: payload size (decompressed) and extension (extn needs STEGO_EXTN_MAX + 1 bytes) */
+StegoStatus stego_peek(const uint8_t *pixels, size_t len, size_t *payload_len, char *extn);
+
+/* Extract the payload into a caller buffer of payload_cap bytes, checking its crc */
+StegoStatus stego_decode(const uint8_t *pixels, size_t len, uint8_t *payload, size_t payload_cap,
+                         size_t *payload_len, char *extn);
+
+/* Human readable text for a status */
+const char *stego_strerror(StegoStatus status);
+
+#endif
@@ -0,0 +1,142 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : stream.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the forward only I/O helpers of the streaming
+ * mode ("-" arguments), where the images come and go through pipes:
+ *
+ * 1) Handing standard output over to the data, messages then go to
+ *    standard error so they cannot corrupt the image / secret
+ * 2) Exact reads, and pass through / skip of a byte range
+ * 3) Parsing the BMP header straight off the stream
+ * 4) Cutting the pixel array into windows of whole rows
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lsb.h"
+#include "stream.h"
+
+/* Data stream on the original standard output, once claimed */
+static FILE *stream_out;
+
+/* Standard stream name
+ * Input  : File name argument
+ * Output : 1 for "-"
+ */
+uint stream_is_std(const char *fname)
+{
+    return fname != NULL && strcmp(fname, STREAM_NAME) == 0;
+}
+
+/* Claim standard output
+ * Output : A stream on the original standard output for the data; file
+ *          descriptor 1 is pointed at standard error, so the INFO: lines
+ *          and messages printed afterwards stay out of the data
+ * Return : The data stream (the same one on every call), NULL on error
+ */
+FILE *stream_stdout(void)
+{
+    if(stream_out != NULL)
+        return stream_out;
+
+    fflush(stdout);
+    int fd = dup(STDOUT_FILENO);
+    if(fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0 || (stream_out = fdopen(fd, "w")) == NULL)
+    {
+        perror("dup");
+        if(fd >= 0)
+            close(fd);
+        return NULL;
+    }
+    return stream_out;
+}
+
+/* Read exactly
+ * Input  : Stream, buffer and length
+ * Return : e_success, or e_failure on an error or an early end of file
+ */
+Status stream_read(FILE *fptr, void *buf, size_t len)
+{
+    return fread(buf, 1, len, fptr) == len ? e_success : e_failure;
+}
+
+/* Copy a byte range
+ * Input  : Input stream, output stream (NULL : the bytes are dropped)
+ *          and length (UINT64_MAX : up to the end of the input)
+ * Output : Bytes passed on in order, without seeking either stream
+ * Return : e_success, or e_failure on an I/O error or an early end of file
+ */
+Status stream_copy(FILE *in, FILE *out, uint64_t len)
+{
+    char buffer[1 << 16];
+
+    while(len > 0)
+    {
+        size_t count = fread(buffer, 1, len < sizeof(buffer) ? len : sizeof(buffer), in);
+        if(count == 0)
+            return len == UINT64_MAX && !ferror(in) ? e_success : e_failure;
+        if(out != NULL && fwrite(buffer, 1, count, out) != count)
+            return e_failure;
+        if(len != UINT64_MAX)
+            len -= count;
+    }
+    return e_success;
+}
+
+/* Read BMP layout off a stream
+ * Input  : Input stream at the start of the image, output stream (or
+ *          NULL) and the --alpha setting
+ * Output : Layout parsed from the header; every byte before the pixel
+ *          array (headers, palette) passed on to out, the input is left
+ *          at the first pixel byte. The file size is not known up front,
+ *          a short pixel array shows up as an early end of file later
+ */
+Status stream_read_layout(FILE *in, FILE *out, uint use_alpha, BmpLayout *layout)
+{
+    unsigned char header[BMP_HEADER_SIZE];
+
+    if(stream_read(in, header, sizeof(header)) != e_success
+       || bmp_parse(header, sizeof(header), UINT64_MAX, use_alpha, layout) != e_success)
+        return e_failure;
+    if(out != NULL && fwrite(header, 1, sizeof(header), out) != sizeof(header))
+        return e_failure;
+    return stream_copy(in, out, layout -> offset - BMP_HEADER_SIZE);
+}
+
+/* Rows per window
+ * Input  : Layout
+ * Output : A multiple of 8 rows spanning STREAM_WINDOW_SIZE image bytes
+ *          or more, so every window but the last holds a multiple of 8
+ *          carrier bytes (all rows for a smaller image)
+ */
+uint64_t stream_window_rows(const BmpLayout *layout)
+{
+    uint64_t rows = (STREAM_WINDOW_SIZE + layout -> stride - 1) / layout -> stride;
+
+    rows = (rows + 7) / 8 * 8;
+    return rows < layout -> height ? rows : layout -> height;
+}
+
+/* Region part of a window
+ * Input  : Window of carrier bytes [start, end), the region's first
+ *          carrier byte, its size in data bytes and bits per carrier byte
+ * Output : Index of the first data byte of the region in the window
+ * Return : Data bytes of the region in the window (0 : none)
+ */
+uint64_t stream_window_part(uint64_t start, uint64_t end, uint64_t region, uint64_t size, uint bits, uint64_t *first)
+{
+    uint64_t region_end = region + lsb_carrier_size(size, bits);
+    uint64_t low = start > region ? start : region;
+    uint64_t high = end < region_end ? end : region_end;
+
+    if(low >= high)
+        return 0;
+    *first = lsb_payload_size(low - region, bits);
+    return lsb_payload_size(high - low, bits);
+}
@@ -0,0 +1,53 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "bmp.h"
+#include "types.h"
+
+/*
+ * Single pass streaming for shell pipelines ("-" arguments).
+ *
+ * "-" as the carrier / stego image reads it from standard input, "-" as
+ * the output writes the stego image / secret to standard output. The
+ * image is read front to back once, a window of whole rows at a time,
+ * and written out as it goes: no seek, no temporary file, memory bounded
+ * by the window. A window holds a multiple of 8 rows, so its carrier
+ * bytes are a multiple of 8 and no hidden byte spans two windows.
+ *
+ * Once standard output carries data, every message printed through
+ * printf() goes to standard error instead. A secret decoded to standard
+ * output is written as it is extracted; its payload crc can only be
+ * checked at the end, so a mismatch shows in the exit status and on
+ * standard error, which is what a pipeline consumer checks.
+ */
+
+/* File name standing for standard input / output */
+#define STREAM_NAME "-"
+
+/* Image bytes per window (at least 8 rows) */
+#define STREAM_WINDOW_SIZE (1 << 20)
+
+/* Name is "-" */
+uint stream_is_std(const char *fname);
+
+/* Standard output as the data stream, printf() output moved to standard error */
+FILE *stream_stdout(void);
+
+/* Read exactly len bytes, e_failure on an error / end of file */
+Status stream_read(FILE *fptr, void *buf, size_t len);
+
+/* Pass len bytes (UINT64_MAX : up to end of file) from in to out (NULL : skip them) */
+Status stream_copy(FILE *in, FILE *out, uint64_t len);
+
+/* Read the BMP header and every byte up to the pixel array, passing them on to out (may be NULL) */
+Status stream_read_layout(FILE *in, FILE *out, uint use_alpha, BmpLayout *layout);
+
+/* Rows per window of an image */
+uint64_t stream_window_rows(const BmpLayout *layout);
+
+/* Data bytes of a region lying in a window of carrier bytes [start, end) */
+uint64_t stream_window_part(uint64_t start, uint64_t end, uint64_t region, uint64_t size, uint bits, uint64_t *first);
+
+#endif
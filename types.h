@@ -1,6 +1,8 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <stddef.h>
+
 /* User defined types */
 typedef unsigned int uint;
 
@@ -15,6 +17,7 @@ typedef enum
 {
     e_encode,
     e_decode,
+    e_batch,
     e_unsupported
 } OperationType;
 
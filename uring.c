@@ -0,0 +1,375 @@
+/*
+ * Name        : Mathews Roy
+ * Date        : 16-11-2025
+ * File        : uring.c
+ * Project     : LSB Image Steganography
+ *
+ * Description :
+ * -------------
+ * This file contains the io_uring backend of the streaming encode /
+ * decode paths (--uring), so the disk and the LSB kernels work at the
+ * same time instead of taking turns:
+ *
+ *      → uring_init() : io_uring_setup, the queue mappings and the
+ *                       registered buffers (IORING_REGISTER_BUFFERS,
+ *                       pinned once, read / written with *_FIXED ops)
+ *      → uring_run()  : the block pipeline; all requests queued by one
+ *                       step go to the kernel in one io_uring_enter
+ *
+ * A ring is made per job, or once per worker for batch mode and reused
+ * by all of its jobs.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "uring.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+
+/* Block state in its slot */
+typedef enum
+{
+    e_slot_free,
+    e_slot_reading,
+    e_slot_writing
+} UringSlotState;
+
+/* One slot of the pipeline */
+typedef struct _UringSlot
+{
+    UringSlotState state;
+    uint64_t block;
+    uint pending;                 // Requests of the current state still in flight
+    uint count;
+    PipeIo io[PIPE_MAX_OPS];
+} UringSlot;
+
+static int uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int uring_register(int fd, unsigned opcode, void *arg, unsigned nr_args)
+{
+    return syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+/* Initialise ring
+ * Input  : Ring and the payload bytes per block
+ * Output : Ring of PIPE_SLOTS * PIPE_MAX_OPS entries with its queues
+ *          mapped and PIPE_SLOTS carrier buffers registered
+ * Return : e_success, or e_failure (ring left torn down) where io_uring
+ *          is not available
+ */
+Status uring_init(Uring *ring, uint block_size)
+{
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring -> fd = uring_setup(PIPE_SLOTS * PIPE_MAX_OPS, &params);
+    if(ring -> fd < 0)
+        return e_failure;
+    ring -> entries = params.sq_entries;
+
+    ring -> sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring -> cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if(ring -> cq_map_size > ring -> sq_map_size)
+            ring -> sq_map_size = ring -> cq_map_size;
+        ring -> cq_map_size = 0;
+    }
+    ring -> sq_map = mmap(NULL, ring -> sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring -> fd, IORING_OFF_SQ_RING);
+    if(ring -> sq_map == MAP_FAILED)
+    {
+        ring -> sq_map = NULL;
+        uring_free(ring);
+        return e_failure;
+    }
+    if(ring -> cq_map_size > 0)
+    {
+        ring -> cq_map = mmap(NULL, ring -> cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              ring -> fd, IORING_OFF_CQ_RING);
+        if(ring -> cq_map == MAP_FAILED)
+        {
+            ring -> cq_map = NULL;
+            uring_free(ring);
+            return e_failure;
+        }
+    }
+    unsigned char *cq = ring -> cq_map != NULL ? ring -> cq_map : ring -> sq_map;
+
+    ring -> sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring -> sqes = mmap(NULL, ring -> sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring -> fd, IORING_OFF_SQES);
+    if(ring -> sqes == MAP_FAILED)
+    {
+        ring -> sqes = NULL;
+        uring_free(ring);
+        return e_failure;
+    }
+
+    unsigned char *sq = ring -> sq_map;
+    ring -> sq_head = (unsigned *)(sq + params.sq_off.head);
+    ring -> sq_tail = (unsigned *)(sq + params.sq_off.tail);
+    ring -> sq_mask = (unsigned *)(sq + params.sq_off.ring_mask);
+    ring -> sq_array = (unsigned *)(sq + params.sq_off.array);
+    ring -> cq_head = (unsigned *)(cq + params.cq_off.head);
+    ring -> cq_tail = (unsigned *)(cq + params.cq_off.tail);
+    ring -> cq_mask = (unsigned *)(cq + params.cq_off.ring_mask);
+    ring -> cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // One pinned buffer per slot, page aligned
+    ring -> block_size = block_size;
+    if(posix_memalign((void **)&ring -> buffers, 4096, PIPE_SLOTS * PIPE_BUFFER_SIZE(block_size)) != 0)
+    {
+        ring -> buffers = NULL;
+        uring_free(ring);
+        return e_failure;
+    }
+    struct iovec iov[PIPE_SLOTS];
+    for(uint i = 0; i < PIPE_SLOTS; i++)
+    {
+        iov[i].iov_base = ring -> buffers + i * PIPE_BUFFER_SIZE(block_size);
+        iov[i].iov_len = PIPE_BUFFER_SIZE(block_size);
+    }
+    if(uring_register(ring -> fd, IORING_REGISTER_BUFFERS, iov, PIPE_SLOTS) != 0)
+    {
+        uring_free(ring);
+        return e_failure;
+    }
+    return e_success;
+}
+
+/* Free ring
+ * Input  : Ring set up by uring_init() (or zeroed)
+ * Output : Buffers, mappings and the ring fd released
+ */
+void uring_free(Uring *ring)
+{
+    if(ring -> sqes != NULL)
+        munmap(ring -> sqes, ring -> sqes_size);
+    if(ring -> cq_map != NULL)
+        munmap(ring -> cq_map, ring -> cq_map_size);
+    if(ring -> sq_map != NULL)
+        munmap(ring -> sq_map, ring -> sq_map_size);
+    if(ring -> fd > 0)
+        close(ring -> fd);
+    free(ring -> buffers);
+    memset(ring, 0, sizeof(*ring));
+}
+
+/* Queue request
+ * Input  : Ring, read or write, the request, its slot and index
+ * Output : One submission queue entry filled (sent by the next enter);
+ *          the ring holds an entry for every request of every slot
+ */
+static void uring_queue(Uring *ring, int write, const PipeIo *io, uint slot, uint index)
+{
+    unsigned tail = *ring -> sq_tail;
+    unsigned i = tail & *ring -> sq_mask;
+    struct io_uring_sqe *sqe = &ring -> sqes[i];
+
+    memset(sqe, 0, sizeof(*sqe));
+    if(io -> fixed)
+    {
+        sqe -> opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+        sqe -> buf_index = slot;
+    }
+    else
+        sqe -> opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe -> fd = io -> fd;
+    sqe -> addr = (uint64_t)(uintptr_t)io -> buf;
+    sqe -> len = io -> len;
+    sqe -> off = io -> off;
+    sqe -> user_data = (uint64_t)slot << 8 | index;
+
+    ring -> sq_array[i] = i;
+    __atomic_store_n(ring -> sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring -> sq_queued++;
+}
+
+/* Start state
+ * Input  : Ring, slot, its index, reads or writes and their count
+ * Output : Every request of the state queued, none means it is done
+ */
+static void uring_start(Uring *ring, UringSlot *slot, uint index, UringSlotState state, uint count)
+{
+    slot -> state = state;
+    slot -> count = count;
+    slot -> pending = count;
+    for(uint i = 0; i < count; i++)
+        uring_queue(ring, state == e_slot_writing, &slot -> io[i], index, i);
+}
+
+/* Drain ring
+ * Input  : Ring and the requests submitted but not completed yet
+ * Output : Their completions reaped (results dropped), so no request
+ *          still writes into a slot buffer; gives up on a hard error
+ */
+static void uring_drain(Uring *ring, uint pending)
+{
+    while(pending > 0)
+    {
+        if(uring_enter(ring -> fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+            break;
+        unsigned head = *ring -> cq_head;
+        while(head != __atomic_load_n(ring -> cq_tail, __ATOMIC_ACQUIRE) && pending > 0)
+        {
+            head++;
+            pending--;
+        }
+        __atomic_store_n(ring -> cq_head, head, __ATOMIC_RELEASE);
+    }
+}
+
+/* Run pass
+ * Input  : Ring and the job
+ * Output : Every block read, transformed in block order and written,
+ *          up to PIPE_SLOTS blocks in flight
+ * Return : e_success, or e_failure after the first failed request or
+ *          transform, once nothing is in flight any more. A failing
+ *          io_uring_enter leaves entries queued but never sent : what
+ *          was sent is drained and the ring marked dead, no later pass
+ *          runs on it
+ */
+Status uring_run(Uring *ring, const PipeJob *job)
+{
+    UringSlot slots[PIPE_SLOTS];
+    uint64_t next_read = 0, next_transform = 0, done = 0;
+    uint in_flight = 0;
+    Status ret = e_success;
+
+    if(ring -> dead || job -> block_size > ring -> block_size)
+        return e_failure;
+    memset(slots, 0, sizeof(slots));
+    while(ret == e_success ? done < job -> blocks : in_flight > 0)
+    {
+        // Reads of upcoming blocks into every free slot
+        while(ret == e_success && next_read < job -> blocks && slots[next_read % PIPE_SLOTS].state == e_slot_free)
+        {
+            uint index = next_read % PIPE_SLOTS;
+            UringSlot *slot = &slots[index];
+            unsigned char *buffer = ring -> buffers + index * PIPE_BUFFER_SIZE(job -> block_size);
+
+            slot -> block = next_read++;
+            uring_start(ring, slot, index, e_slot_reading, job -> reads(job -> ctx, slot -> block, index, buffer, slot -> io));
+            in_flight += slot -> count;
+        }
+
+        // Transforms, in block order, of the blocks whose reads are done
+        while(ret == e_success && next_transform < next_read)
+        {
+            uint index = next_transform % PIPE_SLOTS;
+            UringSlot *slot = &slots[index];
+            uint writes = 0;
+
+            if(slot -> state != e_slot_reading || slot -> pending > 0)
+                break;
+            ret = job -> transform(job -> ctx, slot -> block, index, ring -> buffers + index * PIPE_BUFFER_SIZE(job -> block_size),
+                                   slot -> io, &writes);
+            next_transform++;
+            if(ret != e_success)
+            {
+                slot -> state = e_slot_free;
+                break;
+            }
+            uring_start(ring, slot, index, e_slot_writing, writes);
+            in_flight += writes;
+            if(writes == 0)
+            {
+                slot -> state = e_slot_free;
+                done++;
+            }
+        }
+        if(ret == e_success && done == job -> blocks)
+            break;
+
+        // Send what was queued, wait for at least one completion
+        int submitted = uring_enter(ring -> fd, ring -> sq_queued, in_flight > 0 ? 1 : 0, IORING_ENTER_GETEVENTS);
+        if(submitted < 0)
+        {
+            if(errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                continue;
+            perror("io_uring_enter");
+            uring_drain(ring, in_flight - ring -> sq_queued);
+            ring -> dead = 1;
+            return e_failure;
+        }
+        ring -> sq_queued -= submitted;
+
+        unsigned head = *ring -> cq_head;
+        while(head != __atomic_load_n(ring -> cq_tail, __ATOMIC_ACQUIRE))
+        {
+            struct io_uring_cqe *cqe = &ring -> cqes[head & *ring -> cq_mask];
+            UringSlot *slot = &slots[(cqe -> user_data >> 8) % PIPE_SLOTS];
+            PipeIo *io = &slot -> io[cqe -> user_data & 0xFF];
+            int res = cqe -> res;
+            head++;
+
+            if(res < 0 || (res == 0 && io -> len > 0))
+            {
+                // An error, or end of file before the block is complete
+                if(ret == e_success)
+                    fprintf(stderr, "ERROR: io_uring %s : %s\n", slot -> state == e_slot_writing ? "write" : "read",
+                            res < 0 ? strerror(-res) : "unexpected end of file");
+                ret = e_failure;
+            }
+            else if((uint32_t)res < io -> len && ret == e_success)
+            {
+                // Short transfer : queue the rest of it again
+                io -> buf += res;
+                io -> len -= res;
+                io -> off += res;
+                uring_queue(ring, slot -> state == e_slot_writing, io, (cqe -> user_data >> 8) % PIPE_SLOTS,
+                            cqe -> user_data & 0xFF);
+                continue;
+            }
+
+            in_flight--;
+            if(--slot -> pending == 0 && slot -> state == e_slot_writing)
+            {
+                slot -> state = e_slot_free;
+                done++;
+            }
+        }
+        __atomic_store_n(ring -> cq_head, head, __ATOMIC_RELEASE);
+    }
+    return ret;
+}
+
+#else
+
+Status uring_init(Uring *ring, uint block_size)
+{
+    memset(ring, 0, sizeof(*ring));
+    return e_failure;
+}
+
+void uring_free(Uring *ring)
+{
+    memset(ring, 0, sizeof(*ring));
+}
+
+Status uring_run(Uring *ring, const PipeJob *job)
+{
+    (void)ring;
+    (void)job;
+    return e_failure;
+}
+
+#endif
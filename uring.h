@@ -0,0 +1,69 @@
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pipe.h"
+#include "types.h"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/*
+ * io_uring backend (--uring), through the raw system calls (no liburing).
+ *
+ * uring_run() runs a block pipeline pass (pipe.h) through a ring: the
+ * reads of upcoming blocks and the writes of finished ones stay in
+ * flight while blocks are transformed, strictly in block order, on the
+ * calling thread. Slot buffers are registered (fixed) buffers. Short
+ * reads / writes are resubmitted for the rest.
+ *
+ * uring_init() fails where io_uring is missing or disabled (and off
+ * Linux), callers then keep the blocking path. A ring whose
+ * io_uring_enter failed is marked dead; an owner running several
+ * passes (batch workers) frees it and goes on without it.
+ */
+
+/* Mapped queues of one ring */
+typedef struct _Uring
+{
+    int fd;
+    uint entries;
+
+    /* Submission queue */
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_mask;
+    unsigned *sq_array;
+    struct io_uring_sqe *sqes;
+    uint sq_queued;               // Entries filled since the last io_uring_enter
+
+    /* Completion queue */
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    void *sq_map;
+    size_t sq_map_size;
+    void *cq_map;
+    size_t cq_map_size;
+    size_t sqes_size;
+
+    /* Registered buffers, PIPE_SLOTS carrier buffers of blocks up to block_size */
+    unsigned char *buffers;
+    uint block_size;
+
+    uint dead;                    // io_uring_enter failed with entries left queued, only uring_free() is valid
+} Uring;
+
+/* Set up a ring for blocks of block_size payload bytes, e_failure where io_uring is not available */
+Status uring_init(Uring *ring, uint block_size);
+
+/* Tear down a ring (a zeroed / failed ring too) */
+void uring_free(Uring *ring);
+
+/* Run a pass, e_failure on an I/O or transform error (every request in flight is reaped first) */
+Status uring_run(Uring *ring, const PipeJob *job);
+
+#endif